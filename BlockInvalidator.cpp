@@ -0,0 +1,264 @@
+#include "BlockInvalidator.h"
+
+#include <boost/make_shared.hpp>
+#include <sopnet/block/Box.h>
+#include <sopnet/block/BlockManager.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel blockinvalidatorlog("blockinvalidatorlog", "[BlockInvalidator] ");
+
+BlockInvalidator::BlockInvalidator()
+{
+	registerInput(_blocks, "blocks");
+	registerInput(_sliceStore, "slice store");
+	registerInput(_segmentStore, "segment store");
+	registerInput(_solutionStore, "solution store", pipeline::Optional);
+
+	registerOutput(_invalidatedBlocks, "blocks");
+}
+
+void
+BlockInvalidator::updateOutputs()
+{
+	*_invalidatedBlocks = *invalidate();
+}
+
+pipeline::Value<Blocks>
+BlockInvalidator::invalidate()
+{
+	pipeline::Value<Blocks> invalidatedBlocks;
+	IdSliceMap removedSlices;
+	std::vector<boost::shared_ptr<Block> > sliceBlocks;
+	std::vector<boost::shared_ptr<Block> > segmentBlocks;
+
+	updateInputs();
+
+	collectSlices(removedSlices, sliceBlocks);
+
+	// Segments first, the slice store still knows the blocks of the removed slices.
+	removeSegments(removedSlices, sliceBlocks, segmentBlocks);
+
+	foreach (const IdSliceMap::value_type& entry, removedSlices)
+	{
+		_sliceStore->removeSlice(entry.second);
+	}
+
+	foreach (boost::shared_ptr<Block> block, sliceBlocks)
+	{
+		block->setSlicesFlag(false);
+	}
+
+	// The blocks with slices removed are among these.
+	foreach (boost::shared_ptr<Block> block, segmentBlocks)
+	{
+		block->setSegmentsFlag(false);
+
+		if (_solutionStore)
+		{
+			_solutionStore->removeSolutions(block);
+		}
+
+		invalidatedBlocks->add(block);
+	}
+
+	LOG_DEBUG(blockinvalidatorlog) << "Removed " << removedSlices.size() << " slices from " <<
+		sliceBlocks.size() << " blocks, invalidated " << segmentBlocks.size() <<
+		" blocks for " << _blocks->length() << " requested" << std::endl;
+
+	return invalidatedBlocks;
+}
+
+void
+BlockInvalidator::collectSlices(IdSliceMap& removedSlices,
+								std::vector<boost::shared_ptr<Block> >& sliceBlocks)
+{
+	boost::unordered_set<unsigned int> blockIds;
+	boost::unordered_set<unsigned int> removedIds;
+	// The slices added to removedIds in the last pass.
+	std::vector<unsigned int> newIds;
+
+	foreach (boost::shared_ptr<Block> block, *_blocks)
+	{
+		addBlock(block, sliceBlocks, blockIds);
+
+		foreach (unsigned int id, _sliceStore->retrieveSliceIds(block))
+		{
+			if (removedIds.insert(id).second)
+			{
+				newIds.push_back(id);
+			}
+		}
+	}
+
+	// Follow the conflict sets of the removed slices until no more slices are added. A
+	// conflict set is stored with every block of its slices, so only the blocks of the slices
+	// added in the last pass can hold conflict sets that were not followed yet.
+	while (!newIds.empty())
+	{
+		std::vector<boost::shared_ptr<Block> > changedBlocks;
+		boost::unordered_set<unsigned int> changedBlockIds;
+
+		foreach (unsigned int id, newIds)
+		{
+			foreach (boost::shared_ptr<Block> block, *_sliceStore->getAssociatedBlocks(id))
+			{
+				addBlock(block, sliceBlocks, blockIds);
+				addBlock(block, changedBlocks, changedBlockIds);
+			}
+		}
+
+		newIds.clear();
+
+		foreach (boost::shared_ptr<Block> block, changedBlocks)
+		{
+			foreach (const ConflictSet& conflictSet, *_sliceStore->retrieveConflictSets(block))
+			{
+				bool conflicts = false;
+
+				foreach (unsigned int id, conflictSet.getSlices())
+				{
+					conflicts |= (removedIds.count(id) > 0);
+				}
+
+				if (!conflicts)
+				{
+					continue;
+				}
+
+				foreach (unsigned int id, conflictSet.getSlices())
+				{
+					if (removedIds.insert(id).second)
+					{
+						newIds.push_back(id);
+					}
+				}
+			}
+		}
+	}
+
+	// Only now are the slices themselves retrieved, once per block that holds removed ones.
+	foreach (boost::shared_ptr<Block> block, sliceBlocks)
+	{
+		bool holdsRemoved = false;
+
+		foreach (unsigned int id, _sliceStore->retrieveSliceIds(block))
+		{
+			holdsRemoved |= (removedIds.count(id) && !removedSlices.count(id));
+		}
+
+		if (!holdsRemoved)
+		{
+			continue;
+		}
+
+		foreach (boost::shared_ptr<Slice> slice, *_sliceStore->retrieveSlices(block))
+		{
+			if (removedIds.count(slice->getId()))
+			{
+				removedSlices[slice->getId()] = slice;
+			}
+		}
+	}
+}
+
+void
+BlockInvalidator::removeSegments(const IdSliceMap& removedSlices,
+								 const std::vector<boost::shared_ptr<Block> >& sliceBlocks,
+								 std::vector<boost::shared_ptr<Block> >& segmentBlocks)
+{
+	boost::unordered_set<unsigned int> blockIds;
+	std::map<unsigned int, boost::shared_ptr<Segment> > removedSegments;
+
+	foreach (boost::shared_ptr<Block> block, sliceBlocks)
+	{
+		addBlock(block, segmentBlocks, blockIds);
+	}
+
+	// The segments of a block reach into the first section of the block above, see
+	// SegmentGuarantor.
+	foreach (const IdSliceMap::value_type& entry, removedSlices)
+	{
+		foreach (boost::shared_ptr<Block> block,
+				 *_sliceStore->getAssociatedBlocks(entry.second))
+		{
+			if (entry.second->getSection() == block->location().z)
+			{
+				boost::shared_ptr<Block> below = blockBelow(block);
+
+				if (below)
+				{
+					addBlock(below, segmentBlocks, blockIds);
+				}
+			}
+		}
+	}
+
+	// A segment is associated with every block one of its slices overlaps, so the segments
+	// using a removed slice are found in the blocks of that slice.
+	foreach (boost::shared_ptr<Block> block, sliceBlocks)
+	{
+		foreach (boost::shared_ptr<Segment> segment,
+				 _segmentStore->retrieveSegments(block)->getSegments())
+		{
+			foreach (boost::shared_ptr<Slice> slice, segment->getSlices())
+			{
+				if (removedSlices.count(slice->getId()))
+				{
+					removedSegments[segment->getId()] = segment;
+					break;
+				}
+			}
+		}
+	}
+
+	foreach (const std::map<unsigned int, boost::shared_ptr<Segment> >::value_type& entry,
+			 removedSegments)
+	{
+		foreach (boost::shared_ptr<Block> block,
+				 *_segmentStore->getAssociatedBlocks(entry.second))
+		{
+			addBlock(block, segmentBlocks, blockIds);
+		}
+
+		_segmentStore->removeSegment(entry.second);
+	}
+
+	LOG_DEBUG(blockinvalidatorlog) << "Removed " << removedSegments.size() << " segments" <<
+		std::endl;
+}
+
+boost::shared_ptr<Block>
+BlockInvalidator::blockBelow(const boost::shared_ptr<Block>& block)
+{
+	util::point3<unsigned int> location = block->location();
+	util::point3<unsigned int> size = block->size();
+
+	if (location.z == 0)
+	{
+		return boost::shared_ptr<Block>();
+	}
+
+	// The last section of the block below.
+	boost::shared_ptr<Box<> > box = boost::make_shared<Box<> >(
+		util::rect<int>(location.x, location.y, location.x + size.x, location.y + size.y),
+		location.z - 1, 1);
+
+	foreach (boost::shared_ptr<Block> below, *_blocks->getManager()->blocksInBox(box))
+	{
+		return below;
+	}
+
+	return boost::shared_ptr<Block>();
+}
+
+void
+BlockInvalidator::addBlock(const boost::shared_ptr<Block>& block,
+						   std::vector<boost::shared_ptr<Block> >& blocks,
+						   boost::unordered_set<unsigned int>& blockIds)
+{
+	if (blockIds.insert(block->getId()).second)
+	{
+		blocks.push_back(block);
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef BLOCK_INVALIDATOR_H__
+#define BLOCK_INVALIDATOR_H__
+
+#include <map>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_set.hpp>
+#include <pipeline/all.h>
+#include <pipeline/Value.h>
+#include <sopnet/block/Blocks.h>
+#include <catmaidsopnet/persistence/SegmentStore.h>
+#include <catmaidsopnet/persistence/SliceStore.h>
+#include <catmaidsopnet/persistence/SolutionStore.h>
+
+/**
+ * BlockInvalidator removes everything derived from the membrane images of the given Blocks, so
+ * that a SliceGuarantor and a SegmentGuarantor regenerate it after the images have changed.
+ * For a Box, use BlockManager::blocksInBox to find the Blocks.
+ *
+ * The Slices of the given Blocks are removed from the SliceStore, together with every Slice
+ * that shares a conflict set with a removed one, since the component trees they belong to are
+ * extracted anew. The removal reaches into the neighbouring Blocks that contain such Slices.
+ * Every Segment that uses a removed Slice is removed from the SegmentStore.
+ *
+ * The slices flag is cleared for every Block that lost Slices. The segments flag is cleared for
+ * those Blocks, for the Blocks that lost Segments, and for the Blocks directly below a Block
+ * that lost Slices in its first section, whose Segments reach into that section. Stored
+ * solutions of these Blocks are removed as well. Nothing else is touched.
+ */
+class BlockInvalidator : public pipeline::SimpleProcessNode<>
+{
+public:
+	BlockInvalidator();
+
+	/**
+	 * Invalidate the requested blocks. Returns the Blocks whose flags were cleared, which is
+	 * the region that has to be guaranteed again.
+	 */
+	pipeline::Value<Blocks> invalidate();
+
+private:
+	typedef std::map<unsigned int, boost::shared_ptr<Slice> > IdSliceMap;
+
+	void updateOutputs();
+
+	void collectSlices(IdSliceMap& removedSlices,
+					   std::vector<boost::shared_ptr<Block> >& sliceBlocks);
+
+	void removeSegments(const IdSliceMap& removedSlices,
+						const std::vector<boost::shared_ptr<Block> >& sliceBlocks,
+						std::vector<boost::shared_ptr<Block> >& segmentBlocks);
+
+	/**
+	 * Find the Block directly below the given one, or an empty pointer if there is none.
+	 */
+	boost::shared_ptr<Block> blockBelow(const boost::shared_ptr<Block>& block);
+
+	static void addBlock(const boost::shared_ptr<Block>& block,
+						 std::vector<boost::shared_ptr<Block> >& blocks,
+						 boost::unordered_set<unsigned int>& blockIds);
+
+	pipeline::Input<Blocks> _blocks;
+	pipeline::Input<SliceStore> _sliceStore;
+	pipeline::Input<SegmentStore> _segmentStore;
+	pipeline::Input<SolutionStore> _solutionStore;
+
+	pipeline::Output<Blocks> _invalidatedBlocks;
+};
+
+#endif //BLOCK_INVALIDATOR_H__
@@ -0,0 +1,217 @@
+#include "CachedCostFunction.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <util/foreach.h>
+#include <util/Logger.h>
+#include <catmaidsopnet/ParallelFor.h>
+
+logger::LogChannel cachedcostfunctionlog("cachedcostfunctionlog", "[CachedCostFunction] ");
+
+boost::unordered_map<std::size_t, boost::shared_ptr<CachedCostFunction::CostMap> >
+	CachedCostFunction::_costMaps;
+boost::mutex CachedCostFunction::_costMapsMutex;
+
+CachedCostFunction::CachedCostFunction() :
+	_cachedCostFunction(new costs_function_type())
+{
+	registerInput(_costFunction, "cost function");
+	registerInput(_key, "key");
+	registerOutput(_cachedCostFunction, "cost function");
+}
+
+void
+CachedCostFunction::clear(std::size_t key)
+{
+	boost::shared_ptr<CostMap> costMap = getCostMap(key);
+	boost::mutex::scoped_lock lock(costMap->mutex);
+	
+	costMap->costs.clear();
+}
+
+void
+CachedCostFunction::remove(std::size_t key)
+{
+	boost::mutex::scoped_lock lock(_costMapsMutex);
+	
+	_costMaps.erase(key);
+}
+
+void
+CachedCostFunction::updateOutputs()
+{
+	_costMap = getCostMap(*_key);
+	
+	*_cachedCostFunction = boost::bind(&CachedCostFunction::costs, this, _1, _2, _3, _4);
+}
+
+void
+CachedCostFunction::costs(const std::vector<boost::shared_ptr<EndSegment> >& ends,
+						  const std::vector<boost::shared_ptr<ContinuationSegment> >& continuations,
+						  const std::vector<boost::shared_ptr<BranchSegment> >& branches,
+						  std::vector<double>& segmentCosts)
+{
+	std::vector<boost::shared_ptr<EndSegment> > missingEnds;
+	std::vector<boost::shared_ptr<ContinuationSegment> > missingContinuations;
+	std::vector<boost::shared_ptr<BranchSegment> > missingBranches;
+	// Positions in segmentCosts of the missing segments, in the order they are evaluated.
+	std::vector<unsigned int> missingIndices;
+	std::vector<unsigned int> missingIds;
+	unsigned int i = 0;
+	
+	{
+		boost::mutex::scoped_lock lock(_costMap->mutex);
+		boost::unordered_map<unsigned int, double>& costs = _costMap->costs;
+		boost::unordered_map<unsigned int, double>::const_iterator it;
+		
+		foreach (boost::shared_ptr<EndSegment> end, ends)
+		{
+			if ((it = costs.find(end->getId())) != costs.end())
+			{
+				segmentCosts[i] += it->second;
+			}
+			else
+			{
+				missingEnds.push_back(end);
+				missingIndices.push_back(i);
+				missingIds.push_back(end->getId());
+			}
+			
+			++i;
+		}
+		
+		foreach (boost::shared_ptr<ContinuationSegment> continuation, continuations)
+		{
+			if ((it = costs.find(continuation->getId())) != costs.end())
+			{
+				segmentCosts[i] += it->second;
+			}
+			else
+			{
+				missingContinuations.push_back(continuation);
+				missingIndices.push_back(i);
+				missingIds.push_back(continuation->getId());
+			}
+			
+			++i;
+		}
+		
+		foreach (boost::shared_ptr<BranchSegment> branch, branches)
+		{
+			if ((it = costs.find(branch->getId())) != costs.end())
+			{
+				segmentCosts[i] += it->second;
+			}
+			else
+			{
+				missingBranches.push_back(branch);
+				missingIndices.push_back(i);
+				missingIds.push_back(branch->getId());
+			}
+			
+			++i;
+		}
+	}
+	
+	LOG_DEBUG(cachedcostfunctionlog) << "Evaluating " << missingIndices.size() << " of " << i <<
+		" segments" << std::endl;
+	
+	if (missingIndices.empty())
+	{
+		return;
+	}
+	
+	// Chunks of a few hundred segments, so that small problems are evaluated in one call.
+	unsigned int numChunks = std::max(1u, std::min(defaultNumThreads(),
+		static_cast<unsigned int>(missingIndices.size() / 256)));
+	std::vector<std::vector<double> > chunkCosts(numChunks);
+	
+	parallelFor(numChunks,
+				boost::bind(&CachedCostFunction::evaluateChunk, this, _1, numChunks,
+							boost::cref(missingEnds), boost::cref(missingContinuations),
+							boost::cref(missingBranches), boost::ref(chunkCosts)));
+	
+	// Chunks hold the ends, continuations and branches of their part, in that order.
+	std::vector<double> missingCosts(missingIndices.size());
+	unsigned int endOffset = 0;
+	unsigned int continuationOffset = missingEnds.size();
+	unsigned int branchOffset = missingEnds.size() + missingContinuations.size();
+	
+	for (unsigned int c = 0; c < numChunks; ++c)
+	{
+		unsigned int numEnds = missingEnds.size() * (c + 1) / numChunks -
+			missingEnds.size() * c / numChunks;
+		unsigned int numContinuations = missingContinuations.size() * (c + 1) / numChunks -
+			missingContinuations.size() * c / numChunks;
+		unsigned int numBranches = missingBranches.size() * (c + 1) / numChunks -
+			missingBranches.size() * c / numChunks;
+		std::vector<double>::const_iterator it = chunkCosts[c].begin();
+		
+		std::copy(it, it + numEnds, missingCosts.begin() + endOffset);
+		it += numEnds;
+		std::copy(it, it + numContinuations, missingCosts.begin() + continuationOffset);
+		it += numContinuations;
+		std::copy(it, it + numBranches, missingCosts.begin() + branchOffset);
+		
+		endOffset += numEnds;
+		continuationOffset += numContinuations;
+		branchOffset += numBranches;
+	}
+	
+	boost::mutex::scoped_lock lock(_costMap->mutex);
+	
+	for (unsigned int j = 0; j < missingIndices.size(); ++j)
+	{
+		segmentCosts[missingIndices[j]] += missingCosts[j];
+		_costMap->costs[missingIds[j]] = missingCosts[j];
+	}
+}
+
+void
+CachedCostFunction::evaluateChunk(unsigned int chunk,
+								  unsigned int numChunks,
+								  const std::vector<boost::shared_ptr<EndSegment> >& ends,
+								  const std::vector<boost::shared_ptr<ContinuationSegment> >& continuations,
+								  const std::vector<boost::shared_ptr<BranchSegment> >& branches,
+								  std::vector<std::vector<double> >& chunkCosts)
+{
+	std::vector<boost::shared_ptr<EndSegment> > chunkEnds;
+	std::vector<boost::shared_ptr<ContinuationSegment> > chunkContinuations;
+	std::vector<boost::shared_ptr<BranchSegment> > chunkBranches;
+	
+	chunkOf(ends, chunk, numChunks, chunkEnds);
+	chunkOf(continuations, chunk, numChunks, chunkContinuations);
+	chunkOf(branches, chunk, numChunks, chunkBranches);
+	
+	// The wrapped function adds to the given costs, start from zero.
+	chunkCosts[chunk].assign(chunkEnds.size() + chunkContinuations.size() + chunkBranches.size(),
+							 0.0);
+	
+	(*_costFunction)(chunkEnds, chunkContinuations, chunkBranches, chunkCosts[chunk]);
+}
+
+template <typename SegmentType>
+void
+CachedCostFunction::chunkOf(const std::vector<boost::shared_ptr<SegmentType> >& segments,
+							unsigned int chunk,
+							unsigned int numChunks,
+							std::vector<boost::shared_ptr<SegmentType> >& result)
+{
+	result.assign(segments.begin() + segments.size() * chunk / numChunks,
+				  segments.begin() + segments.size() * (chunk + 1) / numChunks);
+}
+
+boost::shared_ptr<CachedCostFunction::CostMap>
+CachedCostFunction::getCostMap(std::size_t key)
+{
+	boost::mutex::scoped_lock lock(_costMapsMutex);
+	boost::shared_ptr<CostMap>& costMap = _costMaps[key];
+	
+	if (!costMap)
+	{
+		costMap = boost::make_shared<CostMap>();
+	}
+	
+	return costMap;
+}
@@ -0,0 +1,89 @@
+#ifndef CACHED_COST_FUNCTION_H__
+#define CACHED_COST_FUNCTION_H__
+
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <pipeline/all.h>
+#include <sopnet/segments/EndSegment.h>
+#include <sopnet/segments/ContinuationSegment.h>
+#include <sopnet/segments/BranchSegment.h>
+
+/**
+ * Memoises the costs of a segment cost function by segment id.
+ *
+ * Costs are remembered process-wide under the input "key" that identifies the wrapped
+ * function, e.g., the hash of the random forest it uses, so that overlapping windows solved by
+ * different CoreSolvers evaluate every segment only once. When the function changes, set a new
+ * key and remove the costs of the old one. Segments without a remembered cost are
+ * evaluated in chunks on several threads, so the wrapped function has to be safe to call
+ * concurrently.
+ */
+class CachedCostFunction : public pipeline::SimpleProcessNode<>
+{
+	typedef boost::function<
+			void
+			(const std::vector<boost::shared_ptr<EndSegment> >&          ends,
+			 const std::vector<boost::shared_ptr<ContinuationSegment> >& continuations,
+			 const std::vector<boost::shared_ptr<BranchSegment> >&       branches,
+			 std::vector<double>& segmentCosts)>
+			costs_function_type;
+
+	struct CostMap
+	{
+		boost::unordered_map<unsigned int, double> costs;
+		boost::mutex mutex;
+	};
+
+public:
+	CachedCostFunction();
+
+	/**
+	 * Forget the remembered costs for the given key.
+	 */
+	static void clear(std::size_t key);
+
+	/**
+	 * Forget the given key altogether, e.g., after the function it identified was replaced.
+	 * CachedCostFunctions still using the key keep their costs until they get a new one.
+	 */
+	static void remove(std::size_t key);
+
+private:
+
+	void updateOutputs();
+
+	void costs(const std::vector<boost::shared_ptr<EndSegment> >& ends,
+			   const std::vector<boost::shared_ptr<ContinuationSegment> >& continuations,
+			   const std::vector<boost::shared_ptr<BranchSegment> >& branches,
+			   std::vector<double>& segmentCosts);
+
+	void evaluateChunk(unsigned int chunk,
+					   unsigned int numChunks,
+					   const std::vector<boost::shared_ptr<EndSegment> >& ends,
+					   const std::vector<boost::shared_ptr<ContinuationSegment> >& continuations,
+					   const std::vector<boost::shared_ptr<BranchSegment> >& branches,
+					   std::vector<std::vector<double> >& chunkCosts);
+
+	template <typename SegmentType>
+	static void chunkOf(const std::vector<boost::shared_ptr<SegmentType> >& segments,
+						unsigned int chunk,
+						unsigned int numChunks,
+						std::vector<boost::shared_ptr<SegmentType> >& result);
+
+	static boost::shared_ptr<CostMap> getCostMap(std::size_t key);
+
+	pipeline::Input<costs_function_type> _costFunction;
+	pipeline::Input<std::size_t> _key;
+
+	pipeline::Output<costs_function_type> _cachedCostFunction;
+
+	boost::shared_ptr<CostMap> _costMap;
+
+	static boost::unordered_map<std::size_t, boost::shared_ptr<CostMap> > _costMaps;
+	static boost::mutex _costMapsMutex;
+};
+
+#endif //CACHED_COST_FUNCTION_H__
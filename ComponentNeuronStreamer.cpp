@@ -0,0 +1,115 @@
+#include "ComponentNeuronStreamer.h"
+
+#include <boost/make_shared.hpp>
+#include <pipeline/Value.h>
+#include <sopnet/neurons/NeuronExtractor.h>
+#include <util/foreach.h>
+
+ComponentNeuronStreamer::ComponentNeuronStreamer(
+		const boost::shared_ptr<NeuronStream>& stream,
+		const boost::shared_ptr<Segments>& segments,
+		const boost::shared_ptr<ProblemConfiguration>& configuration) :
+	_stream(stream),
+	_configuration(configuration)
+{
+	const std::vector<boost::shared_ptr<Segment> >& allSegments = segments->getSegments();
+	std::vector<unsigned int> parents(allSegments.size());
+	// The first segment using a slice.
+	boost::unordered_map<unsigned int, unsigned int> sliceSegments;
+	boost::unordered_map<unsigned int, unsigned int> rootGroups;
+	
+	for (unsigned int i = 0; i < allSegments.size(); ++i)
+	{
+		parents[i] = i;
+	}
+	
+	// Union-find over the segments, joining those that share a slice.
+	for (unsigned int i = 0; i < allSegments.size(); ++i)
+	{
+		_idSegmentMap[allSegments[i]->getId()] = allSegments[i];
+		
+		foreach (boost::shared_ptr<Slice> slice, allSegments[i]->getSlices())
+		{
+			boost::unordered_map<unsigned int, unsigned int>::iterator it =
+				sliceSegments.find(slice->getId());
+			
+			if (it == sliceSegments.end())
+			{
+				sliceSegments[slice->getId()] = i;
+			}
+			else
+			{
+				parents[findRoot(parents, i)] = findRoot(parents, it->second);
+			}
+		}
+	}
+	
+	for (unsigned int i = 0; i < allSegments.size(); ++i)
+	{
+		unsigned int root = findRoot(parents, i);
+		boost::unordered_map<unsigned int, unsigned int>::iterator it = rootGroups.find(root);
+		
+		if (it == rootGroups.end())
+		{
+			it = rootGroups.insert(std::make_pair(root, _groups.size())).first;
+			
+			_groups.push_back(Group());
+			_groups.back().chosen = boost::make_shared<Segments>();
+		}
+		
+		_segmentGroups[allSegments[i]->getId()] = it->second;
+		++_groups[it->second].pending;
+	}
+}
+
+void
+ComponentNeuronStreamer::componentSolved(const std::vector<unsigned int>& variables,
+										 const std::vector<double>& values)
+{
+	std::vector<boost::shared_ptr<Segments> > completed;
+	
+	{
+		// Called concurrently, the maps are only read, the groups are locked.
+		boost::mutex::scoped_lock lock(_groupsMutex);
+		
+		for (unsigned int i = 0; i < variables.size(); ++i)
+		{
+			unsigned int segmentId = _configuration->getSegmentId(variables[i]);
+			Group& group = _groups[_segmentGroups.find(segmentId)->second];
+			
+			if (values[i] == 1)
+			{
+				group.chosen->add(_idSegmentMap.find(segmentId)->second);
+			}
+			
+			if (--group.pending == 0 && group.chosen->size() > 0)
+			{
+				completed.push_back(group.chosen);
+			}
+		}
+	}
+	
+	foreach (boost::shared_ptr<Segments> chosen, completed)
+	{
+		boost::shared_ptr<NeuronExtractor> neuronExtractor =
+			boost::make_shared<NeuronExtractor>();
+		
+		neuronExtractor->setInput("segments", chosen);
+		
+		pipeline::Value<SegmentTrees> neurons = neuronExtractor->getOutput();
+		
+		_stream->emit(neurons);
+	}
+}
+
+unsigned int
+ComponentNeuronStreamer::findRoot(std::vector<unsigned int>& parents, unsigned int i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	
+	return i;
+}
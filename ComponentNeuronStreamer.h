@@ -0,0 +1,57 @@
+#ifndef COMPONENT_NEURON_STREAMER_H__
+#define COMPONENT_NEURON_STREAMER_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <sopnet/inference/ProblemConfiguration.h>
+#include <sopnet/segments/Segments.h>
+#include <catmaidsopnet/DecomposingLinearSolver.h>
+#include <catmaidsopnet/NeuronStream.h>
+
+/**
+ * Turns the chosen segments of solved components into neurons and passes them on to a
+ * NeuronStream.
+ *
+ * The components of the solver are those of the presolved problem, where a neuron may be
+ * split, e.g., into the variables the presolver fixed and the rest. Therefore, the segments
+ * are grouped by shared slices before solving, and the neurons of a group are emitted once
+ * all its segments have been decided, as a whole and exactly once.
+ */
+class ComponentNeuronStreamer : public ComponentListener
+{
+public:
+	ComponentNeuronStreamer(const boost::shared_ptr<NeuronStream>& stream,
+							const boost::shared_ptr<Segments>& segments,
+							const boost::shared_ptr<ProblemConfiguration>& configuration);
+
+	void componentSolved(const std::vector<unsigned int>& variables,
+						 const std::vector<double>& values);
+
+private:
+
+	struct Group
+	{
+		Group() : pending(0) {}
+
+		// The segments of the group that have not been decided yet.
+		unsigned int pending;
+
+		boost::shared_ptr<Segments> chosen;
+	};
+
+	static unsigned int findRoot(std::vector<unsigned int>& parents, unsigned int i);
+
+	boost::shared_ptr<NeuronStream> _stream;
+	boost::shared_ptr<ProblemConfiguration> _configuration;
+
+	// The group of every segment, by segment id.
+	boost::unordered_map<unsigned int, unsigned int> _segmentGroups;
+	boost::unordered_map<unsigned int, boost::shared_ptr<Segment> > _idSegmentMap;
+
+	std::vector<Group> _groups;
+	boost::mutex _groupsMutex;
+};
+
+#endif //COMPONENT_NEURON_STREAMER_H__
@@ -0,0 +1,83 @@
+#include "ComponentSliceMap.h"
+
+#include <util/foreach.h>
+
+void
+ComponentSliceMap::insert(const boost::shared_ptr<Slice>& slice)
+{
+	boost::shared_ptr<ConnectedComponent> component = slice->getComponent();
+	
+	if (_idSliceMap.count(slice->getId()))
+	{
+		return;
+	}
+	
+	_idSliceMap[slice->getId()] = slice;
+	_pointerSliceMap[component.get()] = slice;
+	_fingerprintIdMap.insert(std::make_pair(fingerprint(*component), slice->getId()));
+}
+
+boost::shared_ptr<Slice>
+ComponentSliceMap::find(const boost::shared_ptr<ConnectedComponent>& component) const
+{
+	PointerSliceMap::const_iterator pit = _pointerSliceMap.find(component.get());
+	
+	if (pit != _pointerSliceMap.end())
+	{
+		return pit->second;
+	}
+	
+	std::pair<FingerprintIdMap::const_iterator, FingerprintIdMap::const_iterator> range =
+		_fingerprintIdMap.equal_range(fingerprint(*component));
+	
+	for (FingerprintIdMap::const_iterator it = range.first; it != range.second; ++it)
+	{
+		const boost::shared_ptr<Slice>& slice = _idSliceMap.find(it->second)->second;
+		
+		if (sameShape(*slice->getComponent(), *component) &&
+			*slice->getComponent() == *component)
+		{
+			return slice;
+		}
+	}
+	
+	return boost::shared_ptr<Slice>();
+}
+
+void
+ComponentSliceMap::clear()
+{
+	_pointerSliceMap.clear();
+	_fingerprintIdMap.clear();
+	_idSliceMap.clear();
+}
+
+boost::uint64_t
+ComponentSliceMap::fingerprint(const ConnectedComponent& component)
+{
+	boost::uint64_t fp = 0;
+	
+	// Mix each pixel with a 64-bit finalizer and sum, so that pixel order does not matter.
+	foreach (const ConnectedComponent::pixel_type& pixel, component.getPixels())
+	{
+		boost::uint64_t h = (static_cast<boost::uint64_t>(pixel.x) << 32) | pixel.y;
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		fp += h;
+	}
+	
+	return fp ^ (static_cast<boost::uint64_t>(component.getSize()) * 0x9e3779b97f4a7c15ULL);
+}
+
+bool
+ComponentSliceMap::sameShape(const ConnectedComponent& c1, const ConnectedComponent& c2)
+{
+	const util::rect<int>& b1 = c1.getBoundingBox();
+	const util::rect<int>& b2 = c2.getBoundingBox();
+	
+	return c1.getSize() == c2.getSize() &&
+		b1.minX == b2.minX && b1.minY == b2.minY && b1.maxX == b2.maxX && b1.maxY == b2.maxY;
+}
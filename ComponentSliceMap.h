@@ -0,0 +1,55 @@
+#ifndef COMPONENT_SLICE_MAP_H__
+#define COMPONENT_SLICE_MAP_H__
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <imageprocessing/ConnectedComponent.h>
+#include <sopnet/slices/Slice.h>
+
+/**
+ * Maps ConnectedComponents to the Slices that own them, without hashing pixel lists on every
+ * access.
+ *
+ * Components are looked up by address first, which covers the common case of component tree
+ * nodes that share their component with a Slice. Otherwise, a 64-bit fingerprint of the
+ * component is computed once and candidates are verified by size and bounding box before the
+ * full pixel comparison.
+ */
+class ComponentSliceMap
+{
+	typedef boost::unordered_map<const ConnectedComponent*, boost::shared_ptr<Slice> >
+		PointerSliceMap;
+	typedef boost::unordered_multimap<boost::uint64_t, unsigned int> FingerprintIdMap;
+	typedef boost::unordered_map<unsigned int, boost::shared_ptr<Slice> > IdSliceMap;
+	
+public:
+	/**
+	 * Add a slice, keyed by its component. Computes the component's fingerprint.
+	 */
+	void insert(const boost::shared_ptr<Slice>& slice);
+	
+	/**
+	 * Find the slice whose component equals the given one, or an empty pointer.
+	 */
+	boost::shared_ptr<Slice> find(const boost::shared_ptr<ConnectedComponent>& component) const;
+	
+	unsigned int size() const { return _idSliceMap.size(); }
+	
+	void clear();
+	
+	/**
+	 * An order-independent 64-bit fingerprint over the pixels of a component.
+	 */
+	static boost::uint64_t fingerprint(const ConnectedComponent& component);
+	
+private:
+	
+	static bool sameShape(const ConnectedComponent& c1, const ConnectedComponent& c2);
+	
+	PointerSliceMap _pointerSliceMap;
+	FingerprintIdMap _fingerprintIdMap;
+	IdSliceMap _idSliceMap;
+};
+
+#endif //COMPONENT_SLICE_MAP_H__
@@ -0,0 +1,182 @@
+#include "ComponentTreeBuilder.h"
+
+#include <algorithm>
+#include <boost/make_shared.hpp>
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel componenttreebuilderlog("componenttreebuilderlog", "[ComponentTreeBuilder] ");
+
+ComponentTreeBuilder::ComponentTreeBuilder(int cellSize) :
+	_cellSize(std::max(cellSize, 1))
+{
+}
+
+boost::shared_ptr<ComponentTree>
+ComponentTreeBuilder::build(const Slices& slices)
+{
+	std::vector<boost::shared_ptr<ConnectedComponent> > components;
+	boost::shared_ptr<ComponentTree> tree = boost::make_shared<ComponentTree>();
+	boost::shared_ptr<ConnectedComponent> empty = boost::make_shared<ConnectedComponent>();
+	boost::shared_ptr<Node> root = boost::make_shared<Node>(empty);
+
+	_nodes.clear();
+	_components.clear();
+	_parents.clear();
+	_visited.clear();
+	_grid.clear();
+
+	foreach (boost::shared_ptr<Slice> slice, slices)
+	{
+		components.push_back(slice->getComponent());
+	}
+
+	// Sort connected components by size, in descending order.
+	std::stable_sort(components.begin(), components.end(), &ComponentTreeBuilder::compareSize);
+
+	for (unsigned int i = 0; i < components.size(); ++i)
+	{
+		_nodes.push_back(boost::make_shared<Node>(components[i]));
+		_components.push_back(RunLengthComponent(*components[i]));
+		_parents.push_back(-1);
+		_visited.push_back(0);
+
+		int parent = findParent(i);
+
+		if (parent < 0)
+		{
+			root->addChild(_nodes[i]);
+			_nodes[i]->setParent(root);
+		}
+		else
+		{
+			_nodes[parent]->addChild(_nodes[i]);
+			_nodes[i]->setParent(_nodes[parent]);
+			_parents[i] = parent;
+		}
+
+		insert(i);
+	}
+
+	tree->setRoot(root);
+
+	LOG_DEBUG(componenttreebuilderlog) << "Built tree of " << _nodes.size() << " components with "
+		<< root->getChildren().size() << " roots" << std::endl;
+
+	return tree;
+}
+
+int
+ComponentTreeBuilder::findParent(unsigned int index)
+{
+	const RunLengthComponent& component = _components[index];
+	std::vector<unsigned int> candidates;
+	int current = -1;
+
+	collectCandidates(component.getBoundingBox(), candidates);
+
+	// Nodes are numbered in order of insertion, which is also the order in which they appear
+	// among the children of their parent. The first intersecting candidate under the current
+	// node is therefore the first intersecting child.
+	std::sort(candidates.begin(), candidates.end());
+
+	while (true)
+	{
+		int next = -1;
+
+		foreach (unsigned int candidate, candidates)
+		{
+			if (_parents[candidate] == current && _components[candidate].intersects(component))
+			{
+				next = candidate;
+				break;
+			}
+		}
+
+		if (next < 0)
+		{
+			return current;
+		}
+
+		current = next;
+	}
+}
+
+void
+ComponentTreeBuilder::collectCandidates(const util::rect<int>& bound,
+										std::vector<unsigned int>& candidates)
+{
+	// Queries are stamped with the index of the queried component plus one, which is unique.
+	unsigned int stamp = _nodes.size();
+
+	if (bound.maxX <= bound.minX || bound.maxY <= bound.minY)
+	{
+		return;
+	}
+
+	for (int y = cell(bound.minY); y <= cell(bound.maxY - 1); ++y)
+	{
+		for (int x = cell(bound.minX); x <= cell(bound.maxX - 1); ++x)
+		{
+			Grid::const_iterator it = _grid.find(Cell(x, y));
+
+			if (it == _grid.end())
+			{
+				continue;
+			}
+
+			foreach (unsigned int candidate, it->second)
+			{
+				if (_visited[candidate] == stamp)
+				{
+					continue;
+				}
+
+				_visited[candidate] = stamp;
+
+				const util::rect<int>& other = _components[candidate].getBoundingBox();
+
+				if (other.minX < bound.maxX && bound.minX < other.maxX &&
+					other.minY < bound.maxY && bound.minY < other.maxY)
+				{
+					candidates.push_back(candidate);
+				}
+			}
+		}
+	}
+}
+
+void
+ComponentTreeBuilder::insert(unsigned int index)
+{
+	const util::rect<int>& bound = _components[index].getBoundingBox();
+
+	if (bound.maxX <= bound.minX || bound.maxY <= bound.minY)
+	{
+		return;
+	}
+
+	for (int y = cell(bound.minY); y <= cell(bound.maxY - 1); ++y)
+	{
+		for (int x = cell(bound.minX); x <= cell(bound.maxX - 1); ++x)
+		{
+			_grid[Cell(x, y)].push_back(index);
+		}
+	}
+}
+
+int
+ComponentTreeBuilder::cell(int coordinate) const
+{
+	// Round towards negative infinity
+	return coordinate >= 0 ?
+		coordinate / _cellSize :
+		-((-coordinate + _cellSize - 1) / _cellSize);
+}
+
+bool
+ComponentTreeBuilder::compareSize(const boost::shared_ptr<ConnectedComponent>& comp1,
+								  const boost::shared_ptr<ConnectedComponent>& comp2)
+{
+	return comp1->getSize() > comp2->getSize();
+}
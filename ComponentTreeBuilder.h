@@ -0,0 +1,64 @@
+#ifndef COMPONENT_TREE_BUILDER_H__
+#define COMPONENT_TREE_BUILDER_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <imageprocessing/ComponentTree.h>
+#include <sopnet/slices/Slices.h>
+#include <catmaidsopnet/persistence/RunLengthComponent.h>
+
+/**
+ * Rebuilds a ComponentTree from the flat Slices of one section, by nesting the components of
+ * the Slices in order of decreasing size.
+ *
+ * Each component becomes a child of the first already inserted node that it intersects,
+ * descending through the first intersecting child on each level. Already inserted nodes are
+ * kept in a uniform grid over their bounding boxes, so that only nodes with overlapping
+ * bounding boxes are considered, and intersections are tested on run-length encodings of
+ * the components.
+ */
+class ComponentTreeBuilder
+{
+	typedef ComponentTree::Node Node;
+	typedef std::pair<int, int> Cell;
+	typedef boost::unordered_map<Cell, std::vector<unsigned int> > Grid;
+
+public:
+	/**
+	 * @param cellSize - the edge length of the grid cells in pixels.
+	 */
+	ComponentTreeBuilder(int cellSize = 64);
+
+	boost::shared_ptr<ComponentTree> build(const Slices& slices);
+
+private:
+
+	/**
+	 * Find the node to attach the component with the given index to, or -1 if it does not
+	 * intersect any inserted node.
+	 */
+	int findParent(unsigned int index);
+
+	void collectCandidates(const util::rect<int>& bound, std::vector<unsigned int>& candidates);
+
+	void insert(unsigned int index);
+
+	int cell(int coordinate) const;
+
+	static bool compareSize(const boost::shared_ptr<ConnectedComponent>& comp1,
+							const boost::shared_ptr<ConnectedComponent>& comp2);
+
+	int _cellSize;
+
+	// Per component, in order of insertion
+	std::vector<boost::shared_ptr<Node> > _nodes;
+	std::vector<RunLengthComponent> _components;
+	std::vector<int> _parents;
+	// The last query each node was collected for, to collect it only once per query.
+	std::vector<unsigned int> _visited;
+
+	Grid _grid;
+};
+
+#endif //COMPONENT_TREE_BUILDER_H__
@@ -1,7 +1,9 @@
 #include "ComponentTreeExtractor.h"
 
+#include <algorithm>
 #include <util/Logger.h>
 #include <boost/unordered_map.hpp>
+#include <catmaidsopnet/SliceSegmentIncidence.h>
 
 logger::LogChannel componenttreeextractorlog("componenttreeextractorlog", "[ComponentTreeExtractor] ");
 
@@ -23,16 +25,29 @@ void
 ComponentTreeExtractor::updateOutputs()
 {
 	boost::shared_ptr<ComponentTrees> trees = boost::make_shared<ComponentTrees>();
-	boost::unordered_set<Slice> sliceSet;
-	boost::shared_ptr<LinearConstraints> constraints = boost::make_shared<LinearConstraints>();
+	boost::shared_ptr<Slices> slices = boost::make_shared<Slices>(*_slices);
+	boost::shared_ptr<SparseConstraintMatrix> constraints =
+		boost::make_shared<SparseConstraintMatrix>();
+	boost::shared_ptr<ConflictSets> conflictSets = retrieveConflictSets();
 	
-	foreach (boost::shared_ptr<Slice> slice, *_slices)
+	if (conflictSets->size() > 0)
 	{
-		sliceSet.insert(*slice);
+		// The store holds the conflict cliques directly, no need to rebuild the trees.
+		insertConflictSets(conflictSets, slices, constraints);
+	}
+	else
+	{
+		boost::unordered_set<Slice> sliceSet;
+		
+		foreach (boost::shared_ptr<Slice> slice, *_slices)
+		{
+			sliceSet.insert(*slice);
+		}
+		
+		insertSlicesIntoTrees(trees, slices, constraints, sliceSet);
 	}
 	
-	insertSlicesIntoTrees(trees, constraints, sliceSet);
-	
+	// Over segment ids for the ProblemMatrixAssembler, over slice ids without segments.
 	if (_segments)
 	{
 		*_constraints = *assembleSegmentConstraints(constraints);
@@ -43,17 +58,75 @@ ComponentTreeExtractor::updateOutputs()
 	}
 	
 	*_componentTrees = *trees;
-	*_slicesOut = *_slices;
+	*_slicesOut = *slices;
 	
-	LOG_DEBUG(componenttreeextractorlog) << "Generated " << constraints->size() <<
+	LOG_DEBUG(componenttreeextractorlog) << "Generated " << constraints->numRows() <<
 		" constraints" << std::endl;
 }
 
 
+boost::shared_ptr<ConflictSets>
+ComponentTreeExtractor::retrieveConflictSets()
+{
+	boost::shared_ptr<ConflictSets> conflictSets = boost::make_shared<ConflictSets>();
+	
+	foreach (boost::shared_ptr<Block> block, *_blocks)
+	{
+		conflictSets->addAll(*_store->retrieveConflictSets(block));
+	}
+	
+	return conflictSets;
+}
+
+/**
+ * Restrict each stored conflict clique to the slices we were given and add a constraint for
+ * each distinct result.
+ */
+void
+ComponentTreeExtractor::insertConflictSets(const boost::shared_ptr<ConflictSets>& conflictSets,
+										   const boost::shared_ptr<Slices>& outputSlices,
+										   const boost::shared_ptr<SparseConstraintMatrix>& constraints)
+{
+	boost::unordered_set<unsigned int> sliceIds;
+	boost::unordered_set<std::vector<unsigned int> > cliques;
+	
+	LOG_DEBUG(componenttreeextractorlog) << "Using " << conflictSets->size() <<
+		" stored conflict sets" << std::endl;
+	
+	foreach (boost::shared_ptr<Slice> slice, *_slices)
+	{
+		sliceIds.insert(slice->getId());
+	}
+	
+	foreach (const ConflictSet& conflictSet, *conflictSets)
+	{
+		std::vector<unsigned int> clique;
+		
+		foreach (unsigned int id, conflictSet.getSlices())
+		{
+			if (sliceIds.count(id))
+			{
+				clique.push_back(id);
+			}
+		}
+		
+		std::sort(clique.begin(), clique.end());
+		
+		// Conflict sets are stored with every block they touch, so expect duplicates.
+		if (!clique.empty() && cliques.insert(clique).second)
+		{
+			addConflict(clique, outputSlices, constraints);
+		}
+	}
+	
+	LOG_DEBUG(componenttreeextractorlog) << "Done." << std::endl;
+}
+
 void
 ComponentTreeExtractor::insertSlicesIntoTrees(
 										const boost::shared_ptr<ComponentTrees>& trees,
-										const boost::shared_ptr<LinearConstraints>& constraints,
+										const boost::shared_ptr<Slices>& outputSlices,
+										const boost::shared_ptr<SparseConstraintMatrix>& constraints,
 										const boost::unordered_set<Slice>& sliceSet)
 {
 	std::map<unsigned int, boost::shared_ptr<Slices> > rootSlices;
@@ -90,7 +163,7 @@ ComponentTreeExtractor::insertSlicesIntoTrees(
 			boost::shared_ptr<ComponentTree::Node> rootNode = 
 				boost::make_shared<ComponentTree::Node>(slice->getComponent());
 			
-			addNode(rootNode, slice, sliceSet, slices, constraints, idq);
+			addNode(rootNode, slice, sliceSet, outputSlices, constraints, idq);
 			rootNode->setParent(fakeNode);
 		}
 		
@@ -106,10 +179,10 @@ ComponentTreeExtractor::addNode(const boost::shared_ptr<ComponentTree::Node>& no
 								const boost::shared_ptr<Slice>& slice,
 								const boost::unordered_set<Slice>& sliceSet,
 								const boost::shared_ptr<Slices>& outputSlices,
-								const boost::shared_ptr<LinearConstraints>& constraints,
+								const boost::shared_ptr<SparseConstraintMatrix>& constraints,
 								std::deque<unsigned int>& slice_ids)
 {
-	bool addConflict = true;
+	bool isLeaf = true;
 	
 	slice_ids.push_back(slice->getId());
 	
@@ -126,94 +199,53 @@ ComponentTreeExtractor::addNode(const boost::shared_ptr<ComponentTree::Node>& no
 				boost::make_shared<ComponentTree::Node>(childSlice->getComponent());
 
 			// if this node has a child, then we are not ready to add the conflict info.
-			addConflict = false;
+			isLeaf = false;
 			childNode->setParent(node);
 			addNode(childNode, childSlice, sliceSet, outputSlices, constraints, slice_ids);
 		}
 	}
 
-	if (addConflict)
+	if (isLeaf)
 	{
-		LinearConstraint constraint;
-		
-		foreach (unsigned int id, slice_ids)
-		{
-			constraint.setCoefficient(id, 1);
-		}
-		
-		if (_forceExplanation && ! *_forceExplanation)
-		{
-			constraint.setRelation(LessEqual);
-		}
-		else
-		{
-			constraint.setRelation(Equal);
-		}
-
-		
-		constraint.setValue(1);
-
-		outputSlices->addConflicts(slice_ids);
+		addConflict(std::vector<unsigned int>(slice_ids.begin(), slice_ids.end()),
+					outputSlices, constraints);
 	}
 
 	slice_ids.pop_back();
 }
 
+void
+ComponentTreeExtractor::addConflict(const std::vector<unsigned int>& sliceIds,
+									const boost::shared_ptr<Slices>& outputSlices,
+									const boost::shared_ptr<SparseConstraintMatrix>& constraints)
+{
+	Relation relation = (_forceExplanation && !*_forceExplanation) ? LessEqual : Equal;
+	
+	constraints->addUnitRow(sliceIds.begin(), sliceIds.end(), relation, 1);
+
+	outputSlices->addConflicts(sliceIds);
+}
 
-boost::shared_ptr<LinearConstraints>
+
+boost::shared_ptr<SparseConstraintMatrix>
 ComponentTreeExtractor::assembleSegmentConstraints(
-	const boost::shared_ptr<LinearConstraints>& sliceConstraints)
+	const boost::shared_ptr<SparseConstraintMatrix>& sliceConstraints)
 {
 	LOG_DEBUG(componenttreeextractorlog) << "Assembling segment constraints" << std::endl;
 	
-	boost::unordered_map<unsigned int, std::vector<unsigned int> > sliceSegments;
-	boost::shared_ptr<LinearConstraints> segmentConstraints = 
-		boost::make_shared<LinearConstraints>();
-	//First, map segment ids to slice ids;
-		
+	SliceSegmentIncidence sliceSegments;
+	
 	foreach (boost::shared_ptr<Segment> segment, _segments->getSegments())
 	{
-		foreach(boost::shared_ptr<Slice> slice, segment->getSlices())
-		{
-			sliceSegments[slice->getId()].push_back(segment->getId());
-		}
-	}
-		
-	//Code here lifted from SegmentExtractor::assembleLinearConstraints.
-		
-		
-	foreach (const LinearConstraint& sliceConstraint, *sliceConstraints)
-	{
-		LinearConstraint constraint;
-		
-		// for each slice in the constraint
-		typedef std::map<unsigned int, double>::value_type pair_t;
-		foreach (const pair_t& pair, sliceConstraint.getCoefficients()) {
-
-			unsigned int sliceId = pair.first;
-
-			// for all the segments that involve this slice
-			const std::vector<unsigned int> segmentIds = sliceSegments[sliceId];
-
-			foreach (unsigned int segmentId, segmentIds)
-			{
-				constraint.setCoefficient(segmentId, 1.0);
-			}
-		}
-
-		if (_forceExplanation && ! *_forceExplanation)
-		{
-			constraint.setRelation(LessEqual);
-		}
-		else
-		{
-			constraint.setRelation(Equal);
-		}
-
-		constraint.setValue(1);
-		
-		segmentConstraints->add(constraint);
+		sliceSegments.add(*segment);
 	}
+	
+	sliceSegments.finalize();
+	
+	Relation relation = (_forceExplanation && !*_forceExplanation) ? LessEqual : Equal;
+	boost::shared_ptr<SparseConstraintMatrix> segmentConstraints =
+		sliceSegments.lift(*sliceConstraints, relation, 1);
+	
 	LOG_DEBUG(componenttreeextractorlog) << "Done." << std::endl;
 	return segmentConstraints;
 }
@@ -2,6 +2,7 @@
 #define COMPONENT_TREE_EXTRACTOR_H__
 
 #include <deque>
+#include <vector>
 #include <imageprocessing/ComponentTrees.h>
 #include <boost/unordered_set.hpp>
 #include <sopnet/block/Block.h>
@@ -10,6 +11,7 @@
 #include <sopnet/segments/Segments.h>
 #include <pipeline/all.h>
 #include <catmaidsopnet/persistence/SliceStore.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
 
 
 class ComponentTreeExtractor : public pipeline::SimpleProcessNode<>
@@ -20,20 +22,31 @@ public:
 private:
 	void updateOutputs();
 	
+	boost::shared_ptr<ConflictSets> retrieveConflictSets();
+	
+	void insertConflictSets(const boost::shared_ptr<ConflictSets>& conflictSets,
+							const boost::shared_ptr<Slices>& outputSlices,
+							const boost::shared_ptr<SparseConstraintMatrix>& constraints);
+	
 	void insertSlicesIntoTrees(
 								 const boost::shared_ptr<ComponentTrees>& trees,
-								 const boost::shared_ptr<LinearConstraints>& constraints,
+								 const boost::shared_ptr<Slices>& outputSlices,
+								 const boost::shared_ptr<SparseConstraintMatrix>& constraints,
 								 const boost::unordered_set<Slice>& sliceSet);
 	
 	void addNode(const boost::shared_ptr<ComponentTree::Node>& node,
 				 const boost::shared_ptr<Slice>& slice,
 				 const boost::unordered_set<Slice>& sliceSet,
 				 const boost::shared_ptr<Slices>& outputSlices,
-				 const boost::shared_ptr<LinearConstraints>& constraints,
+				 const boost::shared_ptr<SparseConstraintMatrix>& constraints,
 				 std::deque<unsigned int>& slice_ids);
 	
-	boost::shared_ptr<LinearConstraints> assembleSegmentConstraints(
-				const boost::shared_ptr<LinearConstraints>& sliceConstraints);
+	void addConflict(const std::vector<unsigned int>& sliceIds,
+					 const boost::shared_ptr<Slices>& outputSlices,
+					 const boost::shared_ptr<SparseConstraintMatrix>& constraints);
+	
+	boost::shared_ptr<SparseConstraintMatrix> assembleSegmentConstraints(
+				const boost::shared_ptr<SparseConstraintMatrix>& sliceConstraints);
 	
 	pipeline::Input<Blocks> _blocks;
 	pipeline::Input<SliceStore> _store;
@@ -41,7 +54,7 @@ private:
 	pipeline::Input<Segments> _segments;
 	pipeline::Input<bool> _forceExplanation;
 	
-	pipeline::Output<LinearConstraints> _constraints;
+	pipeline::Output<SparseConstraintMatrix> _constraints;
 	pipeline::Output<ComponentTrees> _componentTrees;
 	pipeline::Output<Slices> _slicesOut;
 	
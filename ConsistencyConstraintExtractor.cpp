@@ -3,13 +3,17 @@
 #include <boost/make_shared.hpp>
 #include <boost/unordered_set.hpp>
 
+#include <algorithm>
 #include <deque>
+#include <boost/bind.hpp>
 
 #include <sopnet/inference/LinearConstraint.h>
 #include <sopnet/slices/Slice.h>
-#include <sopnet/slices/ComponentTreeConverter.h>
 #include <sopnet/segments/Segment.h>
 #include <pipeline/Value.h>
+#include <catmaidsopnet/ComponentTreeBuilder.h>
+#include <catmaidsopnet/ParallelFor.h>
+#include <catmaidsopnet/SliceSegmentIncidence.h>
 #include <util/Logger.h>
 logger::LogChannel consistencyconstraintextractorlog("consistencyconstraintextractorlog",
 													 "[ConsistencyConstraintExtractor] ");
@@ -21,22 +25,26 @@ ConsistencyConstraintExtractor::ConsistencyConstraintExtractor()
 	registerInput(_slices, "slices");
 	registerInput(_segments, "segments");
 	registerInput(_forceExplanation, "force explanation");
-	registerInput(_trees, "component trees");
+	registerInput(_trees, "component trees", pipeline::Optional);
+	registerInput(_conflictSets, "conflict sets", pipeline::Optional);
 	registerOutput(_linearConstraints, "linear constraints");
 }
 
 void ConsistencyConstraintExtractor::updateOutputs()
 {
 	LOG_DEBUG(consistencyconstraintextractorlog) << "Updating outputs" << std::endl;
-	boost::shared_ptr<LinearConstraints> linearConstraints = boost::make_shared<LinearConstraints>();
+	SparseConstraintMatrix constraintMatrix;
 	SectionSlices sliceMap;
 	SectionSlices::const_iterator iter;
+	std::vector<unsigned int> sections;
+	std::vector<boost::shared_ptr<SparseConstraintMatrix> > sectionConstraints;
 	_sliceSet.clear();
 	_sliceSegments.clear();
 	
 	LOG_DEBUG(consistencyconstraintextractorlog) << "Mapping slices to segments" << std::endl;
 	
 	mapSliceSegments();
+	_sliceSegments.finalize();
 
 	LOG_DEBUG(consistencyconstraintextractorlog) << "Mapping slices to sections" << std::endl;
 	
@@ -48,32 +56,75 @@ void ConsistencyConstraintExtractor::updateOutputs()
 	
 	for (iter = sliceMap.begin(); iter != sliceMap.end(); ++iter)
 	{
-		LOG_DEBUG(consistencyconstraintextractorlog) << "Assembling constraints for section " <<
-			iter->first << std::endl;
-		boost::shared_ptr<LinearConstraints> sliceConstraints = 
-			collectSliceConstraints(iter->first, iter->second);
-		boost::shared_ptr<LinearConstraints> segmentConstraints = 
-			assembleSegmentConstraints(sliceConstraints);
-		linearConstraints->addAll(*segmentConstraints);
+		sections.push_back(iter->first);
 	}
 	
-	*_linearConstraints = *linearConstraints;
+	// Sections are independent. Extract them in parallel, then concatenate in section order so
+	// that the output does not depend on scheduling.
+	std::sort(sections.begin(), sections.end());
+	sectionConstraints.resize(sections.size());
+	
+	parallelFor(sections.size(),
+				boost::bind(&ConsistencyConstraintExtractor::extractSectionConstraints, this,
+							_1, boost::cref(sections), boost::ref(sliceMap),
+							boost::ref(sectionConstraints)));
+	
+	foreach (boost::shared_ptr<SparseConstraintMatrix> segmentConstraints, sectionConstraints)
+	{
+		constraintMatrix.addAll(*segmentConstraints);
+	}
+	
+	LOG_DEBUG(consistencyconstraintextractorlog) << "Assembled " << constraintMatrix.numRows() <<
+		" constraints with " << constraintMatrix.numNonZeros() << " non-zeros" << std::endl;
+	
+	*_linearConstraints = constraintMatrix;
 }
 
-boost::shared_ptr<LinearConstraints>
+void
+ConsistencyConstraintExtractor::extractSectionConstraints(
+	unsigned int i,
+	const std::vector<unsigned int>& sections,
+	SectionSlices& sliceMap,
+	std::vector<boost::shared_ptr<SparseConstraintMatrix> >& results)
+{
+	unsigned int section = sections[i];
+	
+	LOG_DEBUG(consistencyconstraintextractorlog) << "Assembling constraints for section " <<
+		section << std::endl;
+	
+	boost::shared_ptr<SparseConstraintMatrix> sliceConstraints = 
+		collectSliceConstraints(section, sliceMap.find(section)->second);
+	results[i] = assembleSegmentConstraints(sliceConstraints);
+}
+
+boost::shared_ptr<SparseConstraintMatrix>
 ConsistencyConstraintExtractor::collectSliceConstraints(unsigned int section,
 														const boost::shared_ptr<Slices>& slices)
 {
-	boost::shared_ptr<ComponentTreeConverter> converter =
-			boost::make_shared<ComponentTreeConverter>(section);
-	boost::shared_ptr<ComponentTree> tree = _trees->getTree(section);
-	boost::shared_ptr<LinearConstraints> sliceConstraints = boost::make_shared<LinearConstraints>();
+	if (_conflictSets)
+	{
+		return collectConflictSetConstraints(slices);
+	}
+	
+	boost::shared_ptr<ComponentTree> tree;
+	boost::shared_ptr<SparseConstraintMatrix> sliceConstraints =
+		boost::make_shared<SparseConstraintMatrix>();
 	std::deque<unsigned int> path;
-	boost::unordered_map<ConnectedComponent, boost::shared_ptr<Slice> > componentSliceMap;
+	ComponentSliceMap componentSliceMap;
 	
 	foreach (boost::shared_ptr<Slice> slice, *slices)
 	{
-		componentSliceMap[*(slice->getComponent())] = slice;
+		componentSliceMap.insert(slice);
+	}
+	
+	if (_trees)
+	{
+		tree = _trees->getTree(section);
+	}
+	else
+	{
+		// No hierarchy is known for these slices, rebuild it from their components.
+		tree = ComponentTreeBuilder().build(*slices);
 	}
 	
 	foreach (boost::shared_ptr<ComponentTree::Node> node, tree->getRoot()->getChildren())
@@ -82,32 +133,66 @@ ConsistencyConstraintExtractor::collectSliceConstraints(unsigned int section,
 		addConstraints(node, sliceConstraints, path, componentSliceMap);
 	}
 	
-	LOG_DEBUG(consistencyconstraintextractorlog) << "Collected " << sliceConstraints->size() <<
+	LOG_DEBUG(consistencyconstraintextractorlog) << "Collected " << sliceConstraints->numRows() <<
 		" constraints" << std::endl;
 	
 	return sliceConstraints;
 }
 
+/**
+ * Read the slice constraints directly from stored conflict sets, restricted to the given slices.
+ */
+boost::shared_ptr<SparseConstraintMatrix>
+ConsistencyConstraintExtractor::collectConflictSetConstraints(
+	const boost::shared_ptr<Slices>& slices)
+{
+	boost::shared_ptr<SparseConstraintMatrix> sliceConstraints =
+		boost::make_shared<SparseConstraintMatrix>();
+	boost::unordered_set<unsigned int> sliceIds;
+	std::vector<unsigned int> clique;
+	
+	foreach (boost::shared_ptr<Slice> slice, *slices)
+	{
+		sliceIds.insert(slice->getId());
+	}
+	
+	foreach (const ConflictSet& conflictSet, *_conflictSets)
+	{
+		clique.clear();
+		
+		foreach (unsigned int id, conflictSet.getSlices())
+		{
+			if (sliceIds.count(id))
+			{
+				clique.push_back(id);
+			}
+		}
+		
+		if (!clique.empty())
+		{
+			sliceConstraints->addUnitRow(clique.begin(), clique.end(), LessEqual, 1);
+		}
+	}
+	
+	LOG_DEBUG(consistencyconstraintextractorlog) << "Collected " << sliceConstraints->numRows() <<
+		" constraints from conflict sets" << std::endl;
+	
+	return sliceConstraints;
+}
+
 void
 ConsistencyConstraintExtractor::addConstraints(const boost::shared_ptr<ComponentTree::Node>& node,
-								const boost::shared_ptr<LinearConstraints>& constraints,
+								const boost::shared_ptr<SparseConstraintMatrix>& constraints,
 								std::deque<unsigned int>& path,
-								boost::unordered_map<ConnectedComponent, boost::shared_ptr<Slice> >&
-																	componentSliceMap)
+								const ComponentSliceMap& componentSliceMap)
 {
-	unsigned int id = componentSliceMap[*node->getComponent()]->getId();
+	unsigned int id = componentSliceMap.find(node->getComponent())->getId();
 	path.push_back(id);
 	
 	if (node->getChildren().size() == 0)
 	{
 		// Cribbed from ComponentTreeConverter::addConstraints
-		LinearConstraint constraint;
-		foreach (unsigned int id, path)
-		{
-			constraint.setCoefficient(id, 1);
-		}
-		constraint.setValue(1);
-		constraints->add(constraint);
+		constraints->addUnitRow(path.begin(), path.end(), LessEqual, 1);
 	}
 	else
 	{
@@ -127,137 +212,21 @@ ConsistencyConstraintExtractor::addConstraints(const boost::shared_ptr<Component
 }
 
 
-boost::shared_ptr<LinearConstraints>
+boost::shared_ptr<SparseConstraintMatrix>
 ConsistencyConstraintExtractor::assembleSegmentConstraints(
-	const boost::shared_ptr<LinearConstraints>& sliceConstraints)
+	const boost::shared_ptr<SparseConstraintMatrix>& sliceConstraints)
 {
 	LOG_DEBUG(consistencyconstraintextractorlog) << "Assembling segment constraints" << std::endl;
-	boost::shared_ptr<LinearConstraints> segmentConstraints = 
-		boost::make_shared<LinearConstraints>();
-	//Code here lifted from SegmentExtractor::assembleLinearConstraints.
-	//It would be a good idea to merge these functions to reduce redundant code.
-	foreach (const LinearConstraint& sliceConstraint, *sliceConstraints)
-	{
-		LinearConstraint constraint;
-		
-		// for each slice in the constraint
-		typedef std::map<unsigned int, double>::value_type pair_t;
-		foreach (const pair_t& pair, sliceConstraint.getCoefficients()) {
-
-			unsigned int sliceId = pair.first;
-
-			// for all the segments that involve this slice
-			const std::vector<unsigned int> segmentIds = _sliceSegments[sliceId];
-
-			foreach (unsigned int segmentId, segmentIds)
-				constraint.setCoefficient(segmentId, 1.0);
-		}
-
-		if (_forceExplanation && ! *_forceExplanation)
-		{
-			constraint.setRelation(LessEqual);
-		}
-		else
-		{
-			constraint.setRelation(Equal);
-		}
-
-		constraint.setValue(1);
-		
-		segmentConstraints->add(constraint);
-	}
+	
+	Relation relation = (_forceExplanation && !*_forceExplanation) ? LessEqual : Equal;
+	boost::shared_ptr<SparseConstraintMatrix> segmentConstraints =
+		_sliceSegments.lift(*sliceConstraints, relation, 1);
+	
 	LOG_DEBUG(consistencyconstraintextractorlog) << "Done." << std::endl;
 	return segmentConstraints;
 }
 
 
-std::vector<boost::shared_ptr<ComponentTree> >
-ConsistencyConstraintExtractor::createComponentTrees(const boost::shared_ptr<Slices>& slices)
-{
-	std::vector<boost::shared_ptr<ComponentTree> > trees;
-	std::vector<boost::shared_ptr<ConnectedComponent> > components;
-	std::vector<boost::shared_ptr<Node> > rootNodes;
-	
-	foreach (boost::shared_ptr<Slice> slice, *slices)
-	{
-		components.push_back(slice->getComponent());
-	}
-	
-	// Sort connected components by size, in descending order.
-	std::sort(components.begin(), components.end(),
-			  &ConsistencyConstraintExtractor::compareConnectedComponents);
-	
-	// Iterate over the Components, inserting into a tree of ComponentTree::Node
-	foreach (boost::shared_ptr<ConnectedComponent> component, components)
-	{
-		boost::shared_ptr<Node> parent = boost::shared_ptr<Node>();
-		boost::shared_ptr<Node> node = boost::make_shared<Node>(component);
-		
-		// We're not necessarily guaranteed to have a single node that overlaps all others.
-		// Find the first node in rootNodes that intersects component
-		foreach (boost::shared_ptr<Node> node, rootNodes)
-		{
-			if (node->getComponent()->intersects(*component))
-			{
-				parent = node;
-				break;
-			}
-		}
-		
-		// If we didn't find a parent, create a new Node for this component and put it in rootNodes
-		if (!parent)
-		{
-			
-			rootNodes.push_back(node);
-		}
-		else
-		{
-			// Otherwise, descend into the tree.
-			boost::shared_ptr<Node> currParent = parent;
-			boost::shared_ptr<Node> nextParent = parent;
-			boost::shared_ptr<Node> nullNode = boost::shared_ptr<Node>();
-			
-			while (nextParent)
-			{
-				currParent = nextParent;
-				nextParent = nullNode;
-				
-				// We know that currParent intersects component
-				// Iterate over the children. The first one that intersects
-				// component, if it exists, will become nextParent.
-				// If it doesn't exist, we'll make component a child of currParent.
-				foreach (boost::shared_ptr<Node> child, currParent->getChildren())
-				{
-					if (child->getComponent()->intersects(*component))
-					{
-						nextParent = child;
-						break;
-					}
-				}
-			}
-			
-			currParent->addChild(node);
-			node->setParent(currParent);
-		}
-	}
-
-	
-	boost::shared_ptr<ComponentTree> tree = boost::make_shared<ComponentTree>();
-	boost::shared_ptr<ConnectedComponent> empty = boost::make_shared<ConnectedComponent>();
-	boost::shared_ptr<Node> node = boost::make_shared<Node>(empty);
-	tree->setRoot(node);
-	
-	foreach (boost::shared_ptr<Node> rootNode, rootNodes)
-	{
-		rootNode->setParent(node);
-		node->addChild(rootNode);
-	}
-	
-	trees.push_back(tree);
-	
-	return trees;
-}
-
 boost::shared_ptr<LinearConstraints>
 ConsistencyConstraintExtractor::mapSliceIds(
 	const boost::shared_ptr<LinearConstraints>& constraints,
@@ -313,34 +282,27 @@ void ConsistencyConstraintExtractor::mapSliceSegments()
 	{
 		if (end->getDirection() == Right)
 		{
-			_sliceSegments[end->getSlice()->getId()].push_back(end->getId());
+			_sliceSegments.add(end->getSlice()->getId(), end->getId());
 		}
 	}
 	
 	foreach (boost::shared_ptr<ContinuationSegment> continuation, _segments->getContinuations())
 	{
-		_sliceSegments[continuation->getSourceSlice()->getId()].push_back(continuation->getId());
+		_sliceSegments.add(continuation->getSourceSlice()->getId(), continuation->getId());
 	}
 	
 	foreach (boost::shared_ptr<BranchSegment> branch, _segments->getBranches())
 	{
 		if (branch->getDirection() == Left)
 		{
-			_sliceSegments[branch->getTargetSlice1()->getId()].push_back(branch->getId());
-			_sliceSegments[branch->getTargetSlice2()->getId()].push_back(branch->getId());
+			_sliceSegments.add(branch->getTargetSlice1()->getId(), branch->getId());
+			_sliceSegments.add(branch->getTargetSlice2()->getId(), branch->getId());
 		}
 		else
 		{
-			_sliceSegments[branch->getSourceSlice()->getId()].push_back(branch->getId());
+			_sliceSegments.add(branch->getSourceSlice()->getId(), branch->getId());
 		}
 	}
 }
 
-bool
-ConsistencyConstraintExtractor::compareConnectedComponents(
-	const boost::shared_ptr<ConnectedComponent>& comp1,
-	const boost::shared_ptr<ConnectedComponent>& comp2)
-{
-	return comp1->getSize() > comp2->getSize();
-}
 
@@ -6,10 +6,14 @@
 #include <boost/unordered_set.hpp>
 #include <pipeline/all.h>
 #include <sopnet/slices/Slices.h>
+#include <sopnet/slices/ConflictSets.h>
 #include <sopnet/segments/Segments.h>
 #include <sopnet/inference/LinearConstraints.h>
 #include <imageprocessing/ComponentTree.h>
 #include <imageprocessing/ComponentTrees.h>
+#include <catmaidsopnet/ComponentSliceMap.h>
+#include <catmaidsopnet/SliceSegmentIncidence.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
 
 class ConsistencyConstraintExtractor : public pipeline::SimpleProcessNode<>
 {
@@ -20,9 +24,6 @@ public:
 private:
 	void updateOutputs();
 	
-	std::vector<boost::shared_ptr<ComponentTree> > createComponentTrees(
-		const boost::shared_ptr<Slices>& slices);
-	
 	boost::shared_ptr<LinearConstraints> mapSliceIds(
 		const boost::shared_ptr<LinearConstraints>& constraints,
 		boost::unordered_map<unsigned int, unsigned int>& idMap);
@@ -31,29 +32,35 @@ private:
 	
 	boost::shared_ptr<Slices> getOrCreate(unsigned int section, SectionSlices& sliceMap);
 	
-	boost::shared_ptr<LinearConstraints> collectSliceConstraints(unsigned int section,
+	void extractSectionConstraints(unsigned int i,
+								   const std::vector<unsigned int>& sections,
+								   SectionSlices& sliceMap,
+								   std::vector<boost::shared_ptr<SparseConstraintMatrix> >& results);
+	
+	boost::shared_ptr<SparseConstraintMatrix> collectSliceConstraints(unsigned int section,
 														const boost::shared_ptr<Slices>& slices);
 	
-	boost::shared_ptr<LinearConstraints> assembleSegmentConstraints(
-		const boost::shared_ptr<LinearConstraints>& sliceConstraints);
+	boost::shared_ptr<SparseConstraintMatrix> collectConflictSetConstraints(
+		const boost::shared_ptr<Slices>& slices);
+	
+	boost::shared_ptr<SparseConstraintMatrix> assembleSegmentConstraints(
+		const boost::shared_ptr<SparseConstraintMatrix>& sliceConstraints);
 	
 	void addConstraints(const boost::shared_ptr<ComponentTree::Node>& node,
-						const boost::shared_ptr<LinearConstraints>& constraints,
+						const boost::shared_ptr<SparseConstraintMatrix>& constraints,
 						std::deque<unsigned int>& path,
-						boost::unordered_map<ConnectedComponent, boost::shared_ptr<Slice> >&
-																				componentSliceMap);
-	
-	static bool compareConnectedComponents(const boost::shared_ptr<ConnectedComponent>& comp1,
-										   const boost::shared_ptr<ConnectedComponent>& comp2);
+						const ComponentSliceMap& componentSliceMap);
 
 	pipeline::Input<Slices> _slices;
 	pipeline::Input<Segments> _segments;
 	pipeline::Input<bool> _forceExplanation;
 	pipeline::Input<ComponentTrees> _trees;
-	pipeline::Output<LinearConstraints> _linearConstraints;
+	pipeline::Input<ConflictSets> _conflictSets;
+	pipeline::Output<SparseConstraintMatrix> _linearConstraints;
 	
 	boost::unordered_set<Slice> _sliceSet;
-	boost::unordered_map<unsigned int, std::vector<unsigned int> > _sliceSegments;
+	// Read concurrently by the section workers, must not be modified while they run.
+	SliceSegmentIncidence _sliceSegments;
 	
 };
 
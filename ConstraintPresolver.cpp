@@ -0,0 +1,392 @@
+#include "ConstraintPresolver.h"
+
+#include <cmath>
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel constraintpresolverlog("constraintpresolverlog", "[ConstraintPresolver] ");
+
+static const double epsilon = 1e-9;
+
+ConstraintPresolver::ConstraintPresolver()
+{
+	registerInput(_constraintsIn, "linear constraints");
+
+	registerOutput(_constraintsOut, "linear constraints");
+	registerOutput(_statistics, "statistics");
+}
+
+void
+ConstraintPresolver::updateOutputs()
+{
+	SparseConstraintMatrix constraints;
+
+	*_statistics = PresolveStatistics();
+	_fixed.clear();
+
+	readRows(*_constraintsIn);
+	removeDuplicates();
+	fixVariables();
+	removeDominated();
+
+	if (_statistics->infeasible)
+	{
+		LOG_ERROR(constraintpresolverlog) << "Problem is infeasible: " <<
+			_statistics->infeasibleConstraints << " constraints can not be satisfied, " <<
+			_statistics->conflictingVariables << " variables are forced to both 0 and 1" <<
+			std::endl;
+
+		// Leave it to the solver to fail, rather than solving a different problem.
+		constraints.addAll(*_constraintsIn);
+
+		_statistics->outputConstraints = constraints.numRows();
+		*_constraintsOut = constraints;
+		_rows.clear();
+
+		return;
+	}
+
+	foreach (const Row& row, _rows)
+	{
+		if (!row.removed)
+		{
+			constraints.addRow(row.variables, row.coefficients, row.relation, row.value);
+		}
+	}
+
+	// Keep the fixed variables in the problem.
+	for (FixedMap::const_iterator it = _fixed.begin(); it != _fixed.end(); ++it)
+	{
+		unsigned int variable = it->first;
+
+		constraints.addUnitRow(&variable, &variable + 1, Equal, it->second);
+	}
+
+	_statistics->fixedVariables = _fixed.size();
+	_statistics->outputConstraints = constraints.numRows();
+
+	LOG_DEBUG(constraintpresolverlog) << "Presolved " << _statistics->inputConstraints <<
+		" constraints to " << _statistics->outputConstraints << ": " <<
+		_statistics->duplicateConstraints << " duplicate, " <<
+		_statistics->emptyConstraints << " empty, " <<
+		_statistics->dominatedConstraints << " dominated, " <<
+		_statistics->fixedVariables << " variables fixed" << std::endl;
+
+	*_constraintsOut = constraints;
+
+	_rows.clear();
+}
+
+void
+ConstraintPresolver::readRows(const SparseConstraintMatrix& constraints)
+{
+	std::vector<std::pair<unsigned int, double> > entries;
+
+	_rows.clear();
+	_rows.reserve(constraints.numRows());
+
+	for (unsigned int i = 0; i < constraints.numRows(); ++i)
+	{
+		Row row;
+		SparseConstraintMatrix::coefficient_iterator coefficient =
+			constraints.coefficientsBegin(i);
+
+		entries.clear();
+
+		for (SparseConstraintMatrix::column_iterator column = constraints.columnsBegin(i);
+			 column != constraints.columnsEnd(i); ++column, ++coefficient)
+		{
+			if (*coefficient != 0)
+			{
+				entries.push_back(std::make_pair(*column, *coefficient));
+			}
+		}
+
+		// The matrix does not keep the columns of a row in order.
+		std::sort(entries.begin(), entries.end());
+
+		row.variables.reserve(entries.size());
+		row.coefficients.reserve(entries.size());
+
+		for (unsigned int j = 0; j < entries.size(); ++j)
+		{
+			row.variables.push_back(entries[j].first);
+			row.coefficients.push_back(entries[j].second);
+		}
+
+		row.relation = constraints.getRelation(i);
+		row.value = constraints.getValue(i);
+
+		_rows.push_back(row);
+	}
+
+	_statistics->inputConstraints = _rows.size();
+}
+
+void
+ConstraintPresolver::removeDuplicates()
+{
+	boost::unordered_map<std::size_t, std::vector<unsigned int> > rowsByHash;
+
+	for (unsigned int i = 0; i < _rows.size(); ++i)
+	{
+		std::vector<unsigned int>& candidates = rowsByHash[hashRow(_rows[i])];
+		bool duplicate = false;
+
+		foreach (unsigned int j, candidates)
+		{
+			if (equalRows(_rows[i], _rows[j]))
+			{
+				duplicate = true;
+				break;
+			}
+		}
+
+		if (duplicate)
+		{
+			_rows[i].removed = true;
+			++_statistics->duplicateConstraints;
+		}
+		else
+		{
+			candidates.push_back(i);
+		}
+	}
+}
+
+void
+ConstraintPresolver::fixVariables()
+{
+	bool changed = true;
+
+	// Fixing a variable can reduce other rows far enough to force more variables, so repeat
+	// until nothing changes.
+	while (changed)
+	{
+		changed = false;
+
+		foreach (Row& row, _rows)
+		{
+			if (!row.removed && reduceRow(row))
+			{
+				changed = true;
+			}
+		}
+	}
+}
+
+bool
+ConstraintPresolver::reduceRow(Row& row)
+{
+	bool fixedAny = false;
+	bool allPositive = true;
+	unsigned int n = 0;
+
+	// substitute fixed variables
+	for (unsigned int i = 0; i < row.variables.size(); ++i)
+	{
+		FixedMap::const_iterator it = _fixed.find(row.variables[i]);
+
+		if (it != _fixed.end())
+		{
+			row.value -= row.coefficients[i] * it->second;
+			continue;
+		}
+
+		row.variables[n] = row.variables[i];
+		row.coefficients[n] = row.coefficients[i];
+		allPositive = allPositive && row.coefficients[n] > 0;
+		++n;
+	}
+
+	row.variables.resize(n);
+	row.coefficients.resize(n);
+
+	if (n == 0)
+	{
+		bool satisfied =
+			(row.relation == LessEqual && row.value >= -epsilon) ||
+			(row.relation == Equal && std::fabs(row.value) <= epsilon) ||
+			(row.relation == GreaterEqual && row.value <= epsilon);
+
+		row.removed = true;
+
+		if (satisfied)
+		{
+			++_statistics->emptyConstraints;
+		}
+		else
+		{
+			++_statistics->infeasibleConstraints;
+			_statistics->infeasible = true;
+		}
+
+		return false;
+	}
+
+	if (n == 1)
+	{
+		// c*x ~ v for a binary x
+		double c = row.coefficients[0];
+		double v = row.value / c;
+		Relation relation = row.relation;
+
+		if (c < 0 && relation != Equal)
+		{
+			relation = (relation == LessEqual ? GreaterEqual : LessEqual);
+		}
+
+		if (relation == Equal && (std::fabs(v) <= epsilon || std::fabs(v - 1) <= epsilon))
+		{
+			fixedAny = fix(row.variables[0], std::fabs(v) <= epsilon ? 0 : 1);
+		}
+		else if (relation == LessEqual && v < 1 - epsilon && v >= -epsilon)
+		{
+			fixedAny = fix(row.variables[0], 0);
+		}
+		else if (relation == GreaterEqual && v > epsilon && v <= 1 + epsilon)
+		{
+			fixedAny = fix(row.variables[0], 1);
+		}
+
+		// Used up, so that it is not counted as empty once the variable is substituted.
+		if (fixedAny)
+		{
+			row.removed = true;
+		}
+
+		return fixedAny;
+	}
+
+	// A sum of positive terms that must not exceed zero forces all of them to zero.
+	if (allPositive && std::fabs(row.value) <= epsilon &&
+		(row.relation == LessEqual || row.relation == Equal))
+	{
+		foreach (unsigned int variable, row.variables)
+		{
+			fixedAny = fix(variable, 0) || fixedAny;
+		}
+
+		row.removed = true;
+	}
+
+	return fixedAny;
+}
+
+bool
+ConstraintPresolver::fix(unsigned int variable, double value)
+{
+	FixedMap::const_iterator it = _fixed.find(variable);
+
+	if (it != _fixed.end())
+	{
+		if (it->second != value)
+		{
+			LOG_DEBUG(constraintpresolverlog) << "Variable " << variable <<
+				" is forced to both 0 and 1" << std::endl;
+
+			++_statistics->conflictingVariables;
+			_statistics->infeasible = true;
+		}
+
+		return false;
+	}
+
+	_fixed[variable] = value;
+
+	return true;
+}
+
+void
+ConstraintPresolver::removeDominated()
+{
+	// Rows by variable, only for unit rows with value 1, ie, set packing and partitioning.
+	boost::unordered_map<unsigned int, std::vector<unsigned int> > variableRows;
+
+	for (unsigned int i = 0; i < _rows.size(); ++i)
+	{
+		const Row& row = _rows[i];
+
+		if (!row.removed && isUnit(row) && std::fabs(row.value - 1) <= epsilon &&
+			(row.relation == LessEqual || row.relation == Equal))
+		{
+			foreach (unsigned int variable, row.variables)
+			{
+				variableRows[variable].push_back(i);
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < _rows.size(); ++i)
+	{
+		Row& row = _rows[i];
+
+		if (row.removed || !isSetPacking(row))
+		{
+			continue;
+		}
+
+		// Any row including this one contains its first variable.
+		foreach (unsigned int j, variableRows[row.variables[0]])
+		{
+			const Row& other = _rows[j];
+
+			if (j != i && !other.removed && other.variables.size() >= row.variables.size() &&
+				includes(other, row))
+			{
+				row.removed = true;
+				++_statistics->dominatedConstraints;
+				break;
+			}
+		}
+	}
+}
+
+bool
+ConstraintPresolver::isSetPacking(const Row& row)
+{
+	return row.relation == LessEqual && std::fabs(row.value - 1) <= epsilon && isUnit(row);
+}
+
+bool
+ConstraintPresolver::isUnit(const Row& row)
+{
+	foreach (double coefficient, row.coefficients)
+	{
+		if (coefficient != 1.0)
+		{
+			return false;
+		}
+	}
+
+	return !row.variables.empty();
+}
+
+bool
+ConstraintPresolver::includes(const Row& row, const Row& subRow)
+{
+	return std::includes(row.variables.begin(), row.variables.end(),
+						 subRow.variables.begin(), subRow.variables.end());
+}
+
+std::size_t
+ConstraintPresolver::hashRow(const Row& row)
+{
+	std::size_t seed = 0;
+
+	boost::hash_combine(seed, row.variables);
+	boost::hash_combine(seed, row.coefficients);
+	boost::hash_combine(seed, static_cast<int>(row.relation));
+	boost::hash_combine(seed, row.value);
+
+	return seed;
+}
+
+bool
+ConstraintPresolver::equalRows(const Row& row1, const Row& row2)
+{
+	return row1.relation == row2.relation && row1.value == row2.value &&
+		row1.variables == row2.variables && row1.coefficients == row2.coefficients;
+}
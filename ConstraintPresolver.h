@@ -0,0 +1,118 @@
+#ifndef CONSTRAINT_PRESOLVER_H__
+#define CONSTRAINT_PRESOLVER_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <pipeline/all.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
+
+/**
+ * Counts of what a ConstraintPresolver removed.
+ */
+class PresolveStatistics : public pipeline::Data
+{
+public:
+	PresolveStatistics() :
+		inputConstraints(0),
+		duplicateConstraints(0),
+		emptyConstraints(0),
+		infeasibleConstraints(0),
+		conflictingVariables(0),
+		fixedVariables(0),
+		dominatedConstraints(0),
+		outputConstraints(0),
+		infeasible(false) {}
+
+	unsigned int inputConstraints;
+	unsigned int duplicateConstraints;
+	unsigned int emptyConstraints;
+	// Rows that became empty after substituting the fixed variables but can not be satisfied,
+	// e.g. a slice to be explained whose segments are all fixed to 0.
+	unsigned int infeasibleConstraints;
+	// Variables forced to both 0 and 1.
+	unsigned int conflictingVariables;
+	unsigned int fixedVariables;
+	unsigned int dominatedConstraints;
+	unsigned int outputConstraints;
+
+	// Whether the presolve found the problem to be infeasible. The problem is then passed on
+	// unchanged, for the solver to fail on.
+	bool infeasible;
+};
+
+/**
+ * Reduces the linear constraints of a binary problem before it is handed to the LinearSolver.
+ *
+ * Duplicate and empty rows are removed, variables that are forced to 0 or 1 by a row are fixed
+ * and substituted into the remaining rows, and set packing rows (sum <= 1 over unit
+ * coefficients) are dropped if they are contained in another set packing or partitioning row.
+ * Fixed variables are kept in the output as single-variable equality constraints, so that
+ * the variables of the problem stay the same.
+ *
+ * If a row can not be satisfied, or a variable is forced to both values, the problem is
+ * infeasible. This is reported in the statistics, and the constraints are passed on as they
+ * were, so that the infeasibility is not hidden by the presolve.
+ *
+ * The constraints are read from the SparseConstraintMatrix of the ProblemMatrixAssembler, and
+ * written as a SparseConstraintMatrix for the DecomposingLinearSolver.
+ */
+class ConstraintPresolver : public pipeline::SimpleProcessNode<>
+{
+	struct Row
+	{
+		Row() : relation(LessEqual), value(0), removed(false) {}
+
+		// sorted by variable
+		std::vector<unsigned int> variables;
+		std::vector<double> coefficients;
+		Relation relation;
+		double value;
+		bool removed;
+	};
+
+	typedef boost::unordered_map<unsigned int, double> FixedMap;
+
+public:
+	ConstraintPresolver();
+
+private:
+	void updateOutputs();
+
+	void readRows(const SparseConstraintMatrix& constraints);
+
+	void removeDuplicates();
+
+	void fixVariables();
+
+	/**
+	 * Substitute the fixed variables into the row and look for new variables it forces. A row
+	 * on a single variable that fixes it is removed, the fixed value takes its place.
+	 * Returns true if a variable was fixed.
+	 */
+	bool reduceRow(Row& row);
+
+	bool fix(unsigned int variable, double value);
+
+	void removeDominated();
+
+	static bool isSetPacking(const Row& row);
+
+	static bool isUnit(const Row& row);
+
+	static bool includes(const Row& row, const Row& subRow);
+
+	static std::size_t hashRow(const Row& row);
+
+	static bool equalRows(const Row& row1, const Row& row2);
+
+	pipeline::Input<SparseConstraintMatrix> _constraintsIn;
+
+	pipeline::Output<SparseConstraintMatrix> _constraintsOut;
+	pipeline::Output<PresolveStatistics> _statistics;
+
+	std::vector<Row> _rows;
+	FixedMap _fixed;
+};
+
+#endif //CONSTRAINT_PRESOLVER_H__
@@ -1,8 +1,64 @@
 #include "CoreSolver.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <boost/functional/hash.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <inference/Relation.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
 #include <util/ProgramOptions.h>
 #include <pipeline/Value.h>
+#include <catmaidsopnet/ProblemWriter.h>
+#include <catmaidsopnet/RandomForestRegistry.h>
 
+logger::LogChannel coresolverlog("coresolverlog", "[CoreSolver] ");
+
+/**
+ * Whether the values satisfy all the constraints.
+ */
+static bool
+isSatisfied(const SparseConstraintMatrix& constraints, const std::vector<double>& values)
+{
+	for (unsigned int row = 0; row < constraints.numRows(); ++row)
+	{
+		SparseConstraintMatrix::coefficient_iterator coefficient =
+			constraints.coefficientsBegin(row);
+		double sum = 0;
+		
+		for (SparseConstraintMatrix::column_iterator column = constraints.columnsBegin(row);
+			 column != constraints.columnsEnd(row); ++column, ++coefficient)
+		{
+			sum += (*coefficient)*values[*column];
+		}
+		
+		switch (constraints.getRelation(row))
+		{
+			case LessEqual:
+				if (sum > constraints.getValue(row) + 1e-6)
+				{
+					return false;
+				}
+				break;
+			case GreaterEqual:
+				if (sum < constraints.getValue(row) - 1e-6)
+				{
+					return false;
+				}
+				break;
+			default:
+				if (std::abs(sum - constraints.getValue(row)) > 1e-6)
+				{
+					return false;
+				}
+				break;
+		}
+	}
+	
+	return true;
+}
 
 util::ProgramOption optionRandomForestFileBlock(
 		util::_module           = "blockSolver",
@@ -10,23 +66,51 @@ util::ProgramOption optionRandomForestFileBlock(
 		util::_description_text = "Path to an HDF5 file containing the segment random forest.",
 		util::_default_value    = "segment_rf.hdf");
 
+util::ProgramOption optionSolverBackend(
+		util::_module           = "catmaidsopnet",
+		util::_long_name        = "solverBackend",
+		util::_description_text = "The MIP solver to use for the components of a problem: 'default' "
+		                          "for the LinearSolver of sopnet, 'highs' for HiGHS.",
+		util::_default_value    = "default");
+
+util::ProgramOption optionSolverThreads(
+		util::_module           = "catmaidsopnet",
+		util::_long_name        = "solverThreads",
+		util::_description_text = "The number of threads the MIP solver may use for one component, "
+		                          "shared with the components being solved in parallel.",
+		util::_default_value    = 1);
+
+util::ProgramOption optionDumpProblems(
+		util::_module           = "catmaidsopnet",
+		util::_long_name        = "dumpProblems",
+		util::_description_text = "A directory to write every problem solved by a CoreSolver to, "
+		                          "as LP and MPS files with the segment ids of the variables. "
+		                          "The problems are written before they are presolved.",
+		util::_default_value    = "");
+
 CoreSolver::CoreSolver() :
-	_problemAssembler(boost::make_shared<ProblemAssembler>()),
+	_problemAssembler(boost::make_shared<ProblemMatrixAssembler>()),
 	_componentTreeExtractor(boost::make_shared<ComponentTreeExtractor>()),	
+	_constraintPresolver(boost::make_shared<ConstraintPresolver>()),
 	_reconstructor(boost::make_shared<Reconstructor>()),
-	_linearSolver(boost::make_shared<LinearSolver>()),
+	_linearSolver(boost::make_shared<DecomposingLinearSolver>()),
 	_neuronExtractor(boost::make_shared<NeuronExtractor>()),
 	_segmentReader(boost::make_shared<SegmentReader>()),
 	_sliceReader(boost::make_shared<SliceReader>()),
 	_priorCostFunction(boost::make_shared<PriorCostFunction>()),
-	_segmentationCostFunction(boost::make_shared<SegmentationCostFunction>()),
-	_randomForestHDF5Reader(
-		boost::make_shared<RandomForestHdf5Reader>(optionRandomForestFileBlock.as<std::string>())),
-	_rawImageStackReader(boost::make_shared<ImageBlockStackReader>()),
-	_membraneStackReader(boost::make_shared<ImageBlockStackReader>()),
+	_segmentationCostFunction(boost::make_shared<CroppedSegmentationCostFunction>()),
 	_randomForestCostFunction(boost::make_shared<RandomForestCostFunction>()),
-	_segmentFeaturesExtractor(boost::make_shared<SegmentFeaturesExtractor>()),
-	_objectiveGenerator(boost::make_shared<ObjectiveGenerator>())
+	_cachedCostFunction(boost::make_shared<CachedCostFunction>()),
+	_segmentFeatureReader(boost::make_shared<SegmentFeatureReader>()),
+	_objectiveGenerator(boost::make_shared<ObjectiveGenerator>()),
+	_fixedConstraintsGenerator(boost::make_shared<FixedConstraintsGenerator>()),
+	_solutionCache(boost::make_shared<SolutionCache>()),
+	_ownStackCache(boost::make_shared<ImageStackCache>()),
+	_solverBackend(SolverBackend::create(optionSolverBackend.as<std::string>())),
+	_previousAssignment(boost::make_shared<SegmentAssignment>()),
+	_solved(false),
+	_fingerprint(0),
+	_forestHash(0)
 {
 	registerInput(_priorCostFunctionParameters, "prior cost parameters");
 	registerInput(_blocks, "blocks");
@@ -39,124 +123,545 @@ CoreSolver::CoreSolver() :
 	registerInput(_rawImageFactory, "raw image factory");
 	registerInput(_membraneFactory, "membrane factory");
 	registerInput(_forceExplanation, "force explanation");
+	registerInput(_fixedSegments, "fixed segments", pipeline::Optional);
+	registerInput(_stackCache, "stack cache", pipeline::Optional);
+	registerInput(_solverBudget, "solver budget", pipeline::Optional);
+	registerInput(_neuronStream, "neuron stream", pipeline::Optional);
+	registerInput(_neuronAssembler, "neuron assembler", pipeline::Optional);
+	registerInput(_solutionStore, "solution store", pipeline::Optional);
 	
 	registerOutput(_neurons, "neurons");
+	registerOutput(_assignment, "assignment");
+	registerOutput(_statistics, "solve statistics");
 	//registerOutput(_problemAssembler->getOutput("segments"), "segments");
+	
+	// Zero weights, the segmentation costs are left out.
+	_noSegmentationParameters->weight = 0;
+	_noSegmentationParameters->weightPotts = 0;
+	
+	_solverBackend->setNumThreads(optionSolverThreads.as<unsigned int>());
+	
+	wire();
 }
 
 void
-CoreSolver::updateOutputs()
+CoreSolver::invalidate()
 {
-	boost::shared_ptr<LinearSolverParameters> binarySolverParameters = 
-		boost::make_shared<LinearSolverParameters>(Binary);
-	pipeline::Value<SegmentTrees> neurons;
-		
-	boost::shared_ptr<Blocks> boundingBlocks;
-		
-		
+	_solved = false;
+}
+
+void
+CoreSolver::wire()
+{
+	// Connections between the inner nodes, made once. Only the inputs that come from
+	// outside are set again for every window, in connectExternalInputs().
+	_componentTreeExtractor->setInput("slices", _sliceReader->getOutput("slices"));
+	_componentTreeExtractor->setInput("segments", _segmentReader->getOutput("segments"));
+	
+	_problemAssembler->setInput("segments", _segmentReader->getOutput("segments"));
+	_problemAssembler->addInput("linear constraints",
+								_componentTreeExtractor->getOutput("linear constraints"));
+	// Decisions made elsewhere, e.g., by the neighbouring windows of a VolumeSolver.
+	_fixedConstraintsGenerator->setInput("segments", _segmentReader->getOutput("segments"));
+	_problemAssembler->addInput("linear constraints",
+								_fixedConstraintsGenerator->getOutput("linear constraints"));
+	
+	_segmentFeatureReader->setInput("segments", _problemAssembler->getOutput("segments"));
+	
+	_randomForestCostFunction->setInput("features",
+										_segmentFeatureReader->getOutput("all features"));
+	_cachedCostFunction->setInput("cost function",
+								  _randomForestCostFunction->getOutput("cost function"));
+	
+	_objectiveGenerator->setInput("segments", _problemAssembler->getOutput("segments"));
+	_objectiveGenerator->setInput("segment cost function",
+								  _cachedCostFunction->getOutput("cost function"));
+	_objectiveGenerator->addInput("additional cost functions",
+								  _priorCostFunction->getOutput("cost function"));
+	// Adds nothing unless segmentation cost parameters are given.
+	_objectiveGenerator->addInput("additional cost functions",
+								  _segmentationCostFunction->getOutput("cost function"));
+	
+	_constraintPresolver->setInput("linear constraints",
+								   _problemAssembler->getOutput("linear constraints"));
+	
+	_linearSolver->setInput("objective", _objectiveGenerator->getOutput());
+	_linearSolver->setInput("linear constraints",
+							_constraintPresolver->getOutput("linear constraints"));
+	_linearSolver->setInput("parameters", boost::make_shared<LinearSolverParameters>(Binary));
+	_linearSolver->setInput("problem configuration",
+							_problemAssembler->getOutput("problem configuration"));
+	_linearSolver->setInput("solution cache", _solutionCache);
+	_linearSolver->setInput("backend", _solverBackend);
+	
+	_reconstructor->setInput("segments", _problemAssembler->getOutput("segments"));
+	_reconstructor->setInput("solution", _linearSolver->getOutput());
+	
+	_neuronExtractor->setInput("segments", _reconstructor->getOutput());
+}
+
+void
+CoreSolver::connectExternalInputs()
+{
+	boost::shared_ptr<ImageStackCache> stackCache = _ownStackCache;
+	
+	if (_stackCache)
+	{
+		stackCache = _stackCache;
+	}
+	
 	_segmentReader->setInput("blocks", _blocks);
 	_sliceReader->setInput("blocks", _blocks);
 	
 	_segmentReader->setInput("store", _segmentStore);
 	_sliceReader->setInput("store", _sliceStore);
 	
-	_rawImageStackReader->setInput("factory", _rawImageFactory);
-	
-	_componentTreeExtractor->setInput("slices", _sliceReader->getOutput("slices"));
-	_componentTreeExtractor->setInput("segments", _segmentReader->getOutput("segments"));
 	_componentTreeExtractor->setInput("blocks", _blocks);
 	_componentTreeExtractor->setInput("store", _sliceStore);
 	_componentTreeExtractor->setInput("force explanation", _forceExplanation);
 	
-	_problemAssembler->addInput("segments", _segmentReader->getOutput("segments"));
-	_problemAssembler->addInput("linear constraints",
-								_componentTreeExtractor->getOutput("linear constraints"));
-	
-	// Use problem assembler output to compute the bounding box we need to contain all
-	// of the slices that are present. This will usually be larger than the requested
-	// Blocks.
-	boundingBlocks = computeBound();
-	pipeline::Value<util::point3<unsigned int> > offset(boundingBlocks->location());;
-	_rawImageStackReader->setInput("block", boundingBlocks);
+	if (_fixedSegments)
+	{
+		_fixedConstraintsGenerator->setInput("fixed segments", _fixedSegments);
+	}
+	else
+	{
+		_fixedConstraintsGenerator->setInput("fixed segments", _noFixedSegments);
+	}
 	
+	// Features are cached in the segment store, raw sections are only read for new segments.
+	// Images are read on crops around groups of segments, not on one box around all of them.
+	_segmentFeatureReader->setInput("store", _segmentStore);
+	_segmentFeatureReader->setInput("raw image factory", _rawImageFactory);
+	_segmentFeatureReader->setInput("blocks", _blocks);
+	_segmentFeatureReader->setInput("stack cache", stackCache);
 	
+	_priorCostFunction->setInput("parameters", _priorCostFunctionParameters);
 	
-	_segmentFeaturesExtractor->setInput("crop offset", offset);
-	_segmentFeaturesExtractor->setInput("segments", _problemAssembler->getOutput("segments"));
-	_segmentFeaturesExtractor->setInput("raw sections", _rawImageStackReader->getOutput());
+	// The forest is read once per process and shared by all CoreSolvers. It is read again when
+	// the file changes, the costs of the old one are of no use then.
+	std::size_t forestHash =
+		RandomForestRegistry::getHash(optionRandomForestFileBlock.as<std::string>());
 	
-	_priorCostFunction->setInput("parameters", _priorCostFunctionParameters);
+	if (forestHash != _forestHash)
+	{
+		if (_forestHash != 0)
+		{
+			LOG_DEBUG(coresolverlog) << "Random forest changed, forgetting cached costs" <<
+				std::endl;
+			
+			CachedCostFunction::remove(_forestHash);
+		}
+		
+		_forestHash = forestHash;
+		_cachedCostFunction->setInput("key", pipeline::Value<std::size_t>(forestHash));
+	}
 	
 	_randomForestCostFunction->setInput("random forest",
-										_randomForestHDF5Reader->getOutput("random forest"));
-	_randomForestCostFunction->setInput("features",
-										_segmentFeaturesExtractor->getOutput("all features"));
-	
+		RandomForestRegistry::getForest(optionRandomForestFileBlock.as<std::string>()));
 	
-	_objectiveGenerator->setInput("segments", _problemAssembler->getOutput("segments"));
-	_objectiveGenerator->setInput("segment cost function",
-								  _randomForestCostFunction->getOutput("cost function"));
-	_objectiveGenerator->addInput("additional cost functions",
-								  _priorCostFunction->getOutput("cost function"));
+	_segmentationCostFunction->setInput("membrane factory", _membraneFactory);
+	_segmentationCostFunction->setInput("blocks", _blocks);
+	_segmentationCostFunction->setInput("stack cache", stackCache);
 	
 	if (_segmentationCostFunctionParameters)
 	{
-		_membraneStackReader->setInput("factory", _membraneFactory);
-		_membraneStackReader->setInput("block", boundingBlocks);
-		_segmentationCostFunction->setInput("membranes", _membraneStackReader->getOutput());
 		_segmentationCostFunction->setInput("parameters", _segmentationCostFunctionParameters);
-		_segmentationCostFunction->setInput("crop offset", offset);
-		_objectiveGenerator->addInput("additional cost functions",
-									  _segmentationCostFunction->getOutput("cost function"));
 	}
+	else
+	{
+		_segmentationCostFunction->setInput("parameters", _noSegmentationParameters);
+	}
+	
+	if (_solverBudget)
+	{
+		_linearSolver->setInput("budget", _solverBudget);
+	}
+	else
+	{
+		_linearSolver->setInput("budget", _noBudget);
+	}
+	
+	// The decisions for the previous window are a good start for an overlapping one.
+	_linearSolver->setInput("warm start", _previousAssignment);
+}
 
+void
+CoreSolver::updateOutputs()
+{
+	connectExternalInputs();
 	
-	_linearSolver->setInput("objective", _objectiveGenerator->getOutput());
-	_linearSolver->setInput("linear constraints", _problemAssembler->getOutput("linear constraints"));
-	_linearSolver->setInput("parameters", binarySolverParameters);
+	// Decisions fixed from outside are not part of the stored solutions.
+	if (_solutionStore && !_fixedSegments && retrieveSolutions())
+	{
+		return;
+	}
 	
-	_reconstructor->setInput("segments", _problemAssembler->getOutput("segments"));
-	_reconstructor->setInput("solution", _linearSolver->getOutput());
+	pipeline::Value<Segments> segments = _segmentReader->getOutput("segments");
+	std::size_t fingerprint = computeFingerprint(*segments);
+	
+	// A stream expects the neurons again.
+	if (_solved && !_neuronStream && fingerprint == _fingerprint)
+	{
+		LOG_DEBUG(coresolverlog) << "Problem unchanged, keeping the previous solution" <<
+			std::endl;
+		return;
+	}
+	
+	LOG_DEBUG(coresolverlog) << "Solving for " << segments->size() << " segments" << std::endl;
+	
+	if (_neuronStream)
+	{
+		pipeline::Value<Segments> problemSegments = _problemAssembler->getOutput("segments");
+		pipeline::Value<ProblemConfiguration> configuration =
+			_problemAssembler->getOutput("problem configuration");
+		
+		_linearSolver->setInput("component listener",
+								boost::make_shared<ComponentNeuronStreamer>(
+									_neuronStream, problemSegments, configuration));
+		
+		// The neurons are emitted while the components are solved.
+		extractAssignment();
+		
+		*_neurons = SegmentTrees();
+	}
+	else if (_neuronAssembler)
+	{
+		_linearSolver->setInput("component listener", _noListener);
+		
+		extractAssignment();
+		
+		// Only the neurons touched by changed decisions are rebuilt.
+		pipeline::Value<Segments> problemSegments = _problemAssembler->getOutput("segments");
+		SegmentTrees neurons;
+		
+		foreach (unsigned int neuronId, _neuronAssembler->update(*problemSegments, *_assignment))
+		{
+			neurons.add(_neuronAssembler->getNeuron(neuronId));
+		}
+		
+		*_neurons = neurons;
+	}
+	else
+	{
+		_linearSolver->setInput("component listener", _noListener);
+		
+		pipeline::Value<SegmentTrees> neurons = _neuronExtractor->getOutput();
+		*_neurons = *neurons;
+		
+		extractAssignment();
+	}
+	
+	if (!optionDumpProblems.as<std::string>().empty())
+	{
+		dumpProblem(fingerprint);
+	}
+	
+	pipeline::Value<SolveStatistics> statistics = _linearSolver->getOutput("statistics");
+	*_statistics = *statistics;
+	
+	LOG_DEBUG(coresolverlog) << "Solved with gap " << statistics->getGap() << std::endl;
+	
+	// Greedy solutions are not worth keeping.
+	if (_solutionStore && !_fixedSegments && statistics->greedyComponents == 0)
+	{
+		storeSolutions();
+	}
+	
+	_fingerprint = fingerprint;
+	// A window with greedy parts is solved again when requested again, the components solved
+	// optimally meanwhile come from the solution cache.
+	_solved = (statistics->greedyComponents == 0);
+}
 
-	_neuronExtractor->setInput("segments", _reconstructor->getOutput());
+std::size_t
+CoreSolver::computeFingerprint(const Segments& segments)
+{
+	std::vector<unsigned int> blockIds;
+	std::vector<unsigned int> segmentIds;
+	std::size_t seed = 0;
+	
+	foreach (boost::shared_ptr<Block> block, *_blocks)
+	{
+		blockIds.push_back(block->getId());
+	}
+	
+	foreach (boost::shared_ptr<Segment> segment, segments.getSegments())
+	{
+		segmentIds.push_back(segment->getId());
+	}
+	
+	std::sort(blockIds.begin(), blockIds.end());
+	std::sort(segmentIds.begin(), segmentIds.end());
+	
+	boost::hash_combine(seed, blockIds);
+	boost::hash_combine(seed, segmentIds);
+	// The forest, the parameters and whether to force explanation.
+	boost::hash_combine(seed, solutionKey());
 	
-	std::cout << " GO! " << std::endl;
+	if (_solverBudget)
+	{
+		boost::hash_combine(seed, _solverBudget->timeLimit);
+		boost::hash_combine(seed, _solverBudget->gap);
+	}
+	
+	if (_fixedSegments)
+	{
+		foreach (unsigned int id, segmentIds)
+		{
+			if (_fixedSegments->contains(id))
+			{
+				boost::hash_combine(seed, id);
+				boost::hash_combine(seed, _fixedSegments->isChosen(id));
+			}
+		}
+	}
 	
-	neurons = _neuronExtractor->getOutput();
-	*_neurons = *neurons;
+	return seed;
 }
 
-boost::shared_ptr<Blocks>
-CoreSolver::computeBound()
+std::size_t
+CoreSolver::solutionKey()
 {
-	pipeline::Value<Segments> segments = _problemAssembler->getOutput("segments");
-	if (segments->size() > 0)
+	std::size_t seed = 0;
+	
+	// Parameters are compared by value, the key has to be the same for every CoreSolver with
+	// the same configuration.
+	boost::hash_combine(seed,
+		RandomForestRegistry::getHash(optionRandomForestFileBlock.as<std::string>()));
+	boost::hash_combine(seed, _priorCostFunctionParameters->priorEnd);
+	boost::hash_combine(seed, _priorCostFunctionParameters->priorContinuation);
+	boost::hash_combine(seed, _priorCostFunctionParameters->priorBranch);
+	boost::hash_combine(seed, *_forceExplanation);
+	
+	if (_segmentationCostFunctionParameters)
 	{
+		boost::hash_combine(seed, _segmentationCostFunctionParameters->weight);
+		boost::hash_combine(seed, _segmentationCostFunctionParameters->weightPotts);
+		boost::hash_combine(seed, _segmentationCostFunctionParameters->priorForeground);
+	}
+	
+	return seed;
+}
+
+std::size_t
+CoreSolver::blockFingerprint(const boost::shared_ptr<Block>& block, const Segments& segments)
+{
+	std::vector<unsigned int> sliceIds = _sliceStore->retrieveSliceIds(block);
+	std::vector<unsigned int> segmentIds;
+	std::size_t seed = 0;
+	
+	foreach (boost::shared_ptr<Segment> segment, segments.getSegments())
+	{
+		segmentIds.push_back(segment->getId());
+	}
+	
+	std::sort(sliceIds.begin(), sliceIds.end());
+	std::sort(segmentIds.begin(), segmentIds.end());
+	
+	boost::hash_combine(seed, sliceIds);
+	boost::hash_combine(seed, segmentIds);
+	
+	return seed;
+}
+
+bool
+CoreSolver::retrieveSolutions()
+{
+	std::size_t key = solutionKey();
+	boost::shared_ptr<Segments> chosenSegments = boost::make_shared<Segments>();
+	// The stored decision for every segment of the window.
+	boost::unordered_map<unsigned int, bool> decisions;
+	SegmentAssignment assignment;
+	
+	foreach (boost::shared_ptr<Block> block, *_blocks)
+	{
+		boost::shared_ptr<Segments> segments = _segmentStore->retrieveSegments(block);
+		boost::shared_ptr<Segments> solution =
+			_solutionStore->retrieveSolution(block, key, blockFingerprint(block, *segments));
+		boost::unordered_set<unsigned int> chosenIds;
+		
+		if (!solution)
+		{
+			LOG_DEBUG(coresolverlog) << "No stored solution for block " << block->getId() <<
+				", solving" << std::endl;
+			return false;
+		}
+		
+		foreach (boost::shared_ptr<Segment> segment, solution->getSegments())
+		{
+			chosenIds.insert(segment->getId());
+		}
+		
+		// Segments reaching into several blocks were decided with each of them, possibly in
+		// different windows.
+		foreach (boost::shared_ptr<Segment> segment, segments->getSegments())
+		{
+			bool chosen = chosenIds.count(segment->getId());
+			boost::unordered_map<unsigned int, bool>::const_iterator it =
+				decisions.find(segment->getId());
 			
-		util::rect<int> bound =
-			segments->getSegments()[0]->getSlices()[0]->getComponent()->getBoundingBox();
-		boost::shared_ptr<Box<> > box;
-		boost::shared_ptr<Blocks> boundBlocks;
-			
+			if (it == decisions.end())
+			{
+				decisions[segment->getId()] = chosen;
+			}
+			else if (it->second != chosen)
+			{
+				LOG_DEBUG(coresolverlog) << "Stored solutions disagree on segment " <<
+					segment->getId() << ", solving" << std::endl;
+				return false;
+			}
+		}
+	}
+	
+	// The stored solutions agree, but together they still have to satisfy the constraints of
+	// this window, e.g., the conflict sets spanning several blocks.
+	pipeline::Value<Segments> segments = _problemAssembler->getOutput("segments");
+	pipeline::Value<SparseConstraintMatrix> constraints =
+		_problemAssembler->getOutput("linear constraints");
+	pipeline::Value<ProblemConfiguration> configuration =
+		_problemAssembler->getOutput("problem configuration");
+	std::vector<double> values(segments->size(), 0.0);
+	
+	for (unsigned int i = 0; i < values.size(); ++i)
+	{
+		boost::unordered_map<unsigned int, bool>::const_iterator it =
+			decisions.find(configuration->getSegmentId(i));
+		
+		values[i] = (it != decisions.end() && it->second ? 1 : 0);
+	}
+	
+	if (!isSatisfied(*constraints, values))
+	{
+		LOG_DEBUG(coresolverlog) << "Stored solutions violate the constraints of the window, " <<
+			"solving" << std::endl;
+		return false;
+	}
+	
+	foreach (boost::shared_ptr<Segment> segment, segments->getSegments())
+	{
+		boost::unordered_map<unsigned int, bool>::const_iterator it =
+			decisions.find(segment->getId());
+		bool chosen = (it != decisions.end() && it->second);
+		
+		assignment.set(segment->getId(), chosen);
+		
+		if (chosen)
+		{
+			chosenSegments->add(segment);
+		}
+	}
+	
+	LOG_DEBUG(coresolverlog) << "Using the stored solutions of " << _blocks->length() <<
+		" blocks" << std::endl;
+	
+	*_assignment = assignment;
+	_previousAssignment = boost::make_shared<SegmentAssignment>(assignment);
+	*_statistics = SolveStatistics();
+	
+	publishNeurons(*segments, chosenSegments);
+	
+	// The next window is compared against a solve, not against the store.
+	_solved = false;
+	
+	return true;
+}
+
+void
+CoreSolver::storeSolutions()
+{
+	std::size_t key = solutionKey();
+	
+	foreach (boost::shared_ptr<Block> block, *_blocks)
+	{
+		boost::shared_ptr<Segments> segments = _segmentStore->retrieveSegments(block);
+		boost::shared_ptr<Segments> chosen = boost::make_shared<Segments>();
+		
 		foreach (boost::shared_ptr<Segment> segment, segments->getSegments())
 		{
-			foreach (boost::shared_ptr<Slice> slice, segment->getSlices())
+			if (_assignment->isChosen(segment->getId()))
 			{
-				util::rect<int> componentBound = slice->getComponent()->getBoundingBox();
-				bound.fit(componentBound);
+				chosen->add(segment);
 			}
 		}
 		
-		box = boost::make_shared<Box<> >(bound, _blocks->location().z, _blocks->size().z);
+		_solutionStore->storeSolution(block, key, blockFingerprint(block, *segments), chosen);
+	}
+}
+
+void
+CoreSolver::publishNeurons(const Segments& segments,
+						   const boost::shared_ptr<Segments>& chosenSegments)
+{
+	if (_neuronAssembler)
+	{
+		SegmentTrees neurons;
+		
+		foreach (unsigned int neuronId, _neuronAssembler->update(segments, *_assignment))
+		{
+			neurons.add(_neuronAssembler->getNeuron(neuronId));
+		}
+		
+		*_neurons = neurons;
 		
-		boundBlocks = _blocks->getManager()->blocksInBox(box);
-		boundBlocks->expand(util::point3<int>(0,0,1));
-		return boundBlocks;
+		return;
+	}
+	
+	boost::shared_ptr<NeuronExtractor> neuronExtractor = boost::make_shared<NeuronExtractor>();
+	
+	neuronExtractor->setInput("segments", chosenSegments);
+	
+	pipeline::Value<SegmentTrees> neurons = neuronExtractor->getOutput();
+	
+	if (_neuronStream)
+	{
+		_neuronStream->emit(neurons);
+		*_neurons = SegmentTrees();
 	}
 	else
 	{
-		return _blocks;
+		*_neurons = *neurons;
 	}
 }
 
+void
+CoreSolver::dumpProblem(std::size_t fingerprint)
+{
+	pipeline::Value<LinearObjective> objective = _objectiveGenerator->getOutput();
+	pipeline::Value<SparseConstraintMatrix> matrix =
+		_problemAssembler->getOutput("linear constraints");
+	pipeline::Value<ProblemConfiguration> configuration =
+		_problemAssembler->getOutput("problem configuration");
+	// Only the problem files need LinearConstraints.
+	boost::shared_ptr<LinearConstraints> constraints = matrix->toLinearConstraints();
+	std::ostringstream basename;
+	
+	basename << optionDumpProblems.as<std::string>() << "/problem_" << std::hex << fingerprint;
+	
+	LOG_DEBUG(coresolverlog) << "Writing problem to " << basename.str() << std::endl;
+	
+	ProblemWriter::writeLp(*objective, *constraints, basename.str() + ".lp");
+	ProblemWriter::writeMps(*objective, *constraints, basename.str() + ".mps");
+	ProblemWriter::writeSegmentIds(*configuration, objective->size(), basename.str() + ".ids");
+}
 
+void
+CoreSolver::extractAssignment()
+{
+	pipeline::Value<Segments> segments = _problemAssembler->getOutput("segments");
+	pipeline::Value<Segments> chosenSegments = _reconstructor->getOutput();
+	SegmentAssignment assignment;
+	
+	foreach (boost::shared_ptr<Segment> segment, segments->getSegments())
+	{
+		assignment.set(segment->getId(), false);
+	}
+	
+	foreach (boost::shared_ptr<Segment> segment, chosenSegments->getSegments())
+	{
+		assignment.set(segment->getId(), true);
+	}
+	
+	*_assignment = assignment;
+	_previousAssignment = boost::make_shared<SegmentAssignment>(assignment);
+}
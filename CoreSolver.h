@@ -4,42 +4,93 @@
 #include <boost/shared_ptr.hpp>
 #include <pipeline/all.h>
 #include <imageprocessing/io/ImageBlockFactory.h>
-#include <imageprocessing/io/ImageBlockStackReader.h>
 #include <sopnet/inference/PriorCostFunctionParameters.h>
-#include <sopnet/inference/ProblemAssembler.h>
 #include <sopnet/inference/LinearSolver.h>
 #include <sopnet/inference/Reconstructor.h>
 #include <sopnet/inference/PriorCostFunction.h>
-#include <sopnet/inference/ProblemAssembler.h>
 #include <sopnet/inference/RandomForestCostFunction.h>
 #include <sopnet/inference/ObjectiveGenerator.h>
 #include <sopnet/inference/SegmentationCostFunctionParameters.h>
-#include <sopnet/inference/SegmentationCostFunction.h>
-#include <sopnet/inference/io/RandomForestHdf5Reader.h>
 #include <sopnet/neurons/NeuronExtractor.h>
 #include <sopnet/block/Blocks.h>
 #include <sopnet/block/Box.h>
 #include <sopnet/block/BlockManager.h>
-#include <sopnet/features/SegmentFeaturesExtractor.h>
 #include <catmaidsopnet/persistence/SegmentStore.h>
 #include <catmaidsopnet/persistence/SliceStore.h>
+#include <catmaidsopnet/persistence/SolutionStore.h>
+#include <catmaidsopnet/CachedCostFunction.h>
+#include <catmaidsopnet/ComponentNeuronStreamer.h>
 #include <catmaidsopnet/ComponentTreeExtractor.h>
+#include <catmaidsopnet/CroppedSegmentationCostFunction.h>
+#include <catmaidsopnet/ConstraintPresolver.h>
+#include <catmaidsopnet/DecomposingLinearSolver.h>
+#include <catmaidsopnet/FixedConstraintsGenerator.h>
+#include <catmaidsopnet/ImageStackCache.h>
+#include <catmaidsopnet/IncrementalNeuronAssembler.h>
+#include <catmaidsopnet/NeuronStream.h>
+#include <catmaidsopnet/ProblemMatrixAssembler.h>
+#include <catmaidsopnet/SolutionCache.h>
+#include <catmaidsopnet/SolverBackend.h>
+#include <catmaidsopnet/SegmentAssignment.h>
+#include <catmaidsopnet/SegmentFeatureReader.h>
 #include <catmaidsopnet/persistence/SegmentReader.h>
 #include <catmaidsopnet/persistence/SliceReader.h>
 
+/**
+ * Solves the problem of the segments in a window of blocks.
+ *
+ * The inner pipeline is wired once on construction, so the same CoreSolver can be used for
+ * many windows, one after the other. Parts that did not change between windows are reused
+ * by the caches of the inner nodes, and a window with the same segments, decisions and
+ * parameters as the previous one is not solved again.
+ *
+ * An optional SolverBudget bounds the time spent in the solver, for interactive requests. The
+ * result is then the best feasible solution found, and the achieved gap is reported in the
+ * "solve statistics" output.
+ *
+ * With a NeuronStream, the neurons are passed to the stream part by part as the independent
+ * parts of the problem are solved, and the "neurons" output stays empty. With an
+ * IncrementalNeuronAssembler instead, the decisions are applied to the assembler, and the
+ * "neurons" output holds only the neurons that were added or modified by this solve.
+ *
+ * With a SolutionStore, the chosen segments of every solved block are stored, and a window of
+ * blocks that all have a stored solution for the same costs and the same slices and segments
+ * is answered from the store without solving. The stored solutions may come from different
+ * windows, so they are only used if they agree on the segments the blocks share and together
+ * satisfy the constraints of the window.
+ *
+ * If the catmaidsopnet.dumpProblems program option names a directory, every solved problem
+ * is written there for offline benchmarking with an IlpBenchmark.
+ */
 class CoreSolver : public pipeline::SimpleProcessNode<>
 {
 public:
 	CoreSolver();
 	
-	boost::shared_ptr<ProblemAssembler> getProblemAssembler()
+	/**
+	 * Solve the next window even if it looks unchanged, e.g., after the stores were modified.
+	 */
+	void invalidate();
+	
+	boost::shared_ptr<ProblemMatrixAssembler> getProblemAssembler()
 	{
 		return _problemAssembler;
 	}
 	
 private:
+	void wire();
+	void connectExternalInputs();
 	void updateOutputs();
-	boost::shared_ptr<Blocks> computeBound();
+	void extractAssignment();
+	void dumpProblem(std::size_t fingerprint);
+	bool retrieveSolutions();
+	void storeSolutions();
+	void publishNeurons(const Segments& segments,
+						const boost::shared_ptr<Segments>& chosenSegments);
+	std::size_t computeFingerprint(const Segments& segments);
+	std::size_t solutionKey();
+	std::size_t blockFingerprint(const boost::shared_ptr<Block>& block,
+								 const Segments& segments);
 	
 	pipeline::Input<PriorCostFunctionParameters> _priorCostFunctionParameters;
 	pipeline::Input<SegmentationCostFunctionParameters> _segmentationCostFunctionParameters;
@@ -49,24 +100,63 @@ private:
 	pipeline::Input<ImageBlockFactory> _rawImageFactory;
 	pipeline::Input<ImageBlockFactory> _membraneFactory;
 	pipeline::Input<bool> _forceExplanation;
+	pipeline::Input<SegmentAssignment> _fixedSegments;
+	pipeline::Input<ImageStackCache> _stackCache;
+	pipeline::Input<SolverBudget> _solverBudget;
+	pipeline::Input<NeuronStream> _neuronStream;
+	pipeline::Input<IncrementalNeuronAssembler> _neuronAssembler;
+	pipeline::Input<SolutionStore> _solutionStore;
 	
 	pipeline::Output<SegmentTrees> _neurons;
+	pipeline::Output<SegmentAssignment> _assignment;
+	pipeline::Output<SolveStatistics> _statistics;
 	
-	boost::shared_ptr<ProblemAssembler> _problemAssembler;
+	boost::shared_ptr<ProblemMatrixAssembler> _problemAssembler;
 	boost::shared_ptr<ComponentTreeExtractor> _componentTreeExtractor;
+	boost::shared_ptr<ConstraintPresolver> _constraintPresolver;
 	boost::shared_ptr<Reconstructor> _reconstructor;
-	boost::shared_ptr<LinearSolver> _linearSolver;
+	boost::shared_ptr<DecomposingLinearSolver> _linearSolver;
 	boost::shared_ptr<NeuronExtractor> _neuronExtractor;
 	boost::shared_ptr<SegmentReader> _segmentReader;
 	boost::shared_ptr<SliceReader> _sliceReader;
 	boost::shared_ptr<PriorCostFunction> _priorCostFunction;
-	boost::shared_ptr<SegmentationCostFunction> _segmentationCostFunction;
-	boost::shared_ptr<RandomForestHdf5Reader> _randomForestHDF5Reader;
-	boost::shared_ptr<ImageBlockStackReader> _rawImageStackReader;
-	boost::shared_ptr<ImageBlockStackReader> _membraneStackReader;
+	boost::shared_ptr<CroppedSegmentationCostFunction> _segmentationCostFunction;
 	boost::shared_ptr<RandomForestCostFunction> _randomForestCostFunction;
-	boost::shared_ptr<SegmentFeaturesExtractor> _segmentFeaturesExtractor;
+	boost::shared_ptr<CachedCostFunction> _cachedCostFunction;
+	boost::shared_ptr<SegmentFeatureReader> _segmentFeatureReader;
 	boost::shared_ptr<ObjectiveGenerator> _objectiveGenerator;
+	boost::shared_ptr<FixedConstraintsGenerator> _fixedConstraintsGenerator;
+	
+	// Solutions of independent parts of previous windows
+	boost::shared_ptr<SolutionCache> _solutionCache;
+	
+	// Image crops, used unless a cache is shared through the "stack cache" input
+	boost::shared_ptr<ImageStackCache> _ownStackCache;
+	
+	// The MIP solver for the components, chosen by the catmaidsopnet.solverBackend option
+	boost::shared_ptr<SolverBackend> _solverBackend;
+	
+	// The decisions of the last solve, to warm start the next, replaced after every solve
+	boost::shared_ptr<SegmentAssignment> _previousAssignment;
+	
+	// Used when no "fixed segments" are given, fixes nothing
+	pipeline::Value<SegmentAssignment> _noFixedSegments;
+	
+	// Used when no "solver budget" is given, no limits
+	pipeline::Value<SolverBudget> _noBudget;
+
+	// Used when no "segmentation cost parameters" are given, adds no costs
+	pipeline::Value<SegmentationCostFunctionParameters> _noSegmentationParameters;
+	
+	// Used when no "neuron stream" is given, does nothing
+	pipeline::Value<ComponentListener> _noListener;
+	
+	// Whether the last window was solved, and what it looked like
+	bool _solved;
+	std::size_t _fingerprint;
+
+	// The hash of the random forest the cached costs were computed with
+	std::size_t _forestHash;
 
 };
 
@@ -0,0 +1,126 @@
+#include "CroppedSegmentationCostFunction.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/unordered_map.hpp>
+#include <sopnet/inference/SegmentationCostFunction.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+#include <catmaidsopnet/ParallelFor.h>
+
+logger::LogChannel croppedsegmentationcostfunctionlog("croppedsegmentationcostfunctionlog",
+													  "[CroppedSegmentationCostFunction] ");
+
+CroppedSegmentationCostFunction::CroppedSegmentationCostFunction() :
+	_costFunction(new costs_function_type())
+{
+	registerInput(_membraneFactory, "membrane factory");
+	registerInput(_parameters, "parameters", pipeline::Optional);
+	registerInput(_blocks, "blocks");
+	registerInput(_stackCache, "stack cache");
+	
+	registerOutput(_costFunction, "cost function");
+}
+
+void
+CroppedSegmentationCostFunction::updateOutputs()
+{
+	*_costFunction = boost::bind(&CroppedSegmentationCostFunction::costs, this, _1, _2, _3, _4);
+}
+
+void
+CroppedSegmentationCostFunction::costs(
+		const std::vector<boost::shared_ptr<EndSegment> >& ends,
+		const std::vector<boost::shared_ptr<ContinuationSegment> >& continuations,
+		const std::vector<boost::shared_ptr<BranchSegment> >& branches,
+		std::vector<double>& segmentCosts)
+{
+	if (!_parameters || (_parameters->weight == 0 && _parameters->weightPotts == 0))
+	{
+		// Not configured, the segmentation costs are left out.
+		return;
+	}
+	
+	Segments segments;
+	// Position of every segment in segmentCosts.
+	boost::unordered_map<unsigned int, unsigned int> indices;
+	unsigned int i = 0;
+	
+	foreach (boost::shared_ptr<EndSegment> end, ends)
+	{
+		segments.add(end);
+		indices[end->getId()] = i++;
+	}
+	
+	foreach (boost::shared_ptr<ContinuationSegment> continuation, continuations)
+	{
+		segments.add(continuation);
+		indices[continuation->getId()] = i++;
+	}
+	
+	foreach (boost::shared_ptr<BranchSegment> branch, branches)
+	{
+		segments.add(branch);
+		indices[branch->getId()] = i++;
+	}
+	
+	if (segments.size() == 0)
+	{
+		return;
+	}
+	
+	SegmentCropper cropper(_blocks->getManager());
+	std::vector<SegmentCropper::Crop> crops = cropper.crop(segments);
+	std::vector<std::vector<double> > results(crops.size());
+	
+	parallelFor(crops.size(),
+				boost::bind(&CroppedSegmentationCostFunction::cropCosts, this, _1,
+							boost::cref(crops), boost::ref(results)));
+	
+	for (unsigned int c = 0; c < crops.size(); ++c)
+	{
+		const Segments& cropSegments = *crops[c].segments;
+		unsigned int j = 0;
+		
+		// The costs of a crop are in the order ends, continuations, branches.
+		foreach (boost::shared_ptr<EndSegment> end, cropSegments.getEnds())
+		{
+			segmentCosts[indices[end->getId()]] += results[c][j++];
+		}
+		
+		foreach (boost::shared_ptr<ContinuationSegment> continuation,
+				 cropSegments.getContinuations())
+		{
+			segmentCosts[indices[continuation->getId()]] += results[c][j++];
+		}
+		
+		foreach (boost::shared_ptr<BranchSegment> branch, cropSegments.getBranches())
+		{
+			segmentCosts[indices[branch->getId()]] += results[c][j++];
+		}
+	}
+}
+
+void
+CroppedSegmentationCostFunction::cropCosts(unsigned int i,
+										   const std::vector<SegmentCropper::Crop>& crops,
+										   std::vector<std::vector<double> >& results)
+{
+	const SegmentCropper::Crop& crop = crops[i];
+	boost::shared_ptr<SegmentationCostFunction> segmentationCostFunction =
+		boost::make_shared<SegmentationCostFunction>();
+	pipeline::Value<util::point3<unsigned int> > offset(crop.blocks->location());
+	
+	segmentationCostFunction->setInput("membranes",
+									   _stackCache->getStack(_membraneFactory, crop.blocks));
+	segmentationCostFunction->setInput("parameters", _parameters);
+	segmentationCostFunction->setInput("crop offset", offset);
+	
+	pipeline::Value<costs_function_type> costFunction =
+		segmentationCostFunction->getOutput("cost function");
+	
+	results[i].assign(crop.segments->size(), 0.0);
+	
+	(*costFunction)(crop.segments->getEnds(), crop.segments->getContinuations(),
+					crop.segments->getBranches(), results[i]);
+}
@@ -0,0 +1,58 @@
+#ifndef CROPPED_SEGMENTATION_COST_FUNCTION_H__
+#define CROPPED_SEGMENTATION_COST_FUNCTION_H__
+
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <pipeline/all.h>
+#include <imageprocessing/io/ImageBlockFactory.h>
+#include <sopnet/block/Blocks.h>
+#include <sopnet/inference/SegmentationCostFunctionParameters.h>
+#include <sopnet/segments/EndSegment.h>
+#include <sopnet/segments/ContinuationSegment.h>
+#include <sopnet/segments/BranchSegment.h>
+#include <catmaidsopnet/ImageStackCache.h>
+#include <catmaidsopnet/SegmentCropper.h>
+
+/**
+ * A SegmentationCostFunction that reads membranes only for the crops of a SegmentCropper,
+ * instead of one stack around all segments. The segments are split into crops when the costs
+ * are requested, and each crop is evaluated by its own SegmentationCostFunction. Without
+ * parameters, or with both weights zero, no costs are added and no membranes are read.
+ */
+class CroppedSegmentationCostFunction : public pipeline::SimpleProcessNode<>
+{
+	typedef boost::function<
+			void
+			(const std::vector<boost::shared_ptr<EndSegment> >&          ends,
+			 const std::vector<boost::shared_ptr<ContinuationSegment> >& continuations,
+			 const std::vector<boost::shared_ptr<BranchSegment> >&       branches,
+			 std::vector<double>& segmentCosts)>
+			costs_function_type;
+
+public:
+	CroppedSegmentationCostFunction();
+
+private:
+
+	void updateOutputs();
+
+	void costs(const std::vector<boost::shared_ptr<EndSegment> >& ends,
+			   const std::vector<boost::shared_ptr<ContinuationSegment> >& continuations,
+			   const std::vector<boost::shared_ptr<BranchSegment> >& branches,
+			   std::vector<double>& segmentCosts);
+
+	void cropCosts(unsigned int i,
+				   const std::vector<SegmentCropper::Crop>& crops,
+				   std::vector<std::vector<double> >& results);
+
+	pipeline::Input<ImageBlockFactory> _membraneFactory;
+	pipeline::Input<SegmentationCostFunctionParameters> _parameters;
+	// The requested blocks, only their block manager is used.
+	pipeline::Input<Blocks> _blocks;
+	pipeline::Input<ImageStackCache> _stackCache;
+
+	pipeline::Output<costs_function_type> _costFunction;
+};
+
+#endif //CROPPED_SEGMENTATION_COST_FUNCTION_H__
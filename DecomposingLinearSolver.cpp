@@ -0,0 +1,766 @@
+#include "DecomposingLinearSolver.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
+#include <inference/Relation.h>
+#include <pipeline/Value.h>
+#include <sopnet/inference/LinearSolver.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+#include <catmaidsopnet/ParallelFor.h>
+
+logger::LogChannel decomposinglinearsolverlog("decomposinglinearsolverlog",
+											  "[DecomposingLinearSolver] ");
+
+// The relative gap up to which a solution counts as optimal, the default of HiGHS.
+static const double OptimalGap = 1e-4;
+
+/**
+ * Union-find over variable indices, with path halving and union by size.
+ */
+class VariableSets
+{
+public:
+	VariableSets(unsigned int size) : _parents(size), _sizes(size, 1)
+	{
+		for (unsigned int i = 0; i < size; ++i)
+		{
+			_parents[i] = i;
+		}
+	}
+
+	unsigned int find(unsigned int i)
+	{
+		while (_parents[i] != i)
+		{
+			_parents[i] = _parents[_parents[i]];
+			i = _parents[i];
+		}
+
+		return i;
+	}
+
+	void merge(unsigned int i, unsigned int j)
+	{
+		i = find(i);
+		j = find(j);
+
+		if (i == j)
+		{
+			return;
+		}
+
+		if (_sizes[i] < _sizes[j])
+		{
+			std::swap(i, j);
+		}
+
+		_parents[j] = i;
+		_sizes[i] += _sizes[j];
+	}
+
+private:
+	std::vector<unsigned int> _parents;
+	std::vector<unsigned int> _sizes;
+};
+
+DecomposingLinearSolver::DecomposingLinearSolver() :
+	_hasDeadline(false)
+{
+	registerInput(_objective, "objective");
+	registerInput(_linearConstraints, "linear constraints");
+	registerInput(_parameters, "parameters");
+	registerInput(_problemConfiguration, "problem configuration", pipeline::Optional);
+	registerInput(_cache, "solution cache", pipeline::Optional);
+	registerInput(_budget, "budget", pipeline::Optional);
+	registerInput(_listener, "component listener", pipeline::Optional);
+	registerInput(_backend, "backend", pipeline::Optional);
+	registerInput(_warmStart, "warm start", pipeline::Optional);
+
+	registerOutput(_solution, "solution");
+	registerOutput(_statistics, "statistics");
+}
+
+std::vector<boost::shared_ptr<DecomposingLinearSolver::Component> >
+DecomposingLinearSolver::decompose(const SparseConstraintMatrix& constraints,
+								   unsigned int numVariables)
+{
+	typedef SparseConstraintMatrix::column_iterator column_iterator;
+
+	std::vector<boost::shared_ptr<Component> > components;
+	VariableSets sets(numVariables);
+	std::vector<bool> constrained(numVariables, false);
+	// component index by set root, -1 if none yet
+	std::vector<int> componentIndex(numVariables, -1);
+	// local index of each variable in its component
+	std::vector<unsigned int> localIndex(numVariables, 0);
+	std::vector<unsigned int> localColumns;
+	std::vector<double> localCoefficients;
+
+	for (unsigned int row = 0; row < constraints.numRows(); ++row)
+	{
+		if (constraints.rowSize(row) == 0)
+		{
+			continue;
+		}
+
+		unsigned int first = *constraints.columnsBegin(row);
+
+		for (column_iterator column = constraints.columnsBegin(row);
+			 column != constraints.columnsEnd(row); ++column)
+		{
+			constrained[*column] = true;
+			sets.merge(first, *column);
+		}
+	}
+
+	// Variables are visited in increasing order, so the variables of each component are sorted.
+	for (unsigned int i = 0; i < numVariables; ++i)
+	{
+		if (!constrained[i])
+		{
+			continue;
+		}
+
+		unsigned int root = sets.find(i);
+
+		if (componentIndex[root] < 0)
+		{
+			componentIndex[root] = components.size();
+			components.push_back(boost::make_shared<Component>());
+		}
+
+		std::vector<unsigned int>& variables = components[componentIndex[root]]->variables;
+
+		localIndex[i] = variables.size();
+		variables.push_back(i);
+	}
+
+	for (unsigned int row = 0; row < constraints.numRows(); ++row)
+	{
+		if (constraints.rowSize(row) == 0)
+		{
+			continue;
+		}
+
+		localColumns.clear();
+
+		for (column_iterator column = constraints.columnsBegin(row);
+			 column != constraints.columnsEnd(row); ++column)
+		{
+			localColumns.push_back(localIndex[*column]);
+		}
+
+		localCoefficients.assign(constraints.coefficientsBegin(row),
+								 constraints.coefficientsBegin(row) + localColumns.size());
+
+		components[componentIndex[sets.find(*constraints.columnsBegin(row))]]->constraints.addRow(
+				localColumns, localCoefficients, constraints.getRelation(row),
+				constraints.getValue(row));
+	}
+
+	return components;
+}
+
+/**
+ * Orders components by increasing number of variables.
+ */
+static bool
+smallerComponent(const boost::shared_ptr<DecomposingLinearSolver::Component>& a,
+				 const boost::shared_ptr<DecomposingLinearSolver::Component>& b)
+{
+	return a->variables.size() < b->variables.size();
+}
+
+void
+DecomposingLinearSolver::updateOutputs()
+{
+	if (_parameters->getVariableType() != Binary)
+	{
+		solveWhole();
+		return;
+	}
+
+	const std::vector<double>& coefficients = _objective->getCoefficients();
+	unsigned int numVariables = _objective->size();
+	std::vector<boost::shared_ptr<Component> > components =
+		decompose(*_linearConstraints, numVariables);
+	std::vector<ComponentResult> results(components.size());
+	unsigned int largest = 0;
+	Solution solution(numVariables);
+	SolveStatistics statistics;
+
+	foreach (boost::shared_ptr<Component> component, components)
+	{
+		largest = std::max(largest, (unsigned int)component->variables.size());
+	}
+
+	LOG_DEBUG(decomposinglinearsolverlog) << "Split " << numVariables << " variables into " <<
+		components.size() << " components, the largest has " << largest << " variables" <<
+		std::endl;
+
+	_hasDeadline = (_budget && _budget->timeLimit > 0);
+
+	if (_hasDeadline)
+	{
+		_deadline = boost::posix_time::microsec_clock::universal_time() +
+			boost::posix_time::microseconds(static_cast<long>(_budget->timeLimit * 1e6));
+
+		// Solve as many components as possible before the deadline.
+		std::stable_sort(components.begin(), components.end(), smallerComponent);
+	}
+
+	// Unconstrained variables are chosen if they lower the objective.
+	for (unsigned int i = 0; i < numVariables; ++i)
+	{
+		solution[i] = (coefficients[i] < 0 ? 1 : 0);
+	}
+
+	// A backend uses the same number of threads for every component, solve only as many
+	// components at once as there are threads for.
+	unsigned int numThreads = 0;
+
+	if (_backend)
+	{
+		numThreads = std::max(1u, availableThreads()/std::max(1u, _backend->getNumThreads()));
+	}
+
+	parallelFor(components.size(),
+				boost::bind(&DecomposingLinearSolver::processComponent, this,
+							_1, boost::cref(components), boost::ref(results)),
+				numThreads);
+
+	if (_listener)
+	{
+		std::vector<unsigned int> unconstrained;
+		std::vector<double> values;
+		std::vector<bool> constrained(numVariables, false);
+
+		foreach (boost::shared_ptr<Component> component, components)
+		{
+			foreach (unsigned int i, component->variables)
+			{
+				constrained[i] = true;
+			}
+		}
+
+		for (unsigned int i = 0; i < numVariables; ++i)
+		{
+			if (!constrained[i])
+			{
+				unconstrained.push_back(i);
+				values.push_back(solution[i]);
+			}
+		}
+
+		_listener->componentSolved(unconstrained, values);
+	}
+
+	// Start the lower bound with the cost of every unconstrained variable that can lower the
+	// objective, and add the lower bound of every component.
+	for (unsigned int i = 0; i < numVariables; ++i)
+	{
+		statistics.lowerBound += std::min(0.0, coefficients[i]);
+	}
+
+	for (unsigned int c = 0; c < components.size(); ++c)
+	{
+		const std::vector<unsigned int>& variables = components[c]->variables;
+
+		statistics.lowerBound += results[c].lowerBound;
+
+		for (unsigned int i = 0; i < variables.size(); ++i)
+		{
+			solution[variables[i]] = (*results[c].solution)[i];
+			statistics.lowerBound -= std::min(0.0, coefficients[variables[i]]);
+		}
+
+		if (results[c].nodes >= 0)
+		{
+			statistics.nodes = std::max(statistics.nodes, 0) + results[c].nodes;
+		}
+
+		switch (results[c].method)
+		{
+			case Solved:
+				++statistics.solvedComponents;
+				break;
+			case Cached:
+				++statistics.cachedComponents;
+				break;
+			case Greedy:
+				++statistics.greedyComponents;
+				break;
+		}
+	}
+
+	for (unsigned int i = 0; i < numVariables; ++i)
+	{
+		statistics.objective += coefficients[i]*solution[i];
+	}
+
+	statistics.components = components.size();
+
+	*_solution = solution;
+	*_statistics = statistics;
+
+	LOG_DEBUG(decomposinglinearsolverlog) << statistics.greedyComponents << " of " <<
+		statistics.components << " components solved greedily, gap " << statistics.getGap() <<
+		std::endl;
+	
+	if (_cache && _problemConfiguration)
+	{
+		LOG_DEBUG(decomposinglinearsolverlog) << "Solution cache hit rate: " <<
+			_cache->getHitRate() << " over " << _cache->getLookups() << " components" <<
+			std::endl;
+	}
+}
+
+void
+DecomposingLinearSolver::processComponent(
+		unsigned int i,
+		const std::vector<boost::shared_ptr<Component> >& components,
+		std::vector<ComponentResult>& results)
+{
+	solveComponent(i, components, results);
+
+	if (_listener)
+	{
+		const Solution& solution = *results[i].solution;
+		std::vector<double> values(components[i]->variables.size());
+
+		for (unsigned int j = 0; j < values.size(); ++j)
+		{
+			values[j] = solution[j];
+		}
+
+		_listener->componentSolved(components[i]->variables, values);
+	}
+}
+
+void
+DecomposingLinearSolver::solveComponent(
+		unsigned int i,
+		const std::vector<boost::shared_ptr<Component> >& components,
+		std::vector<ComponentResult>& results)
+{
+	const Component& component = *components[i];
+	const std::vector<double>& coefficients = _objective->getCoefficients();
+	bool useCache = _cache && _problemConfiguration;
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> segmentIds;
+	std::vector<double> costs;
+	std::vector<double> values;
+	std::size_t constraintsHash = 0;
+	std::vector<double> localCosts(component.variables.size());
+
+	for (unsigned int j = 0; j < component.variables.size(); ++j)
+	{
+		localCosts[j] = coefficients[component.variables[j]];
+	}
+
+	if (useCache)
+	{
+		cacheKey(component, order, segmentIds, costs, constraintsHash);
+
+		if (_cache->lookup(segmentIds, costs, constraintsHash, values))
+		{
+			results[i].solution = boost::make_shared<Solution>(component.variables.size());
+			results[i].method = Cached;
+			results[i].nodes = -1;
+			results[i].lowerBound = 0;
+
+			// Only optimal solutions are cached.
+			for (unsigned int j = 0; j < order.size(); ++j)
+			{
+				(*results[i].solution)[order[j]] = values[j];
+				results[i].lowerBound += localCosts[order[j]]*values[j];
+			}
+
+			return;
+		}
+	}
+
+	if (_budget && (pastDeadline() || _budget->gap > 0))
+	{
+		std::vector<double> greedyValues;
+
+		if (greedySolve(component, localCosts, greedyValues))
+		{
+			double objective = 0;
+			double lowerBound = 0;
+
+			for (unsigned int j = 0; j < greedyValues.size(); ++j)
+			{
+				objective += localCosts[j]*greedyValues[j];
+				lowerBound += std::min(0.0, localCosts[j]);
+			}
+
+			double gap = (objective - lowerBound)/std::max(std::abs(objective), 1e-10);
+
+			if (pastDeadline() || gap <= _budget->gap)
+			{
+				results[i].solution = boost::make_shared<Solution>(greedyValues.size());
+				results[i].method = Greedy;
+				results[i].nodes = -1;
+				results[i].lowerBound = lowerBound;
+
+				for (unsigned int j = 0; j < greedyValues.size(); ++j)
+				{
+					(*results[i].solution)[j] = greedyValues[j];
+				}
+
+				return;
+			}
+		}
+		else
+		{
+			// Without a feasible fallback, the component is solved even after the deadline.
+			LOG_DEBUG(decomposinglinearsolverlog) << "No greedy solution for a component of " <<
+				component.variables.size() << " variables" << std::endl;
+		}
+	}
+
+	solveExactly(component, localCosts, results[i]);
+	results[i].method = Solved;
+
+	double objective = 0;
+
+	for (unsigned int j = 0; j < localCosts.size(); ++j)
+	{
+		objective += localCosts[j]*(*results[i].solution)[j];
+	}
+
+	// A solution the backend stopped early on is not cached, the next solve may do better.
+	if (useCache &&
+		objective - results[i].lowerBound <= OptimalGap*std::max(std::abs(objective), 1.0))
+	{
+		values.resize(order.size());
+
+		for (unsigned int j = 0; j < order.size(); ++j)
+		{
+			values[j] = (*results[i].solution)[order[j]];
+		}
+
+		_cache->insert(segmentIds, costs, constraintsHash, values);
+	}
+}
+
+void
+DecomposingLinearSolver::solveExactly(const Component& component,
+									  const std::vector<double>& costs,
+									  ComponentResult& result)
+{
+	result.nodes = -1;
+
+	if (_backend)
+	{
+		LinearObjective objective(component.variables.size());
+		boost::shared_ptr<Solution> solution =
+			boost::make_shared<Solution>(component.variables.size());
+		SolveStatistics statistics;
+		SolverBudget budget;
+		std::vector<double> start;
+
+		for (unsigned int j = 0; j < component.variables.size(); ++j)
+		{
+			objective.setCoefficient(j, costs[j]);
+		}
+
+		warmStart(component, start);
+
+		if (_budget)
+		{
+			budget.gap = _budget->gap;
+
+			// Past the deadline, only components without a greedy solution are solved, and
+			// they are solved without a limit.
+			if (_hasDeadline && !pastDeadline())
+			{
+				budget.timeLimit = (_deadline -
+					boost::posix_time::microsec_clock::universal_time()).total_microseconds()/1e6;
+			}
+		}
+
+		if (_backend->solve(objective, component.constraints, start, budget, *solution,
+							statistics))
+		{
+			result.solution = solution;
+			result.nodes = statistics.nodes;
+			result.lowerBound = statistics.lowerBound;
+			return;
+		}
+
+		LOG_ERROR(decomposinglinearsolverlog) << "Backend failed on a component of " <<
+			component.variables.size() << " variables, using the LinearSolver" << std::endl;
+	}
+
+	boost::shared_ptr<LinearSolver> solver = boost::make_shared<LinearSolver>();
+	pipeline::Value<LinearObjective> objective(LinearObjective(component.variables.size()));
+	// The LinearSolver of sopnet only takes LinearConstraints.
+	boost::shared_ptr<LinearConstraints> constraints =
+		component.constraints.toLinearConstraints();
+	pipeline::Value<LinearSolverParameters> parameters(*_parameters);
+
+	for (unsigned int j = 0; j < component.variables.size(); ++j)
+	{
+		objective->setCoefficient(j, costs[j]);
+	}
+
+	solver->setInput("objective", objective);
+	solver->setInput("linear constraints", constraints);
+	solver->setInput("parameters", parameters);
+
+	pipeline::Value<Solution> solution = solver->getOutput("solution");
+
+	result.solution = boost::make_shared<Solution>(*solution);
+	result.lowerBound = 0;
+
+	// Solved to optimality.
+	for (unsigned int j = 0; j < component.variables.size(); ++j)
+	{
+		result.lowerBound += costs[j]*(*solution)[j];
+	}
+}
+
+/**
+ * Values for the variables of the component from the warm start assignment. Left empty if the
+ * assignment knows none of the segments.
+ */
+void
+DecomposingLinearSolver::warmStart(const Component& component, std::vector<double>& values)
+{
+	bool known = false;
+
+	values.clear();
+
+	if (!_warmStart || !_problemConfiguration)
+	{
+		return;
+	}
+
+	values.resize(component.variables.size(), 0.0);
+
+	for (unsigned int j = 0; j < component.variables.size(); ++j)
+	{
+		unsigned int segmentId = _problemConfiguration->getSegmentId(component.variables[j]);
+
+		if (_warmStart->contains(segmentId))
+		{
+			values[j] = (_warmStart->isChosen(segmentId) ? 1 : 0);
+			known = true;
+		}
+	}
+
+	if (!known)
+	{
+		values.clear();
+	}
+}
+
+bool
+DecomposingLinearSolver::greedySolve(const Component& component,
+									 const std::vector<double>& costs,
+									 std::vector<double>& values)
+{
+	typedef SparseConstraintMatrix::column_iterator column_iterator;
+	typedef SparseConstraintMatrix::coefficient_iterator coefficient_iterator;
+
+	const SparseConstraintMatrix& constraints = component.constraints;
+	unsigned int numVariables = component.variables.size();
+	unsigned int numRows = constraints.numRows();
+	// The rows of each variable, with the variable's coefficient in that row.
+	std::vector<std::vector<std::pair<unsigned int, double> > > variableRows(numVariables);
+	std::vector<std::pair<double, unsigned int> > order;
+	std::vector<double> activities;
+	// Rows with only non-negative coefficients, whose value can not be exceeded.
+	std::vector<bool> capped;
+
+	for (unsigned int r = 0; r < numRows; ++r)
+	{
+		bool nonNegative = true;
+		coefficient_iterator coefficient = constraints.coefficientsBegin(r);
+
+		for (column_iterator column = constraints.columnsBegin(r);
+			 column != constraints.columnsEnd(r); ++column, ++coefficient)
+		{
+			variableRows[*column].push_back(std::make_pair(r, *coefficient));
+			nonNegative = nonNegative && (*coefficient >= 0);
+		}
+
+		capped.push_back(nonNegative && constraints.getRelation(r) != GreaterEqual);
+	}
+
+	activities.assign(numRows, 0.0);
+	values.assign(numVariables, 0.0);
+
+	for (unsigned int j = 0; j < numVariables; ++j)
+	{
+		order.push_back(std::make_pair(costs[j], j));
+	}
+
+	std::sort(order.begin(), order.end());
+
+	// First take every variable that lowers the objective, then add the cheapest ones needed
+	// to satisfy rows that are still below their value.
+	for (unsigned int pass = 0; pass < 2; ++pass)
+	{
+		for (unsigned int k = 0; k < order.size(); ++k)
+		{
+			unsigned int j = order[k].second;
+
+			if (values[j] == 1 || (pass == 0 && order[k].first >= 0))
+			{
+				continue;
+			}
+
+			bool fits = true;
+			bool needed = (pass == 0);
+
+			for (unsigned int e = 0; e < variableRows[j].size(); ++e)
+			{
+				unsigned int r = variableRows[j][e].first;
+				double activity = activities[r] + variableRows[j][e].second;
+
+				if (capped[r] && activity > constraints.getValue(r))
+				{
+					fits = false;
+				}
+
+				if (constraints.getRelation(r) != LessEqual &&
+					activities[r] < constraints.getValue(r))
+				{
+					needed = true;
+				}
+			}
+
+			if (!fits || !needed)
+			{
+				continue;
+			}
+
+			values[j] = 1;
+
+			for (unsigned int e = 0; e < variableRows[j].size(); ++e)
+			{
+				activities[variableRows[j][e].first] += variableRows[j][e].second;
+			}
+		}
+	}
+
+	for (unsigned int r = 0; r < numRows; ++r)
+	{
+		double value = constraints.getValue(r);
+		Relation relation = constraints.getRelation(r);
+
+		if ((relation == LessEqual && activities[r] > value) ||
+			(relation == GreaterEqual && activities[r] < value) ||
+			(relation == Equal && activities[r] != value))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+DecomposingLinearSolver::pastDeadline()
+{
+	return _hasDeadline && boost::posix_time::microsec_clock::universal_time() > _deadline;
+}
+
+/**
+ * Variables are numbered differently in every problem, so the key is expressed in segment ids,
+ * with the segments in increasing order.
+ */
+void
+DecomposingLinearSolver::cacheKey(const Component& component,
+								  std::vector<unsigned int>& order,
+								  std::vector<unsigned int>& segmentIds,
+								  std::vector<double>& costs,
+								  std::size_t& constraintsHash)
+{
+	typedef SparseConstraintMatrix::column_iterator column_iterator;
+	typedef SparseConstraintMatrix::coefficient_iterator coefficient_iterator;
+
+	const SparseConstraintMatrix& constraints = component.constraints;
+	const std::vector<double>& coefficients = _objective->getCoefficients();
+	std::vector<std::pair<unsigned int, unsigned int> > segmentVariables;
+	std::vector<std::pair<unsigned int, double> > terms;
+
+	for (unsigned int j = 0; j < component.variables.size(); ++j)
+	{
+		segmentVariables.push_back(std::make_pair(
+				_problemConfiguration->getSegmentId(component.variables[j]), j));
+	}
+
+	std::sort(segmentVariables.begin(), segmentVariables.end());
+
+	order.clear();
+	segmentIds.clear();
+	costs.clear();
+
+	for (unsigned int j = 0; j < segmentVariables.size(); ++j)
+	{
+		segmentIds.push_back(segmentVariables[j].first);
+		order.push_back(segmentVariables[j].second);
+		costs.push_back(coefficients[component.variables[segmentVariables[j].second]]);
+	}
+
+	// Combine the constraint hashes with a sum, so that the order of the constraints does not
+	// matter.
+	constraintsHash = boost::hash_value(static_cast<int>(_parameters->getVariableType()));
+
+	for (unsigned int row = 0; row < constraints.numRows(); ++row)
+	{
+		std::size_t hash = 0;
+		coefficient_iterator coefficient = constraints.coefficientsBegin(row);
+
+		terms.clear();
+
+		for (column_iterator column = constraints.columnsBegin(row);
+			 column != constraints.columnsEnd(row); ++column, ++coefficient)
+		{
+			terms.push_back(std::make_pair(
+					_problemConfiguration->getSegmentId(component.variables[*column]),
+					*coefficient));
+		}
+
+		std::sort(terms.begin(), terms.end());
+
+		boost::hash_combine(hash, terms);
+		boost::hash_combine(hash, static_cast<int>(constraints.getRelation(row)));
+		boost::hash_combine(hash, constraints.getValue(row));
+
+		constraintsHash += hash;
+	}
+}
+
+void
+DecomposingLinearSolver::solveWhole()
+{
+	boost::shared_ptr<LinearSolver> solver = boost::make_shared<LinearSolver>();
+
+	solver->setInput("objective", _objective);
+	solver->setInput("linear constraints", _linearConstraints->toLinearConstraints());
+	solver->setInput("parameters", _parameters);
+
+	pipeline::Value<Solution> solution = solver->getOutput("solution");
+	SolveStatistics statistics;
+
+	statistics.components = 1;
+	statistics.solvedComponents = 1;
+
+	for (unsigned int i = 0; i < _objective->size(); ++i)
+	{
+		statistics.objective += _objective->getCoefficients()[i]*(*solution)[i];
+	}
+
+	statistics.lowerBound = statistics.objective;
+
+	*_solution = *solution;
+	*_statistics = statistics;
+}
@@ -0,0 +1,211 @@
+#ifndef DECOMPOSING_LINEAR_SOLVER_H__
+#define DECOMPOSING_LINEAR_SOLVER_H__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+#include <pipeline/all.h>
+#include <sopnet/inference/LinearConstraints.h>
+#include <sopnet/inference/LinearObjective.h>
+#include <sopnet/inference/LinearSolverParameters.h>
+#include <sopnet/inference/Solution.h>
+#include <sopnet/inference/ProblemConfiguration.h>
+#include <catmaidsopnet/SegmentAssignment.h>
+#include <catmaidsopnet/SolutionCache.h>
+#include <catmaidsopnet/SolverBackend.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
+
+class SolveStatistics : public pipeline::Data
+{
+public:
+	SolveStatistics() :
+		components(0),
+		solvedComponents(0),
+		cachedComponents(0),
+		greedyComponents(0),
+		objective(0),
+		lowerBound(0),
+		nodes(-1) {}
+
+	/**
+	 * The relative gap between the objective of the solution and the lower bound, 0 if all
+	 * components were solved to optimality.
+	 */
+	double getGap() const
+	{
+		double difference = objective - lowerBound;
+
+		if (difference <= 0)
+		{
+			return 0;
+		}
+
+		return difference / std::max(std::abs(objective), 1e-10);
+	}
+
+	unsigned int components;
+	unsigned int solvedComponents;
+	unsigned int cachedComponents;
+	// Components solved greedily, because the time limit was reached or the gap was good
+	// enough.
+	unsigned int greedyComponents;
+
+	double objective;
+	// The lower bounds the solver reported for the solved components, the objective of the
+	// cached ones, and the sum of the negative costs of all others.
+	double lowerBound;
+
+	// Branch and bound nodes explored, -1 if the solver does not tell.
+	int nodes;
+};
+
+/**
+ * Gets told about the solution of each component as soon as it is known.
+ */
+class ComponentListener : public pipeline::Data
+{
+public:
+	virtual ~ComponentListener() {}
+
+	/**
+	 * Called once for every component, possibly from several threads at once, and once for
+	 * the unconstrained variables after all components. Every variable is reported once.
+	 *
+	 * @param variables - the global indices of the variables of the component.
+	 * @param values - the values of these variables.
+	 */
+	virtual void componentSolved(const std::vector<unsigned int>& /*variables*/,
+								 const std::vector<double>& /*values*/) {}
+};
+
+/**
+ * A replacement for LinearSolver that splits the problem into the connected components
+ * of its constraint graph, ie, sets of variables that share no constraint with any other
+ * variable, solves the components concurrently with one LinearSolver each, and reassembles
+ * the solution.
+ *
+ * The constraints are taken as a SparseConstraintMatrix, e.g., from a ConstraintPresolver, and
+ * are only converted to LinearConstraints where a component is handed to the sopnet
+ * LinearSolver.
+ *
+ * Binary variables that appear in no constraint are set directly, to 1 if their coefficient
+ * in the (minimized) objective is negative. Problems with non-binary variables are solved as
+ * a whole.
+ *
+ * If a SolutionCache and the problem configuration of the ProblemMatrixAssembler are given,
+ * components are identified by their segments, and components that have been solved before
+ * with the same costs and constraints are taken from the cache instead of being solved again.
+ *
+ * With a SolverBudget, components are solved smallest first, and the ones started after the
+ * time limit are given a greedy feasible solution instead. The backend gets the time left and
+ * the gap of the budget for each component. The achieved gap is reported in the statistics.
+ *
+ * A ComponentListener given as "component listener" receives each component's solution as
+ * soon as it is found, before the whole problem is solved.
+ *
+ * Components are solved with the given SolverBackend, or with the sopnet LinearSolver if there
+ * is none. A SegmentAssignment given as "warm start", e.g., the solution of the previous
+ * window, is passed to the backend as a starting point.
+ */
+class DecomposingLinearSolver : public pipeline::SimpleProcessNode<>
+{
+public:
+	/**
+	 * A part of the problem that can be solved independently.
+	 */
+	struct Component
+	{
+		// The global indices of the variables of this component, in increasing order. Local
+		// variable i of the component is global variable variables[i].
+		std::vector<unsigned int> variables;
+
+		// The constraints of this component, over local variables.
+		SparseConstraintMatrix constraints;
+	};
+
+	DecomposingLinearSolver();
+
+	/**
+	 * Split the given constraints into independent components over at most numVariables
+	 * variables. Variables without constraints are not part of any component.
+	 */
+	static std::vector<boost::shared_ptr<Component> > decompose(
+			const SparseConstraintMatrix& constraints,
+			unsigned int numVariables);
+
+	/**
+	 * Find a feasible solution of the component by choosing variables greedily in the order
+	 * of their costs. Returns false if the greedy choice is infeasible.
+	 */
+	static bool greedySolve(const Component& component,
+							const std::vector<double>& costs,
+							std::vector<double>& values);
+
+private:
+
+	enum SolveMethod
+	{
+		Solved,
+		Cached,
+		Greedy
+	};
+
+	struct ComponentResult
+	{
+		boost::shared_ptr<Solution> solution;
+		SolveMethod method;
+		int nodes;
+		// Of the objective of the component, over its local variables.
+		double lowerBound;
+	};
+
+	void updateOutputs();
+
+	void processComponent(unsigned int i,
+						  const std::vector<boost::shared_ptr<Component> >& components,
+						  std::vector<ComponentResult>& results);
+
+	void solveComponent(unsigned int i,
+						const std::vector<boost::shared_ptr<Component> >& components,
+						std::vector<ComponentResult>& results);
+
+	void solveExactly(const Component& component,
+					  const std::vector<double>& costs,
+					  ComponentResult& result);
+
+	void warmStart(const Component& component, std::vector<double>& values);
+
+	bool pastDeadline();
+
+	void solveWhole();
+
+	/**
+	 * Sort the variables of the component by segment id and compute the cache key for it.
+	 */
+	void cacheKey(const Component& component,
+				  std::vector<unsigned int>& order,
+				  std::vector<unsigned int>& segmentIds,
+				  std::vector<double>& costs,
+				  std::size_t& constraintsHash);
+
+	pipeline::Input<LinearObjective> _objective;
+	pipeline::Input<SparseConstraintMatrix> _linearConstraints;
+	pipeline::Input<LinearSolverParameters> _parameters;
+	pipeline::Input<ProblemConfiguration> _problemConfiguration;
+	pipeline::Input<SolutionCache> _cache;
+	pipeline::Input<SolverBudget> _budget;
+	pipeline::Input<ComponentListener> _listener;
+	pipeline::Input<SolverBackend> _backend;
+	pipeline::Input<SegmentAssignment> _warmStart;
+
+	pipeline::Output<Solution> _solution;
+	pipeline::Output<SolveStatistics> _statistics;
+
+	// Set while solving with a time limit
+	bool _hasDeadline;
+	boost::posix_time::ptime _deadline;
+};
+
+#endif //DECOMPOSING_LINEAR_SOLVER_H__
@@ -0,0 +1,36 @@
+#include "DenseIdMap.h"
+
+unsigned int
+DenseIdMap::insert(unsigned int id)
+{
+	std::pair<boost::unordered_map<unsigned int, unsigned int>::iterator, bool> result =
+		_indices.insert(std::make_pair(id, _ids.size()));
+	
+	if (result.second)
+	{
+		_ids.push_back(id);
+	}
+	
+	return result.first->second;
+}
+
+bool
+DenseIdMap::find(unsigned int id, unsigned int& index) const
+{
+	boost::unordered_map<unsigned int, unsigned int>::const_iterator it = _indices.find(id);
+	
+	if (it == _indices.end())
+	{
+		return false;
+	}
+	
+	index = it->second;
+	return true;
+}
+
+void
+DenseIdMap::clear()
+{
+	_indices.clear();
+	_ids.clear();
+}
@@ -0,0 +1,41 @@
+#ifndef DENSE_ID_MAP_H__
+#define DENSE_ID_MAP_H__
+
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+/**
+ * Assigns dense indices 0..n-1 to sparse global ids, in order of insertion, so that per-id
+ * data of one problem can be held in flat arrays. The global id of an index is a plain array
+ * lookup.
+ */
+class DenseIdMap
+{
+public:
+	/**
+	 * Return the index of the given id, assigning the next free one if the id is new.
+	 */
+	unsigned int insert(unsigned int id);
+	
+	/**
+	 * Find the index of the given id. Returns false if the id has not been inserted.
+	 */
+	bool find(unsigned int id, unsigned int& index) const;
+	
+	unsigned int getId(unsigned int index) const { return _ids[index]; }
+	
+	/**
+	 * The global ids, by index.
+	 */
+	const std::vector<unsigned int>& getIds() const { return _ids; }
+	
+	unsigned int size() const { return _ids.size(); }
+	
+	void clear();
+	
+private:
+	boost::unordered_map<unsigned int, unsigned int> _indices;
+	std::vector<unsigned int> _ids;
+};
+
+#endif //DENSE_ID_MAP_H__
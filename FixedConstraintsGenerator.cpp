@@ -0,0 +1,15 @@
+#include "FixedConstraintsGenerator.h"
+
+FixedConstraintsGenerator::FixedConstraintsGenerator()
+{
+	registerInput(_segments, "segments");
+	registerInput(_fixedSegments, "fixed segments");
+
+	registerOutput(_constraints, "linear constraints");
+}
+
+void
+FixedConstraintsGenerator::updateOutputs()
+{
+	*_constraints = *_fixedSegments->fixingConstraints(*_segments);
+}
@@ -0,0 +1,28 @@
+#ifndef FIXED_CONSTRAINTS_GENERATOR_H__
+#define FIXED_CONSTRAINTS_GENERATOR_H__
+
+#include <pipeline/all.h>
+#include <sopnet/segments/Segments.h>
+#include <catmaidsopnet/SegmentAssignment.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
+
+/**
+ * Creates the constraints that fix the given segments to their decisions in the "fixed
+ * segments" assignment, e.g., the decisions of the neighbouring windows of a VolumeSolver.
+ * Decisions for segments that are not given are ignored. The constraints are over segment ids.
+ */
+class FixedConstraintsGenerator : public pipeline::SimpleProcessNode<>
+{
+public:
+	FixedConstraintsGenerator();
+
+private:
+	void updateOutputs();
+
+	pipeline::Input<Segments> _segments;
+	pipeline::Input<SegmentAssignment> _fixedSegments;
+
+	pipeline::Output<SparseConstraintMatrix> _constraints;
+};
+
+#endif //FIXED_CONSTRAINTS_GENERATOR_H__
@@ -0,0 +1,287 @@
+#include "IlpBenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+#include <pipeline/Value.h>
+#include <inference/Relation.h>
+#include <sopnet/inference/LinearSolver.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+#include <catmaidsopnet/ConstraintPresolver.h>
+#include <catmaidsopnet/ProblemReader.h>
+
+logger::LogChannel ilpbenchmarklog("ilpbenchmarklog", "[IlpBenchmark] ");
+
+static boost::shared_ptr<Solution>
+solveWithLinearSolver(const boost::shared_ptr<LinearObjective>& objective,
+					  const boost::shared_ptr<LinearConstraints>& constraints,
+					  const boost::shared_ptr<SparseConstraintMatrix>& /*matrix*/,
+					  SolveStatistics& statistics)
+{
+	boost::shared_ptr<LinearSolver> solver = boost::make_shared<LinearSolver>();
+	
+	solver->setInput("objective", objective);
+	solver->setInput("linear constraints", constraints);
+	solver->setInput("parameters", boost::make_shared<LinearSolverParameters>(Binary));
+	
+	pipeline::Value<Solution> solution = solver->getOutput("solution");
+	
+	statistics.components = 1;
+	statistics.solvedComponents = 1;
+	
+	// Solved to optimality.
+	for (unsigned int i = 0; i < objective->size(); ++i)
+	{
+		statistics.objective += objective->getCoefficients()[i]*(*solution)[i];
+	}
+	
+	statistics.lowerBound = statistics.objective;
+	
+	return solution;
+}
+
+static boost::shared_ptr<Solution>
+solveWithDecomposingLinearSolver(const boost::shared_ptr<LinearObjective>& objective,
+								 const boost::shared_ptr<LinearConstraints>& /*constraints*/,
+								 const boost::shared_ptr<SparseConstraintMatrix>& matrix,
+								 SolveStatistics& statistics)
+{
+	boost::shared_ptr<DecomposingLinearSolver> solver =
+		boost::make_shared<DecomposingLinearSolver>();
+	
+	solver->setInput("objective", objective);
+	solver->setInput("linear constraints", matrix);
+	solver->setInput("parameters", boost::make_shared<LinearSolverParameters>(Binary));
+	
+	pipeline::Value<Solution> solution = solver->getOutput("solution");
+	pipeline::Value<SolveStatistics> solverStatistics = solver->getOutput("statistics");
+	
+	statistics = *solverStatistics;
+	
+	return solution;
+}
+
+/**
+ * The DecomposingLinearSolver behind a ConstraintPresolver, as in CoreSolver, but without a
+ * warm start. The presolve is timed as well.
+ */
+static boost::shared_ptr<Solution>
+solveWithPresolvedDecomposingLinearSolver(
+		const boost::shared_ptr<LinearObjective>& objective,
+		const boost::shared_ptr<LinearConstraints>& /*constraints*/,
+		const boost::shared_ptr<SparseConstraintMatrix>& matrix,
+		SolveStatistics& statistics)
+{
+	boost::shared_ptr<ConstraintPresolver> presolver = boost::make_shared<ConstraintPresolver>();
+	boost::shared_ptr<DecomposingLinearSolver> solver =
+		boost::make_shared<DecomposingLinearSolver>();
+	
+	presolver->setInput("linear constraints", matrix);
+	
+	solver->setInput("objective", objective);
+	solver->setInput("linear constraints", presolver->getOutput("linear constraints"));
+	solver->setInput("parameters", boost::make_shared<LinearSolverParameters>(Binary));
+	
+	pipeline::Value<Solution> solution = solver->getOutput("solution");
+	pipeline::Value<SolveStatistics> solverStatistics = solver->getOutput("statistics");
+	
+	statistics = *solverStatistics;
+	
+	return solution;
+}
+
+static boost::shared_ptr<Solution>
+solveWithSolverBackend(const boost::shared_ptr<SolverBackend>& backend,
+					   const boost::shared_ptr<LinearObjective>& objective,
+					   const boost::shared_ptr<LinearConstraints>& /*constraints*/,
+					   const boost::shared_ptr<SparseConstraintMatrix>& matrix,
+					   SolveStatistics& statistics)
+{
+	boost::shared_ptr<Solution> solution = boost::make_shared<Solution>(objective->size());
+	
+	statistics.components = 1;
+	
+	if (backend->solve(*objective, *matrix, std::vector<double>(), SolverBudget(), *solution,
+					   statistics))
+	{
+		statistics.solvedComponents = 1;
+	}
+	
+	return solution;
+}
+
+void
+IlpBenchmark::addDefaultBackends()
+{
+	addBackend("linear solver", solveWithLinearSolver);
+	addBackend("decomposing", solveWithDecomposingLinearSolver);
+	addBackend("presolved decomposing", solveWithPresolvedDecomposingLinearSolver);
+	
+#ifdef HAVE_HIGHS
+	addBackend("highs", SolverBackend::create("highs"), 1);
+#endif
+}
+
+void
+IlpBenchmark::addBackend(const std::string& name, const backend_type& backend)
+{
+	_backends.push_back(std::make_pair(name, backend));
+}
+
+void
+IlpBenchmark::addBackend(const std::string& name,
+						 const boost::shared_ptr<SolverBackend>& backend,
+						 unsigned int numThreads)
+{
+	backend->setNumThreads(numThreads);
+	
+	addBackend(name, boost::bind(solveWithSolverBackend, backend, _1, _2, _3, _4));
+}
+
+std::vector<IlpBenchmark::Result>
+IlpBenchmark::run(const std::string& directory)
+{
+	std::vector<std::string> filenames;
+	
+	for (boost::filesystem::directory_iterator it(directory);
+		 it != boost::filesystem::directory_iterator(); ++it)
+	{
+		if (it->path().extension() == ".lp")
+		{
+			filenames.push_back(it->path().string());
+		}
+	}
+	
+	std::sort(filenames.begin(), filenames.end());
+	
+	return run(filenames);
+}
+
+std::vector<IlpBenchmark::Result>
+IlpBenchmark::run(const std::vector<std::string>& filenames)
+{
+	std::vector<Result> results;
+	
+	foreach (const std::string& filename, filenames)
+	{
+		boost::shared_ptr<LinearObjective> objective;
+		boost::shared_ptr<LinearConstraints> constraints;
+		boost::shared_ptr<SparseConstraintMatrix> matrix =
+			boost::make_shared<SparseConstraintMatrix>();
+		
+		ProblemReader::readLp(filename, objective, constraints);
+		matrix->addRows(*constraints);
+		
+		for (unsigned int b = 0; b < _backends.size(); ++b)
+		{
+			SolveStatistics statistics;
+			Result result;
+			
+			LOG_DEBUG(ilpbenchmarklog) << "Solving " << filename << " with " <<
+				_backends[b].first << std::endl;
+			
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			
+			boost::shared_ptr<Solution> solution =
+				_backends[b].second(objective, constraints, matrix, statistics);
+			
+			boost::posix_time::time_duration duration =
+				boost::posix_time::microsec_clock::universal_time() - start;
+			
+			result.problem = filename;
+			result.backend = _backends[b].first;
+			result.variables = objective->size();
+			result.constraints = constraints->size();
+			result.seconds = duration.total_microseconds()/1e6;
+			result.nodes = statistics.nodes;
+			result.objective = 0;
+			
+			for (unsigned int i = 0; i < objective->size(); ++i)
+			{
+				result.objective += objective->getCoefficients()[i]*(*solution)[i];
+			}
+			
+			result.gap = statistics.getGap();
+			result.feasible = isFeasible(*constraints, *solution);
+			
+			results.push_back(result);
+		}
+	}
+	
+	return results;
+}
+
+void
+IlpBenchmark::writeReport(const std::vector<Result>& results, std::ostream& out)
+{
+	std::map<std::string, double> totals;
+	
+	out << "problem\tbackend\tvariables\tconstraints\tseconds\tnodes\tobjective\tgap\tfeasible" <<
+		std::endl;
+	
+	foreach (const Result& result, results)
+	{
+		out << result.problem << "\t" << result.backend << "\t" << result.variables << "\t" <<
+			result.constraints << "\t" << result.seconds << "\t" << result.nodes << "\t" <<
+			result.objective << "\t" << result.gap << "\t" << (result.feasible ? "yes" : "no") <<
+			std::endl;
+		
+		totals[result.backend] += result.seconds;
+	}
+	
+	out << std::endl;
+	
+	for (std::map<std::string, double>::const_iterator it = totals.begin(); it != totals.end();
+		 ++it)
+	{
+		out << "total\t" << it->first << "\t" << it->second << std::endl;
+	}
+}
+
+bool
+IlpBenchmark::isFeasible(const LinearConstraints& constraints, const Solution& solution)
+{
+	typedef std::map<unsigned int, double>::value_type pair_t;
+	
+	// Coefficients and values are integral, a small tolerance covers solver round-off.
+	const double tolerance = 1e-6;
+	
+	foreach (const LinearConstraint& constraint, constraints)
+	{
+		double activity = 0;
+		
+		foreach (const pair_t& pair, constraint.getCoefficients())
+		{
+			activity += pair.second*solution[pair.first];
+		}
+		
+		switch (constraint.getRelation())
+		{
+			case LessEqual:
+				if (activity > constraint.getValue() + tolerance)
+				{
+					return false;
+				}
+				break;
+			case GreaterEqual:
+				if (activity < constraint.getValue() - tolerance)
+				{
+					return false;
+				}
+				break;
+			default:
+				if (std::abs(activity - constraint.getValue()) > tolerance)
+				{
+					return false;
+				}
+				break;
+		}
+	}
+	
+	return true;
+}
@@ -0,0 +1,92 @@
+#ifndef ILP_BENCHMARK_H__
+#define ILP_BENCHMARK_H__
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <sopnet/inference/LinearConstraints.h>
+#include <sopnet/inference/LinearObjective.h>
+#include <sopnet/inference/Solution.h>
+#include <catmaidsopnet/DecomposingLinearSolver.h>
+#include <catmaidsopnet/SolverBackend.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
+
+/**
+ * Solves a corpus of problems dumped by CoreSolver (see the catmaidsopnet.dumpProblems
+ * program option) with every registered backend, and reports how each one did.
+ *
+ * The dumped problems are taken before the ConstraintPresolver, and CoreSolver starts each
+ * solve from the solution of the previous window, which no backend here gets. The backend
+ * closest to CoreSolver is "presolved decomposing", "decomposing" solves without presolve.
+ */
+class IlpBenchmark
+{
+public:
+
+	/**
+	 * A way to solve a binary problem. The constraints are given both as read and as a
+	 * SparseConstraintMatrix, so that no backend pays for a conversion while it is timed.
+	 * Fills in what it knows about the solve in statistics.
+	 */
+	typedef boost::function<
+			boost::shared_ptr<Solution>
+			(const boost::shared_ptr<LinearObjective>&        objective,
+			 const boost::shared_ptr<LinearConstraints>&      constraints,
+			 const boost::shared_ptr<SparseConstraintMatrix>& matrix,
+			 SolveStatistics&                                 statistics)>
+			backend_type;
+
+	struct Result
+	{
+		std::string problem;
+		std::string backend;
+		unsigned int variables;
+		unsigned int constraints;
+		double seconds;
+		int nodes;
+		double objective;
+		double gap;
+		bool feasible;
+	};
+
+	/**
+	 * Add the backends available in this build: the sopnet LinearSolver on the whole problem,
+	 * the DecomposingLinearSolver without and with a ConstraintPresolver, and HiGHS on the
+	 * whole problem if it is available.
+	 */
+	void addDefaultBackends();
+
+	void addBackend(const std::string& name, const backend_type& backend);
+
+	/**
+	 * Add a SolverBackend that gets the whole problem, with the given number of threads.
+	 */
+	void addBackend(const std::string& name,
+					const boost::shared_ptr<SolverBackend>& backend,
+					unsigned int numThreads = 1);
+
+	/**
+	 * Solve every LP file in the given directory with every backend.
+	 */
+	std::vector<Result> run(const std::string& directory);
+
+	/**
+	 * Solve the given LP files with every backend.
+	 */
+	std::vector<Result> run(const std::vector<std::string>& filenames);
+
+	/**
+	 * Write the results as a tab separated table, followed by the total time per backend.
+	 */
+	static void writeReport(const std::vector<Result>& results, std::ostream& out);
+
+private:
+
+	static bool isFeasible(const LinearConstraints& constraints, const Solution& solution);
+
+	std::vector<std::pair<std::string, backend_type> > _backends;
+};
+
+#endif //ILP_BENCHMARK_H__
@@ -0,0 +1,100 @@
+#include "ImageStackCache.h"
+
+#include <algorithm>
+#include <boost/make_shared.hpp>
+#include <pipeline/Value.h>
+#include <imageprocessing/io/ImageBlockStackReader.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel imagestackcachelog("imagestackcachelog", "[ImageStackCache] ");
+
+ImageStackCache::ImageStackCache(unsigned int capacity) :
+	_capacity(capacity),
+	_reads(0),
+	_hits(0)
+{
+}
+
+boost::shared_ptr<ImageStack>
+ImageStackCache::getStack(const boost::shared_ptr<ImageBlockFactory>& factory,
+						  const boost::shared_ptr<Blocks>& blocks)
+{
+	std::vector<unsigned int> blockIds;
+	
+	foreach (boost::shared_ptr<Block> block, *blocks)
+	{
+		blockIds.push_back(block->getId());
+	}
+	
+	std::sort(blockIds.begin(), blockIds.end());
+	
+	{
+		boost::mutex::scoped_lock lock(_mutex);
+		
+		for (std::list<Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+		{
+			if (it->factory == factory.get() && it->blockIds == blockIds)
+			{
+				// Move to the front.
+				_entries.splice(_entries.begin(), _entries, it);
+				++_hits;
+				return _entries.front().stack;
+			}
+		}
+	}
+	
+	LOG_DEBUG(imagestackcachelog) << "Reading stack of " << blocks->length() << " blocks at " <<
+		blocks->location() << std::endl;
+	
+	// Read without holding the lock, a concurrent read of the same blocks is only wasted work.
+	boost::shared_ptr<ImageBlockStackReader> reader = boost::make_shared<ImageBlockStackReader>();
+	
+	reader->setInput("factory", factory);
+	reader->setInput("block", blocks);
+	
+	pipeline::Value<ImageStack> stack = reader->getOutput();
+	
+	Entry entry;
+	entry.factory = factory.get();
+	entry.blockIds = blockIds;
+	entry.stack = stack;
+	
+	boost::mutex::scoped_lock lock(_mutex);
+	
+	++_reads;
+	_entries.push_front(entry);
+	
+	while (_entries.size() > _capacity)
+	{
+		_entries.pop_back();
+	}
+	
+	return stack;
+}
+
+void
+ImageStackCache::clear()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	
+	_entries.clear();
+	_reads = 0;
+	_hits = 0;
+}
+
+unsigned int
+ImageStackCache::getReads()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	
+	return _reads;
+}
+
+unsigned int
+ImageStackCache::getHits()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	
+	return _hits;
+}
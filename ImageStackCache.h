@@ -0,0 +1,59 @@
+#ifndef IMAGE_STACK_CACHE_H__
+#define IMAGE_STACK_CACHE_H__
+
+#include <list>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <pipeline/all.h>
+#include <imageprocessing/ImageStack.h>
+#include <imageprocessing/io/ImageBlockFactory.h>
+#include <sopnet/block/Blocks.h>
+
+/**
+ * Keeps the image stacks most recently read for a set of blocks, so that crops requested
+ * again, e.g., by an overlapping window, are not read twice. Stacks are identified by their
+ * factory and the ids of their blocks, and evicted least recently used first. All methods are
+ * thread-safe.
+ */
+class ImageStackCache : public pipeline::Data
+{
+	struct Entry
+	{
+		const ImageBlockFactory* factory;
+		std::vector<unsigned int> blockIds;
+		boost::shared_ptr<ImageStack> stack;
+	};
+
+public:
+	/**
+	 * @param capacity - the maximal number of stacks to keep.
+	 */
+	ImageStackCache(unsigned int capacity = 64);
+
+	/**
+	 * Get the stack of the given blocks, reading it from the factory if it is not cached.
+	 */
+	boost::shared_ptr<ImageStack> getStack(const boost::shared_ptr<ImageBlockFactory>& factory,
+										   const boost::shared_ptr<Blocks>& blocks);
+
+	void clear();
+
+	unsigned int getReads();
+
+	unsigned int getHits();
+
+private:
+
+	unsigned int _capacity;
+
+	// Most recently used first.
+	std::list<Entry> _entries;
+
+	unsigned int _reads;
+	unsigned int _hits;
+
+	boost::mutex _mutex;
+};
+
+#endif //IMAGE_STACK_CACHE_H__
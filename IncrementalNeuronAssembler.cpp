@@ -0,0 +1,409 @@
+#include "IncrementalNeuronAssembler.h"
+
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <util/exceptions.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel incrementalneuronassemblerlog("incrementalneuronassemblerlog",
+												 "[IncrementalNeuronAssembler] ");
+
+IncrementalNeuronAssembler::IncrementalNeuronAssembler() :
+	_nextNeuronId(0)
+{
+}
+
+void
+IncrementalNeuronAssembler::addListener(const listener_type& listener)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	_listeners.push_back(listener);
+}
+
+std::vector<unsigned int>
+IncrementalNeuronAssembler::apply(const std::vector<boost::shared_ptr<Segment> >& added,
+								  const std::vector<boost::shared_ptr<Segment> >& removed)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	// Neurons with ids from here on did not exist before this call.
+	unsigned int firstNewId = _nextNeuronId;
+	std::vector<unsigned int> changed;
+	
+	_touched.clear();
+	
+	foreach (boost::shared_ptr<Segment> segment, removed)
+	{
+		removeSegment(segment->getId());
+	}
+	
+	foreach (boost::shared_ptr<Segment> segment, added)
+	{
+		addSegment(segment);
+	}
+	
+	LOG_DEBUG(incrementalneuronassemblerlog) << "Added " << added.size() << " and removed " <<
+		removed.size() << " segments, " << _touched.size() << " neurons changed" << std::endl;
+	
+	foreach (unsigned int neuronId, _touched)
+	{
+		bool exists = _neuronSegments.count(neuronId);
+		bool existed = neuronId < firstNewId;
+		
+		if (!exists && !existed)
+		{
+			// Created and merged away within this call.
+			continue;
+		}
+		
+		NeuronChange change = (!exists ? NeuronRemoved : (existed ? NeuronModified : NeuronAdded));
+		
+		if (exists)
+		{
+			changed.push_back(neuronId);
+		}
+		
+		foreach (const listener_type& listener, _listeners)
+		{
+			listener(neuronId, change);
+		}
+	}
+	
+	return changed;
+}
+
+std::vector<unsigned int>
+IncrementalNeuronAssembler::update(const Segments& segments, const SegmentAssignment& assignment)
+{
+	std::vector<boost::shared_ptr<Segment> > added;
+	std::vector<boost::shared_ptr<Segment> > removed;
+	
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	foreach (boost::shared_ptr<Segment> segment, segments.getSegments())
+	{
+		if (!assignment.contains(segment->getId()))
+		{
+			continue;
+		}
+		
+		bool chosen = assignment.isChosen(segment->getId());
+		bool present = _segments.count(segment->getId());
+		
+		if (chosen && !present)
+		{
+			added.push_back(segment);
+		}
+		else if (!chosen && present)
+		{
+			removed.push_back(segment);
+		}
+	}
+	
+	if (added.empty() && removed.empty())
+	{
+		return std::vector<unsigned int>();
+	}
+	
+	return apply(added, removed);
+}
+
+bool
+IncrementalNeuronAssembler::contains(unsigned int segmentId)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	return _segments.count(segmentId);
+}
+
+unsigned int
+IncrementalNeuronAssembler::getNeuronId(unsigned int segmentId)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	boost::unordered_map<unsigned int, boost::shared_ptr<Segment> >::const_iterator it =
+		_segments.find(segmentId);
+	
+	if (it == _segments.end())
+	{
+		BOOST_THROW_EXCEPTION(UsageError() << error_message(
+				"segment " + boost::lexical_cast<std::string>(segmentId) +
+				" is not part of any neuron"));
+	}
+	
+	return _rootNeurons[find(sliceIndex(it->second->getSlices()[0]->getId()))];
+}
+
+boost::shared_ptr<SegmentTree>
+IncrementalNeuronAssembler::getNeuron(unsigned int neuronId)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	boost::shared_ptr<SegmentTree> neuron = boost::make_shared<SegmentTree>();
+	Segments segments;
+	
+	boost::unordered_map<unsigned int, IdSet>::const_iterator it = _neuronSegments.find(neuronId);
+	
+	if (it == _neuronSegments.end())
+	{
+		return neuron;
+	}
+	
+	foreach (unsigned int segmentId, it->second)
+	{
+		segments.add(_segments[segmentId]);
+	}
+	
+	foreach (boost::shared_ptr<EndSegment> end, segments.getEnds())
+	{
+		neuron->add(end);
+	}
+	
+	foreach (boost::shared_ptr<ContinuationSegment> continuation, segments.getContinuations())
+	{
+		neuron->add(continuation);
+	}
+	
+	foreach (boost::shared_ptr<BranchSegment> branch, segments.getBranches())
+	{
+		neuron->add(branch);
+	}
+	
+	return neuron;
+}
+
+boost::shared_ptr<SegmentTrees>
+IncrementalNeuronAssembler::getNeurons()
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	boost::shared_ptr<SegmentTrees> neurons = boost::make_shared<SegmentTrees>();
+	
+	for (boost::unordered_map<unsigned int, IdSet>::const_iterator it = _neuronSegments.begin();
+		 it != _neuronSegments.end(); ++it)
+	{
+		neurons->add(getNeuron(it->first));
+	}
+	
+	return neurons;
+}
+
+unsigned int
+IncrementalNeuronAssembler::numNeurons()
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	return _neuronSegments.size();
+}
+
+void
+IncrementalNeuronAssembler::addSegment(const boost::shared_ptr<Segment>& segment)
+{
+	if (_segments.count(segment->getId()))
+	{
+		return;
+	}
+	
+	// The neurons the slices of the segment are part of already.
+	std::vector<unsigned int> neurons;
+	
+	foreach (boost::shared_ptr<Slice> slice, segment->getSlices())
+	{
+		unsigned int root = find(sliceIndex(slice->getId()));
+		
+		if (_rootNeurons[root] >= 0 &&
+			std::find(neurons.begin(), neurons.end(),
+					  static_cast<unsigned int>(_rootNeurons[root])) == neurons.end())
+		{
+			neurons.push_back(_rootNeurons[root]);
+		}
+		
+		_rootNeurons[root] = -1;
+	}
+	
+	unsigned int root = unionSlices(*segment);
+	unsigned int neuronId;
+	
+	if (neurons.empty())
+	{
+		neuronId = _nextNeuronId++;
+	}
+	else
+	{
+		// The largest neuron keeps its id, the others are merged into it.
+		neuronId = neurons[0];
+		
+		foreach (unsigned int other, neurons)
+		{
+			if (_neuronSegments[other].size() > _neuronSegments[neuronId].size())
+			{
+				neuronId = other;
+			}
+		}
+		
+		foreach (unsigned int other, neurons)
+		{
+			if (other != neuronId)
+			{
+				_neuronSegments[neuronId].insert(
+						_neuronSegments[other].begin(), _neuronSegments[other].end());
+				_neuronSegments.erase(other);
+				touch(other);
+			}
+		}
+	}
+	
+	_segments[segment->getId()] = segment;
+	_neuronSegments[neuronId].insert(segment->getId());
+	_rootNeurons[root] = neuronId;
+	
+	touch(neuronId);
+}
+
+void
+IncrementalNeuronAssembler::removeSegment(unsigned int segmentId)
+{
+	if (!_segments.count(segmentId))
+	{
+		return;
+	}
+	
+	unsigned int neuronId = getNeuronId(segmentId);
+	boost::shared_ptr<Segment> removed = _segments[segmentId];
+	IdSet remaining = _neuronSegments[neuronId];
+	
+	remaining.erase(segmentId);
+	_segments.erase(segmentId);
+	_neuronSegments.erase(neuronId);
+	touch(neuronId);
+	
+	// Take the slices of the neuron out of the union-find, they are all in one set.
+	std::vector<boost::shared_ptr<Segment> > segments;
+	
+	segments.push_back(removed);
+	
+	foreach (unsigned int id, remaining)
+	{
+		segments.push_back(_segments[id]);
+	}
+	
+	foreach (boost::shared_ptr<Segment> segment, segments)
+	{
+		foreach (boost::shared_ptr<Slice> slice, segment->getSlices())
+		{
+			unsigned int i = sliceIndex(slice->getId());
+			
+			_parents[i] = i;
+			_sizes[i] = 1;
+			_rootNeurons[i] = -1;
+		}
+	}
+	
+	// Rebuild the neuron from the remaining segments, it might have fallen apart.
+	boost::unordered_map<unsigned int, IdSet> parts;
+	boost::unordered_map<unsigned int, IdSet>::const_iterator largest;
+	
+	foreach (unsigned int id, remaining)
+	{
+		unionSlices(*_segments[id]);
+	}
+	
+	foreach (unsigned int id, remaining)
+	{
+		parts[find(sliceIndex(_segments[id]->getSlices()[0]->getId()))].insert(id);
+	}
+	
+	largest = parts.begin();
+	
+	for (boost::unordered_map<unsigned int, IdSet>::const_iterator it = parts.begin();
+		 it != parts.end(); ++it)
+	{
+		if (it->second.size() > largest->second.size())
+		{
+			largest = it;
+		}
+	}
+	
+	for (boost::unordered_map<unsigned int, IdSet>::const_iterator it = parts.begin();
+		 it != parts.end(); ++it)
+	{
+		// The largest part keeps the id of the neuron.
+		unsigned int partId = (it == largest ? neuronId : _nextNeuronId++);
+		
+		_neuronSegments[partId] = it->second;
+		_rootNeurons[it->first] = partId;
+		
+		touch(partId);
+	}
+}
+
+unsigned int
+IncrementalNeuronAssembler::unionSlices(const Segment& segment)
+{
+	unsigned int root = find(sliceIndex(segment.getSlices()[0]->getId()));
+	
+	foreach (boost::shared_ptr<Slice> slice, segment.getSlices())
+	{
+		root = merge(root, sliceIndex(slice->getId()));
+	}
+	
+	return root;
+}
+
+unsigned int
+IncrementalNeuronAssembler::sliceIndex(unsigned int sliceId)
+{
+	unsigned int index = _sliceIndices.insert(sliceId);
+	
+	if (index == _parents.size())
+	{
+		_parents.push_back(index);
+		_sizes.push_back(1);
+		_rootNeurons.push_back(-1);
+	}
+	
+	return index;
+}
+
+unsigned int
+IncrementalNeuronAssembler::find(unsigned int i)
+{
+	while (_parents[i] != i)
+	{
+		_parents[i] = _parents[_parents[i]];
+		i = _parents[i];
+	}
+	
+	return i;
+}
+
+unsigned int
+IncrementalNeuronAssembler::merge(unsigned int i, unsigned int j)
+{
+	i = find(i);
+	j = find(j);
+	
+	if (i == j)
+	{
+		return i;
+	}
+	
+	if (_sizes[i] < _sizes[j])
+	{
+		std::swap(i, j);
+	}
+	
+	_parents[j] = i;
+	_sizes[i] += _sizes[j];
+	
+	return i;
+}
+
+void
+IncrementalNeuronAssembler::touch(unsigned int neuronId)
+{
+	_touched.insert(neuronId);
+}
@@ -0,0 +1,119 @@
+#ifndef INCREMENTAL_NEURON_ASSEMBLER_H__
+#define INCREMENTAL_NEURON_ASSEMBLER_H__
+
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <pipeline/all.h>
+#include <sopnet/segments/Segments.h>
+#include <sopnet/segments/SegmentTree.h>
+#include <sopnet/segments/SegmentTrees.h>
+#include <catmaidsopnet/DenseIdMap.h>
+#include <catmaidsopnet/SegmentAssignment.h>
+
+/**
+ * Keeps the neurons formed by a changing set of chosen segments, ie, the sets of segments
+ * connected through shared slices, across solves.
+ *
+ * Added segments are merged into the neurons of their slices with a union-find over slices.
+ * Removing a segment rebuilds only the neuron it was part of, which may fall apart into
+ * several. Neurons keep their id as long as they exist; when neurons merge, the one with the
+ * most segments keeps its id. After every change, listeners are told which neurons were
+ * added, modified or removed. All methods are thread-safe.
+ */
+class IncrementalNeuronAssembler : public pipeline::Data
+{
+public:
+
+	enum NeuronChange
+	{
+		NeuronAdded,
+		NeuronModified,
+		NeuronRemoved
+	};
+
+	typedef boost::function<void(unsigned int neuronId, NeuronChange change)> listener_type;
+
+	IncrementalNeuronAssembler();
+
+	void addListener(const listener_type& listener);
+
+	/**
+	 * Add and remove chosen segments, then notify the listeners once per changed neuron.
+	 * Returns the ids of the neurons that were added or modified.
+	 */
+	std::vector<unsigned int> apply(const std::vector<boost::shared_ptr<Segment> >& added,
+			   const std::vector<boost::shared_ptr<Segment> >& removed);
+
+	/**
+	 * Bring the decisions for the given segments up to date with the assignment, e.g., after a
+	 * window containing them was solved. Segments not in the assignment are left as they are.
+	 * Returns the ids of the neurons that were added or modified.
+	 */
+	std::vector<unsigned int> update(const Segments& segments, const SegmentAssignment& assignment);
+
+	bool contains(unsigned int segmentId);
+
+	/**
+	 * The id of the neuron the chosen segment is part of. Throws a UsageError for segments
+	 * that are not chosen, see contains().
+	 */
+	unsigned int getNeuronId(unsigned int segmentId);
+
+	/**
+	 * The segments of the given neuron. The tree is built on every call, in time proportional
+	 * to the size of the neuron.
+	 */
+	boost::shared_ptr<SegmentTree> getNeuron(unsigned int neuronId);
+
+	boost::shared_ptr<SegmentTrees> getNeurons();
+
+	unsigned int numNeurons();
+
+private:
+
+	typedef boost::unordered_set<unsigned int> IdSet;
+
+	void addSegment(const boost::shared_ptr<Segment>& segment);
+
+	void removeSegment(unsigned int segmentId);
+
+	/**
+	 * Union the slices of the segment, and return the root of its slices.
+	 */
+	unsigned int unionSlices(const Segment& segment);
+
+	unsigned int sliceIndex(unsigned int sliceId);
+
+	unsigned int find(unsigned int i);
+
+	unsigned int merge(unsigned int i, unsigned int j);
+
+	void touch(unsigned int neuronId);
+
+	// The chosen segments, by id
+	boost::unordered_map<unsigned int, boost::shared_ptr<Segment> > _segments;
+
+	// The segments of every neuron
+	boost::unordered_map<unsigned int, IdSet> _neuronSegments;
+
+	// Union-find over the dense indices of slices, and the neuron of every root, -1 for none
+	DenseIdMap _sliceIndices;
+	std::vector<unsigned int> _parents;
+	std::vector<unsigned int> _sizes;
+	std::vector<int> _rootNeurons;
+
+	unsigned int _nextNeuronId;
+
+	// The neurons changed by the current call of apply()
+	IdSet _touched;
+
+	std::vector<listener_type> _listeners;
+
+	boost::recursive_mutex _mutex;
+};
+
+#endif //INCREMENTAL_NEURON_ASSEMBLER_H__
@@ -0,0 +1,24 @@
+#include "NeuronStream.h"
+
+NeuronStream::NeuronStream(const callback_type& callback) :
+	_callback(callback),
+	_emitted(0)
+{
+}
+
+void
+NeuronStream::emit(const boost::shared_ptr<SegmentTrees>& neurons)
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	
+	++_emitted;
+	_callback(neurons);
+}
+
+unsigned int
+NeuronStream::getEmitted()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	
+	return _emitted;
+}
@@ -0,0 +1,40 @@
+#ifndef NEURON_STREAM_H__
+#define NEURON_STREAM_H__
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <pipeline/all.h>
+#include <sopnet/segments/SegmentTrees.h>
+
+/**
+ * Receives the neurons of a CoreSolver part by part, as independent parts of the problem are
+ * solved. The callback is never called concurrently.
+ */
+class NeuronStream : public pipeline::Data
+{
+public:
+	typedef boost::function<void(const boost::shared_ptr<SegmentTrees>&)> callback_type;
+
+	NeuronStream(const callback_type& callback);
+
+	/**
+	 * Pass the given neurons on to the callback.
+	 */
+	void emit(const boost::shared_ptr<SegmentTrees>& neurons);
+
+	/**
+	 * The number of parts passed on so far.
+	 */
+	unsigned int getEmitted();
+
+private:
+
+	callback_type _callback;
+
+	unsigned int _emitted;
+
+	boost::mutex _mutex;
+};
+
+#endif //NEURON_STREAM_H__
@@ -0,0 +1,134 @@
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/exception_ptr.hpp>
+#include <util/ProgramOptions.h>
+
+util::ProgramOption optionNumThreads(
+		util::_module           = "catmaidsopnet",
+		util::_long_name        = "numThreads",
+		util::_description_text = "The number of worker threads to use. 0 uses one thread per core.",
+		util::_default_value    = 0);
+
+// The threads available to a worker thread of a parallelFor, unset outside of one.
+static boost::thread_specific_ptr<unsigned int> threadBudget;
+
+/**
+ * Shared state of the worker threads of one parallelFor call.
+ */
+struct ParallelForState
+{
+	ParallelForState(unsigned int n_, const boost::function<void(unsigned int)>& fn_,
+					 unsigned int budget_) :
+		n(n_), next(0), budget(budget_), fn(fn_) {}
+	
+	unsigned int n;
+	unsigned int next;
+	// The threads available to nested calls in each worker.
+	unsigned int budget;
+	const boost::function<void(unsigned int)>& fn;
+	boost::mutex mutex;
+	boost::exception_ptr exception;
+};
+
+static void
+parallelForWorker(ParallelForState& state)
+{
+	threadBudget.reset(new unsigned int(state.budget));
+	
+	while (true)
+	{
+		unsigned int i;
+		
+		{
+			boost::mutex::scoped_lock lock(state.mutex);
+			
+			if (state.next >= state.n || state.exception)
+			{
+				return;
+			}
+			
+			i = state.next++;
+		}
+		
+		try
+		{
+			state.fn(i);
+		}
+		catch (...)
+		{
+			boost::mutex::scoped_lock lock(state.mutex);
+			
+			if (!state.exception)
+			{
+				state.exception = boost::current_exception();
+			}
+		}
+	}
+}
+
+unsigned int
+defaultNumThreads()
+{
+	int numThreads = optionNumThreads.as<int>();
+	
+	if (numThreads > 0)
+	{
+		return numThreads;
+	}
+	
+	return std::max(1u, boost::thread::hardware_concurrency());
+}
+
+unsigned int
+availableThreads()
+{
+	if (threadBudget.get())
+	{
+		return *threadBudget;
+	}
+	
+	return defaultNumThreads();
+}
+
+void
+parallelFor(unsigned int n, const boost::function<void(unsigned int)>& fn,
+			unsigned int numThreads)
+{
+	boost::thread_group threads;
+	unsigned int available = availableThreads();
+	
+	if (numThreads == 0 || numThreads > available)
+	{
+		numThreads = available;
+	}
+	
+	numThreads = std::min(numThreads, n);
+	
+	if (numThreads <= 1)
+	{
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			fn(i);
+		}
+		
+		return;
+	}
+	
+	ParallelForState state(n, fn, std::max(1u, available/numThreads));
+	
+	for (unsigned int t = 0; t < numThreads; ++t)
+	{
+		threads.create_thread(boost::bind(&parallelForWorker, boost::ref(state)));
+	}
+	
+	threads.join_all();
+	
+	if (state.exception)
+	{
+		boost::rethrow_exception(state.exception);
+	}
+}
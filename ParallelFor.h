@@ -0,0 +1,37 @@
+#ifndef PARALLEL_FOR_H__
+#define PARALLEL_FOR_H__
+
+#include <boost/function.hpp>
+
+/**
+ * Call fn(i) for every i in [0, n), spreading the calls over worker threads. Calls are handed
+ * out in increasing order of i, but may complete in any order, so fn should only write to
+ * state owned by its index. If a call throws, the remaining indices are skipped and the first
+ * exception is rethrown in the calling thread.
+ *
+ * Calls may be nested, e.g., fn may itself call parallelFor. The threads of a call share the
+ * number of threads available to the caller, so that nesting does not multiply the number of
+ * threads: a nested call uses at most the available threads divided by the number of threads
+ * of the enclosing call, and runs serially if that is one.
+ * 
+ * @param n - the number of indices.
+ * @param fn - the function to call.
+ * @param numThreads - the maximal number of threads to use, 0 to use all threads available
+ *                     to the calling thread.
+ */
+void parallelFor(unsigned int n, const boost::function<void(unsigned int)>& fn,
+				 unsigned int numThreads = 0);
+
+/**
+ * The number of worker threads to use by default, one per core unless the
+ * catmaidsopnet.numThreads program option says otherwise.
+ */
+unsigned int defaultNumThreads();
+
+/**
+ * The number of threads the calling thread may use: defaultNumThreads() outside of a
+ * parallelFor, its share of the enclosing call's threads inside.
+ */
+unsigned int availableThreads();
+
+#endif //PARALLEL_FOR_H__
@@ -0,0 +1,90 @@
+#include "ProblemMatrixAssembler.h"
+
+#include <boost/lexical_cast.hpp>
+#include <util/exceptions.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel problemmatrixassemblerlog("problemmatrixassemblerlog",
+											 "[ProblemMatrixAssembler] ");
+
+ProblemMatrixAssembler::ProblemMatrixAssembler()
+{
+	registerInput(_segments, "segments");
+	registerInputs(_constraints, "linear constraints");
+	
+	registerOutput(_allSegments, "segments");
+	registerOutput(_allConstraints, "linear constraints");
+	registerOutput(_configuration, "problem configuration");
+}
+
+void
+ProblemMatrixAssembler::updateOutputs()
+{
+	ProblemConfiguration configuration;
+	SparseConstraintMatrix allConstraints;
+	DenseIdMap variables;
+	unsigned int numRows = 0;
+	unsigned int numNonZeros = 0;
+	
+	foreach (boost::shared_ptr<Segment> segment, _segments->getSegments())
+	{
+		unsigned int variable = variables.insert(segment->getId());
+		
+		configuration.setVariable(segment->getId(), variable);
+	}
+	
+	foreach (boost::shared_ptr<SparseConstraintMatrix> constraints, _constraints)
+	{
+		numRows += constraints->numRows();
+		numNonZeros += constraints->numNonZeros();
+	}
+	
+	allConstraints.reserve(numRows, numNonZeros);
+	
+	foreach (boost::shared_ptr<SparseConstraintMatrix> constraints, _constraints)
+	{
+		mapConstraints(*constraints, variables, allConstraints);
+	}
+	
+	LOG_DEBUG(problemmatrixassemblerlog) << "Assembled " << allConstraints.numRows() <<
+		" constraints on " << variables.size() << " segments" << std::endl;
+	
+	*_allSegments = *_segments;
+	*_allConstraints = allConstraints;
+	*_configuration = configuration;
+}
+
+void
+ProblemMatrixAssembler::mapConstraints(const SparseConstraintMatrix& constraints,
+									   const DenseIdMap& variables,
+									   SparseConstraintMatrix& mapped)
+{
+	for (unsigned int row = 0; row < constraints.numRows(); ++row)
+	{
+		SparseConstraintMatrix::coefficient_iterator coefficient =
+			constraints.coefficientsBegin(row);
+		
+		_columns.clear();
+		_coefficients.clear();
+		
+		for (SparseConstraintMatrix::column_iterator column = constraints.columnsBegin(row);
+			 column != constraints.columnsEnd(row); ++column, ++coefficient)
+		{
+			unsigned int variable;
+			
+			if (!variables.find(*column, variable))
+			{
+				BOOST_THROW_EXCEPTION(UsageError() << error_message(
+						"constraint on segment " + boost::lexical_cast<std::string>(*column) +
+						", which is not part of the problem"));
+			}
+			
+			_columns.push_back(variable);
+			_coefficients.push_back(*coefficient);
+		}
+		
+		mapped.addRow(_columns, _coefficients, constraints.getRelation(row),
+					  constraints.getValue(row));
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef PROBLEM_MATRIX_ASSEMBLER_H__
+#define PROBLEM_MATRIX_ASSEMBLER_H__
+
+#include <vector>
+#include <pipeline/all.h>
+#include <sopnet/inference/ProblemConfiguration.h>
+#include <sopnet/segments/Segments.h>
+#include <catmaidsopnet/DenseIdMap.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
+
+/**
+ * Assembles the segments and the constraints on them into one problem, like the
+ * ProblemAssembler of sopnet, but keeps the constraints as a SparseConstraintMatrix.
+ *
+ * Variable i is the i-th segment of the "segments" output. The "linear constraints" inputs are
+ * over segment ids, their columns are mapped to variables row by row, and the variable of
+ * every segment is recorded in the "problem configuration". A constraint on a segment that is
+ * not part of the problem is a UsageError.
+ */
+class ProblemMatrixAssembler : public pipeline::SimpleProcessNode<>
+{
+public:
+	ProblemMatrixAssembler();
+
+private:
+	void updateOutputs();
+
+	void mapConstraints(const SparseConstraintMatrix& constraints,
+						const DenseIdMap& variables,
+						SparseConstraintMatrix& mapped);
+
+	pipeline::Input<Segments> _segments;
+	pipeline::Inputs<SparseConstraintMatrix> _constraints;
+
+	pipeline::Output<Segments> _allSegments;
+	pipeline::Output<SparseConstraintMatrix> _allConstraints;
+	pipeline::Output<ProblemConfiguration> _configuration;
+
+	// Reused between rows
+	std::vector<unsigned int> _columns;
+	std::vector<double> _coefficients;
+};
+
+#endif //PROBLEM_MATRIX_ASSEMBLER_H__
@@ -0,0 +1,179 @@
+#include "ProblemReader.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <boost/make_shared.hpp>
+#include <inference/Relation.h>
+#include <util/exceptions.h>
+#include <util/foreach.h>
+
+/**
+ * Parse terms like "+ 2 x0 - 1 x3" from the stream, up to a relation or the end of the line.
+ * The relation is returned in relation, if any.
+ */
+static void
+readTerms(std::istream& in,
+		  std::map<unsigned int, double>& coefficients,
+		  std::string& relation)
+{
+	std::string token;
+	double sign = 1;
+	double value = 1;
+	
+	while (in >> token)
+	{
+		if (token == "+")
+		{
+			sign = 1;
+		}
+		else if (token == "-")
+		{
+			sign = -1;
+		}
+		else if (token == "<=" || token == ">=" || token == "=")
+		{
+			relation = token;
+			return;
+		}
+		else if (token[0] == 'x')
+		{
+			coefficients[std::atoi(token.c_str() + 1)] += sign*value;
+			sign = 1;
+			value = 1;
+		}
+		else
+		{
+			value = std::atof(token.c_str());
+		}
+	}
+}
+
+/**
+ * Parse one objective or constraint of the given section, with its label and all its lines.
+ */
+static void
+readStatement(const std::string& section,
+			  const std::string& statement,
+			  const std::string& filename,
+			  std::map<unsigned int, double>& objectiveTerms,
+			  LinearConstraints& constraints)
+{
+	typedef std::map<unsigned int, double>::value_type pair_t;
+	
+	std::istringstream in(statement);
+	std::string label;
+	std::string relation;
+	
+	if (section == "Minimize")
+	{
+		in >> label;
+		readTerms(in, objectiveTerms, relation);
+	}
+	else if (section == "Subject To")
+	{
+		std::map<unsigned int, double> coefficients;
+		LinearConstraint constraint;
+		double value = 0;
+		
+		in >> label;
+		readTerms(in, coefficients, relation);
+		in >> value;
+		
+		foreach (const pair_t& pair, coefficients)
+		{
+			constraint.setCoefficient(pair.first, pair.second);
+		}
+		
+		if (relation == "<=")
+		{
+			constraint.setRelation(LessEqual);
+		}
+		else if (relation == ">=")
+		{
+			constraint.setRelation(GreaterEqual);
+		}
+		else if (relation == "=")
+		{
+			constraint.setRelation(Equal);
+		}
+		else
+		{
+			BOOST_THROW_EXCEPTION(IOError() << error_message(
+					"constraint without relation in " + filename + ": " + statement));
+		}
+		
+		constraint.setValue(value);
+		constraints.add(constraint);
+	}
+}
+
+void
+ProblemReader::readLp(const std::string& filename,
+					  boost::shared_ptr<LinearObjective>& objective,
+					  boost::shared_ptr<LinearConstraints>& constraints)
+{
+	typedef std::map<unsigned int, double>::value_type pair_t;
+	
+	std::ifstream in(filename.c_str());
+	std::string line;
+	std::string section;
+	// The objective or constraint read so far, it ends where the next label or section starts.
+	std::string statement;
+	std::map<unsigned int, double> objectiveTerms;
+	unsigned int numVariables = 0;
+	
+	if (!in)
+	{
+		BOOST_THROW_EXCEPTION(IOError() << error_message("can not open " + filename));
+	}
+	
+	constraints = boost::make_shared<LinearConstraints>();
+	
+	while (std::getline(in, line))
+	{
+		if (line.empty() || line[0] == '\\')
+		{
+			continue;
+		}
+		
+		std::string first;
+		std::istringstream(line) >> first;
+		
+		// A section, or a label starts a new statement, other lines continue the last one.
+		if (line[0] != ' ' || (!first.empty() && first[first.size() - 1] == ':'))
+		{
+			if (!statement.empty())
+			{
+				readStatement(section, statement, filename, objectiveTerms, *constraints);
+				statement.clear();
+			}
+		}
+		
+		if (line[0] != ' ')
+		{
+			section = line;
+		}
+		else if (section == "Binary")
+		{
+			++numVariables;
+		}
+		else
+		{
+			statement += line;
+		}
+	}
+	
+	if (!statement.empty())
+	{
+		readStatement(section, statement, filename, objectiveTerms, *constraints);
+	}
+	
+	objective = boost::make_shared<LinearObjective>(numVariables);
+	
+	foreach (const pair_t& pair, objectiveTerms)
+	{
+		objective->setCoefficient(pair.first, pair.second);
+	}
+}
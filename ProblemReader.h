@@ -0,0 +1,22 @@
+#ifndef PROBLEM_READER_H__
+#define PROBLEM_READER_H__
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <sopnet/inference/LinearConstraints.h>
+#include <sopnet/inference/LinearObjective.h>
+
+/**
+ * Reads problems written by ProblemWriter::writeLp. Only the subset of the LP format written
+ * there is understood: an objective and constraints that start with a label and may continue
+ * on the following lines, and binary variables named xi.
+ */
+class ProblemReader
+{
+public:
+	static void readLp(const std::string& filename,
+					   boost::shared_ptr<LinearObjective>& objective,
+					   boost::shared_ptr<LinearConstraints>& constraints);
+};
+
+#endif //PROBLEM_READER_H__
@@ -0,0 +1,211 @@
+#include "ProblemWriter.h"
+
+#include <fstream>
+#include <limits>
+#include <vector>
+#include <inference/Relation.h>
+#include <util/exceptions.h>
+#include <util/foreach.h>
+
+static void
+openFile(std::ofstream& out, const std::string& filename)
+{
+	out.open(filename.c_str());
+	
+	if (!out)
+	{
+		BOOST_THROW_EXCEPTION(IOError() << error_message("can not open " + filename));
+	}
+	
+	out.precision(std::numeric_limits<double>::digits10 + 2);
+}
+
+// Terms per line of an LP file. Readers limit the length of a line, CPLEX to 510 characters,
+// a term takes at most about 40.
+static const unsigned int TermsPerLine = 8;
+
+/**
+ * Write a sum of terms, e.g. "+ 2 x0 - 1 x3". Long sums are continued on the next lines.
+ */
+static void
+writeTerms(std::ostream& out, const std::map<unsigned int, double>& coefficients)
+{
+	typedef std::map<unsigned int, double>::value_type pair_t;
+	
+	unsigned int numTerms = 0;
+	
+	foreach (const pair_t& pair, coefficients)
+	{
+		if (numTerms > 0 && numTerms % TermsPerLine == 0)
+		{
+			out << std::endl << "   ";
+		}
+		
+		++numTerms;
+		
+		if (pair.second < 0)
+		{
+			out << " - " << -pair.second << " x" << pair.first;
+		}
+		else
+		{
+			out << " + " << pair.second << " x" << pair.first;
+		}
+	}
+}
+
+static const char*
+lpRelation(Relation relation)
+{
+	switch (relation)
+	{
+		case LessEqual:
+			return "<=";
+		case GreaterEqual:
+			return ">=";
+		default:
+			return "=";
+	}
+}
+
+static const char*
+mpsRowType(Relation relation)
+{
+	switch (relation)
+	{
+		case LessEqual:
+			return "L";
+		case GreaterEqual:
+			return "G";
+		default:
+			return "E";
+	}
+}
+
+void
+ProblemWriter::writeLp(const LinearObjective& objective,
+					   const LinearConstraints& constraints,
+					   const std::string& filename)
+{
+	std::ofstream out;
+	std::map<unsigned int, double> objectiveTerms;
+	unsigned int j = 0;
+	
+	openFile(out, filename);
+	
+	for (unsigned int i = 0; i < objective.size(); ++i)
+	{
+		objectiveTerms[i] = objective.getCoefficients()[i];
+	}
+	
+	out << "\\ " << objective.size() << " variables, " << constraints.size() << " constraints" <<
+		std::endl;
+	out << "Minimize" << std::endl;
+	out << " obj:";
+	writeTerms(out, objectiveTerms);
+	out << std::endl;
+	
+	out << "Subject To" << std::endl;
+	
+	foreach (const LinearConstraint& constraint, constraints)
+	{
+		out << " c" << j++ << ":";
+		writeTerms(out, constraint.getCoefficients());
+		out << " " << lpRelation(constraint.getRelation()) << " " << constraint.getValue() <<
+			std::endl;
+	}
+	
+	out << "Binary" << std::endl;
+	
+	for (unsigned int i = 0; i < objective.size(); ++i)
+	{
+		out << " x" << i << std::endl;
+	}
+	
+	out << "End" << std::endl;
+}
+
+void
+ProblemWriter::writeMps(const LinearObjective& objective,
+						const LinearConstraints& constraints,
+						const std::string& filename)
+{
+	typedef std::map<unsigned int, double>::value_type pair_t;
+	
+	std::ofstream out;
+	// The rows of each variable, MPS is column major.
+	std::vector<std::vector<std::pair<unsigned int, double> > > columns(objective.size());
+	unsigned int j = 0;
+	
+	openFile(out, filename);
+	
+	out << "NAME problem" << std::endl;
+	out << "ROWS" << std::endl;
+	out << " N obj" << std::endl;
+	
+	foreach (const LinearConstraint& constraint, constraints)
+	{
+		out << " " << mpsRowType(constraint.getRelation()) << " c" << j << std::endl;
+		
+		foreach (const pair_t& pair, constraint.getCoefficients())
+		{
+			columns[pair.first].push_back(std::make_pair(j, pair.second));
+		}
+		
+		++j;
+	}
+	
+	out << "COLUMNS" << std::endl;
+	out << " MARKER 'MARKER' 'INTORG'" << std::endl;
+	
+	for (unsigned int i = 0; i < objective.size(); ++i)
+	{
+		out << " x" << i << " obj " << objective.getCoefficients()[i] << std::endl;
+		
+		for (unsigned int k = 0; k < columns[i].size(); ++k)
+		{
+			out << " x" << i << " c" << columns[i][k].first << " " << columns[i][k].second <<
+				std::endl;
+		}
+	}
+	
+	out << " MARKER 'MARKER' 'INTEND'" << std::endl;
+	out << "RHS" << std::endl;
+	
+	j = 0;
+	
+	foreach (const LinearConstraint& constraint, constraints)
+	{
+		if (constraint.getValue() != 0)
+		{
+			out << " rhs c" << j << " " << constraint.getValue() << std::endl;
+		}
+		
+		++j;
+	}
+	
+	out << "BOUNDS" << std::endl;
+	
+	for (unsigned int i = 0; i < objective.size(); ++i)
+	{
+		out << " BV bnd x" << i << std::endl;
+	}
+	
+	out << "ENDATA" << std::endl;
+}
+
+void
+ProblemWriter::writeSegmentIds(ProblemConfiguration& configuration,
+							   unsigned int numVariables,
+							   const std::string& filename)
+{
+	std::ofstream out;
+	
+	openFile(out, filename);
+	
+	for (unsigned int i = 0; i < numVariables; ++i)
+	{
+		out << i << " " << configuration.getSegmentId(i) <<
+			std::endl;
+	}
+}
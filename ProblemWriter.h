@@ -0,0 +1,40 @@
+#ifndef PROBLEM_WRITER_H__
+#define PROBLEM_WRITER_H__
+
+#include <string>
+#include <sopnet/inference/LinearConstraints.h>
+#include <sopnet/inference/LinearObjective.h>
+#include <sopnet/inference/ProblemConfiguration.h>
+
+/**
+ * Writes binary problems in the LP and MPS formats understood by most MIP solvers, and the
+ * segment ids of their variables, so that problems can be inspected and solved offline.
+ * Variable i is called xi, constraint j is called cj.
+ */
+class ProblemWriter
+{
+public:
+	/**
+	 * Write the problem to filename in CPLEX LP format. Long objectives and constraints are
+	 * wrapped over several lines.
+	 */
+	static void writeLp(const LinearObjective& objective,
+						const LinearConstraints& constraints,
+						const std::string& filename);
+
+	/**
+	 * Write the problem to filename in free MPS format.
+	 */
+	static void writeMps(const LinearObjective& objective,
+						 const LinearConstraints& constraints,
+						 const std::string& filename);
+
+	/**
+	 * Write one line "variable segment id" for each of the numVariables variables.
+	 */
+	static void writeSegmentIds(ProblemConfiguration& configuration,
+								unsigned int numVariables,
+								const std::string& filename);
+};
+
+#endif //PROBLEM_WRITER_H__
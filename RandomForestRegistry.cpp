@@ -0,0 +1,67 @@
+#include "RandomForestRegistry.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
+#include <pipeline/Value.h>
+#include <sopnet/inference/io/RandomForestHdf5Reader.h>
+#include <util/Logger.h>
+
+logger::LogChannel randomforestregistrylog("randomforestregistrylog", "[RandomForestRegistry] ");
+
+RandomForestRegistry::EntryMap RandomForestRegistry::_entries;
+boost::mutex RandomForestRegistry::_mutex;
+
+boost::shared_ptr<RandomForest>
+RandomForestRegistry::getForest(const std::string& filename)
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	
+	return getEntry(filename).forest;
+}
+
+std::size_t
+RandomForestRegistry::getHash(const std::string& filename)
+{
+	boost::mutex::scoped_lock lock(_mutex);
+	
+	return getEntry(filename).hash;
+}
+
+RandomForestRegistry::Entry&
+RandomForestRegistry::getEntry(const std::string& filename)
+{
+	std::size_t hash = hashFile(filename);
+	EntryMap::iterator it = _entries.find(filename);
+	
+	if (it != _entries.end() && it->second.hash == hash)
+	{
+		return it->second;
+	}
+	
+	LOG_DEBUG(randomforestregistrylog) << "Reading random forest from " << filename << std::endl;
+	
+	boost::shared_ptr<RandomForestHdf5Reader> reader =
+		boost::make_shared<RandomForestHdf5Reader>(filename);
+	pipeline::Value<RandomForest> forest = reader->getOutput("random forest");
+	Entry& entry = _entries[filename];
+	
+	entry.forest = forest;
+	entry.hash = hash;
+	
+	return entry;
+}
+
+std::size_t
+RandomForestRegistry::hashFile(const std::string& filename)
+{
+	std::size_t seed = boost::hash_value(filename);
+	
+	if (boost::filesystem::exists(filename))
+	{
+		boost::hash_combine(seed, boost::filesystem::file_size(filename));
+		boost::hash_combine(seed, boost::filesystem::last_write_time(filename));
+	}
+	
+	return seed;
+}
@@ -0,0 +1,46 @@
+#ifndef RANDOM_FOREST_REGISTRY_H__
+#define RANDOM_FOREST_REGISTRY_H__
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <sopnet/inference/RandomForest.h>
+
+/**
+ * Process-wide cache of random forests read from HDF5 files, so that every CoreSolver shares
+ * one forest per file instead of reading its own.
+ */
+class RandomForestRegistry
+{
+	struct Entry
+	{
+		boost::shared_ptr<RandomForest> forest;
+		std::size_t hash;
+	};
+
+	typedef boost::unordered_map<std::string, Entry> EntryMap;
+
+public:
+	/**
+	 * Return the forest stored in the given file, reading it on first use.
+	 */
+	static boost::shared_ptr<RandomForest> getForest(const std::string& filename);
+
+	/**
+	 * A hash identifying the version of the forest in the given file, changes when the file is
+	 * modified.
+	 */
+	static std::size_t getHash(const std::string& filename);
+
+private:
+
+	static Entry& getEntry(const std::string& filename);
+
+	static std::size_t hashFile(const std::string& filename);
+
+	static EntryMap _entries;
+	static boost::mutex _mutex;
+};
+
+#endif //RANDOM_FOREST_REGISTRY_H__
@@ -0,0 +1,41 @@
+#include "SegmentAssignment.h"
+
+#include <boost/make_shared.hpp>
+#include <util/foreach.h>
+
+bool
+SegmentAssignment::isChosen(unsigned int segmentId) const
+{
+	const_iterator it = _assignment.find(segmentId);
+	
+	return it != _assignment.end() && it->second;
+}
+
+void
+SegmentAssignment::merge(const SegmentAssignment& other)
+{
+	for (const_iterator it = other.begin(); it != other.end(); ++it)
+	{
+		_assignment.insert(*it);
+	}
+}
+
+boost::shared_ptr<SparseConstraintMatrix>
+SegmentAssignment::fixingConstraints(const Segments& segments) const
+{
+	boost::shared_ptr<SparseConstraintMatrix> constraints =
+		boost::make_shared<SparseConstraintMatrix>();
+	
+	foreach (boost::shared_ptr<Segment> segment, segments.getSegments())
+	{
+		unsigned int segmentId = segment->getId();
+		const_iterator it = _assignment.find(segmentId);
+		
+		if (it != _assignment.end())
+		{
+			constraints->addUnitRow(&segmentId, &segmentId + 1, Equal, it->second ? 1 : 0);
+		}
+	}
+	
+	return constraints;
+}
@@ -0,0 +1,51 @@
+#ifndef SEGMENT_ASSIGNMENT_H__
+#define SEGMENT_ASSIGNMENT_H__
+
+#include <boost/unordered_map.hpp>
+#include <pipeline/all.h>
+#include <sopnet/segments/Segments.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
+
+/**
+ * A decision for a set of segments, by segment id: true if the segment is part of the
+ * solution, false if it is not.
+ */
+class SegmentAssignment : public pipeline::Data
+{
+	typedef boost::unordered_map<unsigned int, bool> AssignmentMap;
+
+public:
+	typedef AssignmentMap::const_iterator const_iterator;
+
+	void set(unsigned int segmentId, bool chosen) { _assignment[segmentId] = chosen; }
+
+	bool contains(unsigned int segmentId) const { return _assignment.count(segmentId); }
+
+	bool isChosen(unsigned int segmentId) const;
+
+	/**
+	 * Add the decisions of the other assignment for segments that are not yet decided here.
+	 */
+	void merge(const SegmentAssignment& other);
+
+	/**
+	 * Create one equality constraint per decided segment among the given segments, fixing it
+	 * to its decision. The constraints are over segment ids, as expected by the
+	 * ProblemMatrixAssembler.
+	 */
+	boost::shared_ptr<SparseConstraintMatrix> fixingConstraints(const Segments& segments) const;
+
+	unsigned int size() const { return _assignment.size(); }
+
+	void clear() { _assignment.clear(); }
+
+	const_iterator begin() const { return _assignment.begin(); }
+
+	const_iterator end() const { return _assignment.end(); }
+
+private:
+
+	AssignmentMap _assignment;
+};
+
+#endif //SEGMENT_ASSIGNMENT_H__
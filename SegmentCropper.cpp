@@ -0,0 +1,83 @@
+#include "SegmentCropper.h"
+
+#include <map>
+#include <boost/make_shared.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+#include <sopnet/block/Box.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel segmentcropperlog("segmentcropperlog", "[SegmentCropper] ");
+
+SegmentCropper::SegmentCropper(const boost::shared_ptr<BlockManager>& blockManager) :
+	_blockManager(blockManager)
+{
+}
+
+std::vector<SegmentCropper::Crop>
+SegmentCropper::crop(const Segments& segments)
+{
+	typedef boost::tuple<unsigned int, unsigned int, unsigned int> GridPosition;
+	
+	std::map<GridPosition, boost::shared_ptr<Segments> > groups;
+	std::vector<Crop> crops;
+	util::point3<unsigned int> blockSize = _blockManager->blockSize();
+	
+	foreach (boost::shared_ptr<Segment> segment, segments.getSegments())
+	{
+		boost::shared_ptr<Slice> slice = segment->getSlices()[0];
+		util::point<double> center = slice->getComponent()->getCenter();
+		GridPosition position(static_cast<unsigned int>(center.x) / blockSize.x,
+							  static_cast<unsigned int>(center.y) / blockSize.y,
+							  slice->getSection() / blockSize.z);
+		boost::shared_ptr<Segments>& group = groups[position];
+		
+		if (!group)
+		{
+			group = boost::make_shared<Segments>();
+		}
+		
+		group->add(segment);
+	}
+	
+	for (std::map<GridPosition, boost::shared_ptr<Segments> >::const_iterator it = groups.begin();
+		 it != groups.end(); ++it)
+	{
+		Crop crop;
+		
+		crop.segments = it->second;
+		crop.blocks = cropBlocks(*it->second);
+		
+		crops.push_back(crop);
+	}
+	
+	LOG_DEBUG(segmentcropperlog) << "Split " << segments.size() << " segments into " <<
+		crops.size() << " crops" << std::endl;
+	
+	return crops;
+}
+
+boost::shared_ptr<Blocks>
+SegmentCropper::cropBlocks(const Segments& segments)
+{
+	boost::shared_ptr<Slice> first = segments.getSegments()[0]->getSlices()[0];
+	util::rect<int> bound = first->getComponent()->getBoundingBox();
+	unsigned int minSection = first->getSection();
+	unsigned int maxSection = first->getSection();
+	
+	foreach (boost::shared_ptr<Segment> segment, segments.getSegments())
+	{
+		foreach (boost::shared_ptr<Slice> slice, segment->getSlices())
+		{
+			bound.fit(slice->getComponent()->getBoundingBox());
+			minSection = std::min(minSection, slice->getSection());
+			maxSection = std::max(maxSection, slice->getSection());
+		}
+	}
+	
+	boost::shared_ptr<Box<> > box =
+		boost::make_shared<Box<> >(bound, minSection, maxSection - minSection + 1);
+	
+	return _blockManager->blocksInBox(box);
+}
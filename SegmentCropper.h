@@ -0,0 +1,41 @@
+#ifndef SEGMENT_CROPPER_H__
+#define SEGMENT_CROPPER_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <sopnet/block/BlockManager.h>
+#include <sopnet/block/Blocks.h>
+#include <sopnet/segments/Segments.h>
+
+/**
+ * Splits a set of segments into groups that can be processed on small image crops.
+ *
+ * Segments are grouped by the block that contains the center of their first slice. Each group
+ * gets the blocks covering the bounding boxes of its own slices, over the sections they lie
+ * in, so that a long segment only widens the crop of its own group.
+ */
+class SegmentCropper
+{
+public:
+
+	struct Crop
+	{
+		boost::shared_ptr<Segments> segments;
+		boost::shared_ptr<Blocks> blocks;
+	};
+
+	SegmentCropper(const boost::shared_ptr<BlockManager>& blockManager);
+
+	/**
+	 * Group the given segments. The crops are returned in the order of their grid position.
+	 */
+	std::vector<Crop> crop(const Segments& segments);
+
+private:
+
+	boost::shared_ptr<Blocks> cropBlocks(const Segments& segments);
+
+	boost::shared_ptr<BlockManager> _blockManager;
+};
+
+#endif //SEGMENT_CROPPER_H__
@@ -0,0 +1,200 @@
+#include "SegmentFeatureReader.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <pipeline/Value.h>
+#include <sopnet/features/SegmentFeaturesExtractor.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+#include <catmaidsopnet/ParallelFor.h>
+
+logger::LogChannel segmentfeaturereaderlog("segmentfeaturereaderlog", "[SegmentFeatureReader] ");
+
+SegmentFeatureReader::SegmentFeatureReader()
+{
+	registerInput(_segments, "segments");
+	registerInput(_store, "store");
+	registerInput(_rawImageFactory, "raw image factory");
+	registerInput(_blocks, "blocks");
+	registerInput(_stackCache, "stack cache");
+	
+	registerOutput(_features, "all features");
+}
+
+void
+SegmentFeatureReader::updateOutputs()
+{
+	boost::shared_ptr<Segments> missing = boost::make_shared<Segments>();
+	boost::shared_ptr<Features> features = _store->retrieveFeatures(_segments, missing);
+	
+	LOG_DEBUG(segmentfeaturereaderlog) << "Found stored features for " <<
+		(_segments->size() - missing->size()) << " of " << _segments->size() << " segments" <<
+		std::endl;
+	
+	if (missing->size() > 0)
+	{
+		boost::shared_ptr<Segments> stillMissing = boost::make_shared<Segments>();
+		
+		_store->storeFeatures(missing, computeFeatures(missing));
+		
+		// Read all of them again, so that the features are in one place.
+		features = _store->retrieveFeatures(_segments, stillMissing);
+		
+		if (stillMissing->size() > 0)
+		{
+			LOG_ERROR(segmentfeaturereaderlog) << "No features for " << stillMissing->size() <<
+				" segments" << std::endl;
+		}
+	}
+	
+	*_features = *features;
+}
+
+boost::shared_ptr<Features>
+SegmentFeatureReader::computeFeatures(const boost::shared_ptr<Segments>& segments)
+{
+	SegmentCropper cropper(_blocks->getManager());
+	std::vector<SegmentCropper::Crop> crops = cropper.crop(*segments);
+	std::vector<boost::shared_ptr<ImageStack> > stacks(crops.size());
+	std::vector<Chunk> chunks = createChunks(crops);
+	boost::shared_ptr<Features> features = boost::make_shared<Features>();
+	
+	LOG_DEBUG(segmentfeaturereaderlog) << "Computing features for " << segments->size() <<
+		" segments in " << chunks.size() << " chunks" << std::endl;
+	
+	// Read every stack once, before the chunks of a crop compete for it.
+	parallelFor(crops.size(),
+				boost::bind(&SegmentFeatureReader::readStack, this, _1, boost::cref(crops),
+							boost::ref(stacks)));
+	
+	// The first chunk tells the number of features, so that the matrix can be allocated.
+	boost::shared_ptr<Features> firstFeatures = extractChunk(chunks[0], crops, stacks);
+	unsigned int numFeatures = firstFeatures->getNames().size();
+	std::vector<double> matrix(segments->size()*numFeatures);
+	
+	foreach (const std::string& name, firstFeatures->getNames())
+	{
+		features->addName(name);
+	}
+	
+	const std::vector<boost::shared_ptr<Segment> >& firstSegments =
+		chunks[0].segments->getSegments();
+	
+	for (unsigned int i = 0; i < firstSegments.size(); ++i)
+	{
+		const std::vector<double>& row = firstFeatures->get(firstSegments[i]->getId());
+		
+		std::copy(row.begin(), row.end(), matrix.begin() + i*numFeatures);
+	}
+	
+	parallelFor(chunks.size() - 1,
+				boost::bind(&SegmentFeatureReader::extractChunkToMatrix, this, _1,
+							boost::cref(chunks), boost::cref(crops), boost::cref(stacks),
+							numFeatures, boost::ref(matrix)));
+	
+	foreach (const Chunk& chunk, chunks)
+	{
+		const std::vector<boost::shared_ptr<Segment> >& chunkSegments =
+			chunk.segments->getSegments();
+		
+		for (unsigned int i = 0; i < chunkSegments.size(); ++i)
+		{
+			std::vector<double>::const_iterator row =
+				matrix.begin() + (chunk.firstRow + i)*numFeatures;
+			
+			features->add(chunkSegments[i]->getId(),
+						  std::vector<double>(row, row + numFeatures));
+		}
+	}
+	
+	return features;
+}
+
+std::vector<SegmentFeatureReader::Chunk>
+SegmentFeatureReader::createChunks(const std::vector<SegmentCropper::Crop>& crops)
+{
+	// Small enough to spread a single crop over the threads, large enough to keep the
+	// overhead of an extractor per chunk low.
+	const unsigned int chunkSize = 256;
+	
+	std::vector<Chunk> chunks;
+	unsigned int row = 0;
+	
+	for (unsigned int c = 0; c < crops.size(); ++c)
+	{
+		const std::vector<boost::shared_ptr<Segment> >& cropSegments =
+			crops[c].segments->getSegments();
+		
+		for (unsigned int i = 0; i < cropSegments.size(); ++i)
+		{
+			if (i % chunkSize == 0)
+			{
+				Chunk chunk;
+				
+				chunk.crop = c;
+				chunk.segments = boost::make_shared<Segments>();
+				chunk.firstRow = row;
+				
+				chunks.push_back(chunk);
+			}
+			
+			chunks.back().segments->add(cropSegments[i]);
+			++row;
+		}
+	}
+	
+	return chunks;
+}
+
+void
+SegmentFeatureReader::readStack(unsigned int i,
+								const std::vector<SegmentCropper::Crop>& crops,
+								std::vector<boost::shared_ptr<ImageStack> >& stacks)
+{
+	stacks[i] = _stackCache->getStack(_rawImageFactory, crops[i].blocks);
+}
+
+boost::shared_ptr<Features>
+SegmentFeatureReader::extractChunk(const Chunk& chunk,
+								   const std::vector<SegmentCropper::Crop>& crops,
+								   const std::vector<boost::shared_ptr<ImageStack> >& stacks)
+{
+	boost::shared_ptr<SegmentFeaturesExtractor> segmentFeaturesExtractor =
+		boost::make_shared<SegmentFeaturesExtractor>();
+	pipeline::Value<util::point3<unsigned int> > offset(crops[chunk.crop].blocks->location());
+	
+	segmentFeaturesExtractor->setInput("segments", chunk.segments);
+	segmentFeaturesExtractor->setInput("raw sections", stacks[chunk.crop]);
+	segmentFeaturesExtractor->setInput("crop offset", offset);
+	
+	pipeline::Value<Features> features = segmentFeaturesExtractor->getOutput("all features");
+	
+	return features;
+}
+
+/**
+ * Extract the features of chunk i + 1 and write them to its rows of the matrix. The first
+ * chunk is extracted beforehand.
+ */
+void
+SegmentFeatureReader::extractChunkToMatrix(
+		unsigned int i,
+		const std::vector<Chunk>& chunks,
+		const std::vector<SegmentCropper::Crop>& crops,
+		const std::vector<boost::shared_ptr<ImageStack> >& stacks,
+		unsigned int numFeatures,
+		std::vector<double>& matrix)
+{
+	const Chunk& chunk = chunks[i + 1];
+	boost::shared_ptr<Features> features = extractChunk(chunk, crops, stacks);
+	const std::vector<boost::shared_ptr<Segment> >& chunkSegments = chunk.segments->getSegments();
+	
+	for (unsigned int j = 0; j < chunkSegments.size(); ++j)
+	{
+		const std::vector<double>& row = features->get(chunkSegments[j]->getId());
+		
+		std::copy(row.begin(), row.end(),
+				  matrix.begin() + (chunk.firstRow + j)*numFeatures);
+	}
+}
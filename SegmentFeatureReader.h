@@ -0,0 +1,73 @@
+#ifndef SEGMENT_FEATURE_READER_H__
+#define SEGMENT_FEATURE_READER_H__
+
+#include <vector>
+#include <pipeline/all.h>
+#include <imageprocessing/ImageStack.h>
+#include <imageprocessing/io/ImageBlockFactory.h>
+#include <sopnet/block/Blocks.h>
+#include <sopnet/features/Features.h>
+#include <sopnet/segments/Segments.h>
+#include <catmaidsopnet/persistence/SegmentStore.h>
+#include <catmaidsopnet/ImageStackCache.h>
+#include <catmaidsopnet/SegmentCropper.h>
+
+/**
+ * Provides the features of a set of segments, reading them from the SegmentStore where
+ * possible. Features of segments that have none stored yet are computed by a
+ * SegmentFeaturesExtractor and written back to the store. Raw sections are only read for such
+ * segments, on the crops of a SegmentCropper.
+ *
+ * Features are computed in parallel on chunks of the segments of each crop, with one
+ * SegmentFeaturesExtractor per chunk, and collected in one contiguous matrix before they are
+ * handed out.
+ */
+class SegmentFeatureReader : public pipeline::SimpleProcessNode<>
+{
+	/**
+	 * A part of a crop whose features are computed in one go.
+	 */
+	struct Chunk
+	{
+		unsigned int crop;
+		boost::shared_ptr<Segments> segments;
+		// The row of the first segment in the feature matrix
+		unsigned int firstRow;
+	};
+
+public:
+	SegmentFeatureReader();
+
+private:
+	void updateOutputs();
+
+	boost::shared_ptr<Features> computeFeatures(const boost::shared_ptr<Segments>& segments);
+
+	std::vector<Chunk> createChunks(const std::vector<SegmentCropper::Crop>& crops);
+
+	void readStack(unsigned int i,
+				   const std::vector<SegmentCropper::Crop>& crops,
+				   std::vector<boost::shared_ptr<ImageStack> >& stacks);
+
+	boost::shared_ptr<Features> extractChunk(const Chunk& chunk,
+											 const std::vector<SegmentCropper::Crop>& crops,
+											 const std::vector<boost::shared_ptr<ImageStack> >& stacks);
+
+	void extractChunkToMatrix(unsigned int i,
+							  const std::vector<Chunk>& chunks,
+							  const std::vector<SegmentCropper::Crop>& crops,
+							  const std::vector<boost::shared_ptr<ImageStack> >& stacks,
+							  unsigned int numFeatures,
+							  std::vector<double>& matrix);
+
+	pipeline::Input<Segments> _segments;
+	pipeline::Input<SegmentStore> _store;
+	pipeline::Input<ImageBlockFactory> _rawImageFactory;
+	// The requested blocks, only their block manager is used.
+	pipeline::Input<Blocks> _blocks;
+	pipeline::Input<ImageStackCache> _stackCache;
+
+	pipeline::Output<Features> _features;
+};
+
+#endif //SEGMENT_FEATURE_READER_H__
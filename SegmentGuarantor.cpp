@@ -124,7 +124,7 @@ void SegmentGuarantor::updateOutputs()
 	// Check whether this update needs to occur.
 	foreach (boost::shared_ptr<Block> block, *guaranteeBlocks)
 	{
-		allExtracted = block->setSegmentsFlag(true) && allExtracted;
+		allExtracted = block->getSegmentsFlag() && allExtracted;
 	}
 	
 	if (!allExtracted)
@@ -149,6 +149,13 @@ void SegmentGuarantor::updateOutputs()
 		}
 		
 		guaranteeSegments(guaranteeBlocks, sliceBlocks);
+		
+		// Set only once the segments are written, blocks that bailed out above for lack of
+		// slices are extracted on a later request.
+		foreach (boost::shared_ptr<Block> block, *guaranteeBlocks)
+		{
+			block->setSegmentsFlag(true);
+		}
 	}
 	else
 	{
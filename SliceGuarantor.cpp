@@ -98,6 +98,8 @@ SliceGuarantor::guaranteeSlices()
 	
 	// This isn't *really* true.
 	bool allBad = true;
+	// Whether every section was extracted on blocks that contain its slices as a whole.
+	bool allComplete = true;
 
 	// Extract slices independently by z.
 	for (unsigned int i = 0; i < _blocks->size().z; ++i)
@@ -106,8 +108,10 @@ SliceGuarantor::guaranteeSlices()
 		shared_ptr<Slices> zSlices = make_shared<Slices>();
 		shared_ptr<ConflictSets> zConflict = make_shared<ConflictSets>();
 		shared_ptr<Blocks> zBlocks = make_shared<Blocks>();
+		bool complete;
 		
-		allBad = !extractSlices(z, zSlices, zConflict, zBlocks) && allBad;
+		allBad = !extractSlices(z, zSlices, zConflict, zBlocks, complete) && allBad;
+		allComplete = allComplete && complete;
 		
 		slicesVector[i] = zSlices;
 		conflictSetsVector[i] = zConflict;
@@ -133,7 +137,17 @@ SliceGuarantor::guaranteeSlices()
 	sliceWriter->setInput("store", _sliceStore);
 	
 	sliceWriter->writeSlices();
-	
+
+	// Slices cut off by the maximum area are extracted again on the next request. Cleared
+	// again by a BlockInvalidator when the images of a block change.
+	if (allComplete)
+	{
+		foreach (boost::shared_ptr<Block> block, *_blocks)
+		{
+			block->setSlicesFlag(true);
+		}
+	}
+
 	return pipeline::Value<Blocks>();
 }
 
@@ -141,7 +155,8 @@ bool
 SliceGuarantor::extractSlices(const unsigned int z,
 							  const shared_ptr<Slices> slices,
 							  const shared_ptr<ConflictSets> conflictSets,
-							  const shared_ptr<Blocks> extractBlocks)
+							  const shared_ptr<Blocks> extractBlocks,
+							  bool& complete)
 {
 	LOG_ALL(sliceguarantorlog) << "Setting up mini pipeline" << std::endl;
 	shared_ptr<Blocks> nbdBlocks;	
@@ -168,6 +183,7 @@ SliceGuarantor::extractSlices(const unsigned int z,
 		
 		if (image->width() * image->height() == 0)
 		{
+			complete = false;
 			return false;
 		}
 		
@@ -205,6 +221,8 @@ SliceGuarantor::extractSlices(const unsigned int z,
 	conflictSets->addAll(*conflictValue);
 	collectOutputSlices(slicesValue, conflictValue, slices);
 	
+	complete = okSlices;
+	
 	return true;
 }
 
@@ -34,7 +34,6 @@
 
 class SliceGuarantor : public pipeline::SimpleProcessNode<>
 {
-	typedef boost::unordered_map<ConnectedComponent, boost::shared_ptr<Slice> >  ComponentSliceMap;
 public:
 
     SliceGuarantor();
@@ -63,7 +62,8 @@ private:
 	bool extractSlices(const unsigned int z,
 							  const boost::shared_ptr<Slices> slices,
 							  const boost::shared_ptr<ConflictSets> conflictSets,
-							  const boost::shared_ptr<Blocks> extractBlocks);
+							  const boost::shared_ptr<Blocks> extractBlocks,
+							  bool& complete);
 	
 	bool containsAny(const ConflictSet& conflictSet, const std::set<unsigned int>& idSet);
 	
@@ -0,0 +1,155 @@
+#include "SliceSegmentIncidence.h"
+
+#include <algorithm>
+#include <boost/make_shared.hpp>
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel slicesegmentincidencelog("slicesegmentincidencelog", "[SliceSegmentIncidence] ");
+
+SliceSegmentIncidence::SliceSegmentIncidence() :
+	_finalized(false)
+{
+}
+
+void
+SliceSegmentIncidence::add(unsigned int sliceId, unsigned int segmentId)
+{
+	_pairs.push_back(std::make_pair(_sliceIds.insert(sliceId), _segmentIds.insert(segmentId)));
+	_finalized = false;
+}
+
+void
+SliceSegmentIncidence::add(const Segment& segment)
+{
+	foreach (boost::shared_ptr<Slice> slice, segment.getSlices())
+	{
+		add(slice->getId(), segment.getId());
+	}
+}
+
+void
+SliceSegmentIncidence::finalize()
+{
+	typedef std::pair<unsigned int, unsigned int> pair_t;
+
+	if (_finalized)
+	{
+		return;
+	}
+
+	// Slice indices are dense, so the pairs can be bucketed by slice with a counting sort.
+	_offsets.assign(_sliceIds.size() + 1, 0);
+	_segmentIndices.resize(_pairs.size());
+
+	foreach (const pair_t& pair, _pairs)
+	{
+		++_offsets[pair.first + 1];
+	}
+
+	for (unsigned int i = 0; i < _sliceIds.size(); ++i)
+	{
+		_offsets[i + 1] += _offsets[i];
+	}
+
+	std::vector<unsigned int> next(_offsets.begin(), _offsets.end() - 1);
+
+	foreach (const pair_t& pair, _pairs)
+	{
+		_segmentIndices[next[pair.first]++] = pair.second;
+	}
+
+	// Sort each row and remove duplicate pairs, compacting the rows in place.
+	unsigned int end = 0;
+
+	for (unsigned int i = 0; i < _sliceIds.size(); ++i)
+	{
+		std::vector<unsigned int>::iterator rowBegin = _segmentIndices.begin() + _offsets[i];
+		std::vector<unsigned int>::iterator rowEnd = _segmentIndices.begin() + _offsets[i + 1];
+
+		std::sort(rowBegin, rowEnd);
+		rowEnd = std::unique(rowBegin, rowEnd);
+
+		_offsets[i] = end;
+		end = std::copy(rowBegin, rowEnd, _segmentIndices.begin() + end) -
+			_segmentIndices.begin();
+	}
+
+	_offsets[_sliceIds.size()] = end;
+	_segmentIndices.resize(end);
+	_finalized = true;
+
+	LOG_DEBUG(slicesegmentincidencelog) << "Packed " << _segmentIndices.size() <<
+		" incidences of " << _sliceIds.size() << " slices and " << _segmentIds.size() <<
+		" segments" << std::endl;
+}
+
+void
+SliceSegmentIncidence::clear()
+{
+	_sliceIds.clear();
+	_segmentIds.clear();
+	_pairs.clear();
+	_offsets.clear();
+	_segmentIndices.clear();
+	_finalized = false;
+}
+
+std::pair<SliceSegmentIncidence::const_iterator, SliceSegmentIncidence::const_iterator>
+SliceSegmentIncidence::getSegments(unsigned int sliceId) const
+{
+	unsigned int sliceIndex;
+
+	if (!_finalized || !_sliceIds.find(sliceId, sliceIndex))
+	{
+		return std::make_pair(_segmentIndices.end(), _segmentIndices.end());
+	}
+
+	return std::make_pair(_segmentIndices.begin() + _offsets[sliceIndex],
+						  _segmentIndices.begin() + _offsets[sliceIndex + 1]);
+}
+
+boost::shared_ptr<SparseConstraintMatrix>
+SliceSegmentIncidence::lift(const SparseConstraintMatrix& sliceConstraints,
+							Relation relation, double value) const
+{
+	boost::shared_ptr<SparseConstraintMatrix> segmentConstraints =
+		boost::make_shared<SparseConstraintMatrix>();
+	// The last row each segment was added to, plus one.
+	std::vector<unsigned int> lastRow(_segmentIds.size(), 0);
+	std::vector<unsigned int> segmentIds;
+
+	segmentConstraints->reserve(sliceConstraints.numRows(), sliceConstraints.numNonZeros());
+
+	for (unsigned int row = 0; row < sliceConstraints.numRows(); ++row)
+	{
+		segmentIds.clear();
+
+		// for each slice in the constraint
+		for (SparseConstraintMatrix::column_iterator slice = sliceConstraints.columnsBegin(row);
+			 slice != sliceConstraints.columnsEnd(row); ++slice)
+		{
+			std::pair<const_iterator, const_iterator> segments = getSegments(*slice);
+
+			// a segment using several slices of the constraint gets a single coefficient
+			for (const_iterator it = segments.first; it != segments.second; ++it)
+			{
+				if (lastRow[*it] != row + 1)
+				{
+					lastRow[*it] = row + 1;
+					segmentIds.push_back(_segmentIds.getId(*it));
+				}
+			}
+		}
+
+		// no segment uses the slices, nothing to constrain
+		if (segmentIds.empty())
+		{
+			continue;
+		}
+
+		segmentConstraints->addUnitRow(segmentIds.begin(), segmentIds.end(), relation, value);
+	}
+
+	return segmentConstraints;
+}
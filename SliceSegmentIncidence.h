@@ -0,0 +1,82 @@
+#ifndef SLICE_SEGMENT_INCIDENCE_H__
+#define SLICE_SEGMENT_INCIDENCE_H__
+
+#include <vector>
+#include <utility>
+#include <boost/shared_ptr.hpp>
+#include <inference/Relation.h>
+#include <sopnet/segments/Segment.h>
+#include <catmaidsopnet/DenseIdMap.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
+
+/**
+ * The incidence of Slices and Segments in compressed-sparse-row form, used to lift constraints
+ * on Slices to constraints on the Segments that use them.
+ *
+ * Slices and Segments get dense indices as they are added. Pairs are collected with add() and
+ * then packed by finalize(), so that the Segment indices of each Slice are stored contiguously
+ * in one array. Lifting works on the dense indices and maps back to global Segment ids only
+ * when the constraints are written. After finalize(), the incidence is read-only and may be
+ * shared between threads.
+ */
+class SliceSegmentIncidence
+{
+public:
+	typedef std::vector<unsigned int>::const_iterator const_iterator;
+
+	SliceSegmentIncidence();
+
+	/**
+	 * Record that the segment uses the slice.
+	 */
+	void add(unsigned int sliceId, unsigned int segmentId);
+
+	/**
+	 * Record that the segment uses all of its slices.
+	 */
+	void add(const Segment& segment);
+
+	/**
+	 * Pack the recorded pairs. Duplicate pairs are removed. Has to be called again after
+	 * adding more pairs.
+	 */
+	void finalize();
+
+	void clear();
+
+	/**
+	 * The dense indices of the segments using the given slice, in increasing order. Use
+	 * getSegmentIds() to map them to global ids.
+	 */
+	std::pair<const_iterator, const_iterator> getSegments(unsigned int sliceId) const;
+
+	/**
+	 * Create one segment constraint for each slice constraint, with a coefficient of 1 for
+	 * every segment that uses one of the constraint's slices. Slice constraints that no segment
+	 * uses are skipped, they would end up as empty rows.
+	 */
+	boost::shared_ptr<SparseConstraintMatrix> lift(const SparseConstraintMatrix& sliceConstraints,
+												   Relation relation, double value) const;
+
+	const DenseIdMap& getSliceIds() const { return _sliceIds; }
+
+	const DenseIdMap& getSegmentIds() const { return _segmentIds; }
+
+	unsigned int numPairs() const { return _segmentIndices.size(); }
+
+private:
+
+	DenseIdMap _sliceIds;
+	DenseIdMap _segmentIds;
+
+	// Recorded pairs of dense slice and segment indices
+	std::vector<std::pair<unsigned int, unsigned int> > _pairs;
+
+	// Segments of slice i are _segmentIndices[_offsets[i]] to _segmentIndices[_offsets[i + 1] - 1]
+	std::vector<unsigned int> _offsets;
+	std::vector<unsigned int> _segmentIndices;
+
+	bool _finalized;
+};
+
+#endif //SLICE_SEGMENT_INCIDENCE_H__
@@ -0,0 +1,133 @@
+#include "SolutionCache.h"
+
+#include <boost/make_shared.hpp>
+#include <boost/functional/hash.hpp>
+
+SolutionCache::SolutionCache(unsigned int capacity) :
+	_capacity(capacity),
+	_lookups(0),
+	_hits(0)
+{
+}
+
+bool
+SolutionCache::lookup(const std::vector<unsigned int>& segmentIds,
+					  const std::vector<double>& costs,
+					  std::size_t constraintsHash,
+					  std::vector<double>& values)
+{
+	std::size_t key = hashKey(segmentIds, costs, constraintsHash);
+	boost::mutex::scoped_lock lock(_mutex);
+	std::pair<EntryMap::const_iterator, EntryMap::const_iterator> range = _entries.equal_range(key);
+
+	++_lookups;
+
+	for (EntryMap::const_iterator it = range.first; it != range.second; ++it)
+	{
+		const Entry& entry = *it->second;
+
+		if (entry.constraintsHash == constraintsHash && entry.segmentIds == segmentIds &&
+			entry.costs == costs)
+		{
+			values = entry.values;
+			++_hits;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+SolutionCache::insert(const std::vector<unsigned int>& segmentIds,
+					  const std::vector<double>& costs,
+					  std::size_t constraintsHash,
+					  const std::vector<double>& values)
+{
+	std::size_t key = hashKey(segmentIds, costs, constraintsHash);
+	boost::shared_ptr<Entry> entry = boost::make_shared<Entry>();
+
+	entry->segmentIds = segmentIds;
+	entry->costs = costs;
+	entry->constraintsHash = constraintsHash;
+	entry->values = values;
+
+	boost::mutex::scoped_lock lock(_mutex);
+
+	_entries.insert(std::make_pair(key, entry));
+	_insertionOrder.push_back(std::make_pair(key, entry));
+
+	while (_insertionOrder.size() > _capacity)
+	{
+		std::pair<std::size_t, boost::shared_ptr<Entry> > oldest = _insertionOrder.front();
+		std::pair<EntryMap::iterator, EntryMap::iterator> range =
+			_entries.equal_range(oldest.first);
+
+		for (EntryMap::iterator it = range.first; it != range.second; ++it)
+		{
+			if (it->second == oldest.second)
+			{
+				_entries.erase(it);
+				break;
+			}
+		}
+
+		_insertionOrder.pop_front();
+	}
+}
+
+void
+SolutionCache::clear()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+
+	_entries.clear();
+	_insertionOrder.clear();
+	_lookups = 0;
+	_hits = 0;
+}
+
+unsigned int
+SolutionCache::size()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+
+	return _entries.size();
+}
+
+unsigned int
+SolutionCache::getLookups()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+
+	return _lookups;
+}
+
+unsigned int
+SolutionCache::getHits()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+
+	return _hits;
+}
+
+double
+SolutionCache::getHitRate()
+{
+	boost::mutex::scoped_lock lock(_mutex);
+
+	return _lookups == 0 ? 0.0 : static_cast<double>(_hits) / _lookups;
+}
+
+std::size_t
+SolutionCache::hashKey(const std::vector<unsigned int>& segmentIds,
+					   const std::vector<double>& costs,
+					   std::size_t constraintsHash)
+{
+	std::size_t seed = constraintsHash;
+
+	boost::hash_combine(seed, segmentIds);
+	boost::hash_combine(seed, costs);
+
+	return seed;
+}
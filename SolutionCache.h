@@ -0,0 +1,81 @@
+#ifndef SOLUTION_CACHE_H__
+#define SOLUTION_CACHE_H__
+
+#include <list>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <pipeline/all.h>
+
+/**
+ * Remembers the solutions of independent parts of previous problems, so that they can be
+ * reused when the same part shows up again, e.g., when a window is shifted by one block.
+ *
+ * A part is identified by the ids of its segments, their costs and a hash of its constraints
+ * in terms of segment ids, which covers the solver parameters, the cost parameters and the
+ * forest. Entries are evicted in insertion order once the capacity is reached. All methods
+ * are thread-safe.
+ */
+class SolutionCache : public pipeline::Data
+{
+	struct Entry
+	{
+		std::vector<unsigned int> segmentIds;
+		std::vector<double> costs;
+		std::size_t constraintsHash;
+		std::vector<double> values;
+	};
+
+	typedef boost::unordered_multimap<std::size_t, boost::shared_ptr<Entry> > EntryMap;
+
+public:
+	/**
+	 * @param capacity - the maximal number of parts to remember.
+	 */
+	SolutionCache(unsigned int capacity = 100000);
+
+	/**
+	 * Find the values of a previously solved part. Returns false if the part is unknown.
+	 */
+	bool lookup(const std::vector<unsigned int>& segmentIds,
+				const std::vector<double>& costs,
+				std::size_t constraintsHash,
+				std::vector<double>& values);
+
+	void insert(const std::vector<unsigned int>& segmentIds,
+				const std::vector<double>& costs,
+				std::size_t constraintsHash,
+				const std::vector<double>& values);
+
+	void clear();
+
+	unsigned int size();
+
+	unsigned int getLookups();
+
+	unsigned int getHits();
+
+	/**
+	 * The fraction of lookups that were answered from the cache.
+	 */
+	double getHitRate();
+
+private:
+
+	static std::size_t hashKey(const std::vector<unsigned int>& segmentIds,
+							   const std::vector<double>& costs,
+							   std::size_t constraintsHash);
+
+	unsigned int _capacity;
+
+	EntryMap _entries;
+	std::list<std::pair<std::size_t, boost::shared_ptr<Entry> > > _insertionOrder;
+
+	unsigned int _lookups;
+	unsigned int _hits;
+
+	boost::mutex _mutex;
+};
+
+#endif //SOLUTION_CACHE_H__
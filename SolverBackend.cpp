@@ -0,0 +1,212 @@
+#include "SolverBackend.h"
+
+#include <algorithm>
+
+#include <boost/make_shared.hpp>
+#include <pipeline/Value.h>
+#include <inference/Relation.h>
+#include <sopnet/inference/LinearSolver.h>
+#include <util/exceptions.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+#include <catmaidsopnet/DecomposingLinearSolver.h>
+#include <catmaidsopnet/ParallelFor.h>
+
+#ifdef HAVE_HIGHS
+#include <Highs.h>
+#endif
+
+logger::LogChannel solverbackendlog("solverbackendlog", "[SolverBackend] ");
+
+void
+SolverBackend::setNumThreads(unsigned int numThreads)
+{
+	_numThreads = std::max(1u, std::min(numThreads, defaultNumThreads()));
+	
+	if (_numThreads != numThreads)
+	{
+		LOG_ALL(solverbackendlog) << "Using " << _numThreads << " instead of " << numThreads <<
+			" solver threads" << std::endl;
+	}
+}
+
+boost::shared_ptr<SolverBackend>
+SolverBackend::create(const std::string& name)
+{
+	if (name == "default")
+	{
+		return boost::make_shared<DefaultSolverBackend>();
+	}
+	
+	if (name == "highs")
+	{
+#ifdef HAVE_HIGHS
+		return boost::make_shared<HighsSolverBackend>();
+#else
+		BOOST_THROW_EXCEPTION(UsageError() << error_message(
+				"catmaidsopnet was built without HiGHS, solver backend 'highs' is not available"));
+#endif
+	}
+	
+	BOOST_THROW_EXCEPTION(UsageError() << error_message("unknown solver backend " + name));
+}
+
+bool
+DefaultSolverBackend::solve(const LinearObjective& objective,
+							const SparseConstraintMatrix& constraints,
+							const std::vector<double>& /*warmStart*/,
+							const SolverBudget& /*budget*/,
+							Solution& solution,
+							SolveStatistics& statistics)
+{
+	boost::shared_ptr<LinearSolver> solver = boost::make_shared<LinearSolver>();
+	pipeline::Value<LinearObjective> objectiveValue(objective);
+	
+	solver->setInput("objective", objectiveValue);
+	solver->setInput("linear constraints", constraints.toLinearConstraints());
+	solver->setInput("parameters", boost::make_shared<LinearSolverParameters>(Binary));
+	
+	pipeline::Value<Solution> result = solver->getOutput("solution");
+	
+	solution = *result;
+	
+	statistics.objective = 0;
+	
+	for (unsigned int i = 0; i < objective.size(); ++i)
+	{
+		statistics.objective += objective.getCoefficients()[i]*solution[i];
+	}
+	
+	// The LinearSolver always solves to optimality.
+	statistics.lowerBound = statistics.objective;
+	
+	return true;
+}
+
+#ifdef HAVE_HIGHS
+
+bool
+HighsSolverBackend::solve(const LinearObjective& objective,
+						  const SparseConstraintMatrix& constraints,
+						  const std::vector<double>& warmStart,
+						  const SolverBudget& budget,
+						  Solution& solution,
+						  SolveStatistics& statistics)
+{
+	unsigned int numVariables = objective.size();
+	unsigned int numRows = constraints.numRows();
+	Highs highs;
+	HighsLp lp;
+	
+	lp.num_col_ = numVariables;
+	lp.num_row_ = numRows;
+	lp.col_cost_ = objective.getCoefficients();
+	lp.col_lower_.assign(numVariables, 0.0);
+	lp.col_upper_.assign(numVariables, 1.0);
+	lp.integrality_.assign(numVariables, HighsVarType::kInteger);
+	
+	// The rows are handed over as they are, both are compressed sparse rows.
+	lp.a_matrix_.format_ = MatrixFormat::kRowwise;
+	lp.a_matrix_.num_col_ = numVariables;
+	lp.a_matrix_.num_row_ = numRows;
+	lp.a_matrix_.start_.push_back(0);
+	lp.a_matrix_.index_.reserve(constraints.numNonZeros());
+	lp.a_matrix_.value_.reserve(constraints.numNonZeros());
+	
+	for (unsigned int row = 0; row < numRows; ++row)
+	{
+		lp.a_matrix_.index_.insert(lp.a_matrix_.index_.end(),
+								   constraints.columnsBegin(row), constraints.columnsEnd(row));
+		lp.a_matrix_.value_.insert(lp.a_matrix_.value_.end(),
+								   constraints.coefficientsBegin(row),
+								   constraints.coefficientsBegin(row) + constraints.rowSize(row));
+		lp.a_matrix_.start_.push_back(lp.a_matrix_.index_.size());
+		
+		switch (constraints.getRelation(row))
+		{
+			case LessEqual:
+				lp.row_lower_.push_back(-kHighsInf);
+				lp.row_upper_.push_back(constraints.getValue(row));
+				break;
+			case GreaterEqual:
+				lp.row_lower_.push_back(constraints.getValue(row));
+				lp.row_upper_.push_back(kHighsInf);
+				break;
+			default:
+				lp.row_lower_.push_back(constraints.getValue(row));
+				lp.row_upper_.push_back(constraints.getValue(row));
+				break;
+		}
+	}
+	
+	highs.setOptionValue("output_flag", false);
+	// HiGHS sets up its thread pool once per process, with the number of threads of the
+	// first call, and fails on a different one later. Therefore, always pass the same
+	// number, the DecomposingLinearSolver limits how many components are solved at once.
+	highs.setOptionValue("threads", static_cast<HighsInt>(_numThreads));
+	
+	if (budget.timeLimit > 0)
+	{
+		highs.setOptionValue("time_limit", budget.timeLimit);
+	}
+	
+	if (budget.gap > 0)
+	{
+		highs.setOptionValue("mip_rel_gap", budget.gap);
+	}
+	
+	if (highs.passModel(lp) != HighsStatus::kOk)
+	{
+		LOG_ERROR(solverbackendlog) << "HiGHS did not accept the problem" << std::endl;
+		return false;
+	}
+	
+	if (warmStart.size() == numVariables)
+	{
+		HighsSolution start;
+		
+		start.col_value = warmStart;
+		
+		// An infeasible start is ignored by HiGHS.
+		highs.setSolution(start);
+	}
+	
+	highs.run();
+	
+	const HighsInfo& info = highs.getInfo();
+	
+	if (info.primal_solution_status != kSolutionStatusFeasiblePoint)
+	{
+		LOG_DEBUG(solverbackendlog) << "HiGHS found no feasible solution: " <<
+			highs.modelStatusToString(highs.getModelStatus()) << std::endl;
+		return false;
+	}
+	
+	const std::vector<double>& values = highs.getSolution().col_value;
+	
+	for (unsigned int i = 0; i < numVariables; ++i)
+	{
+		solution[i] = (values[i] > 0.5 ? 1 : 0);
+	}
+	
+	statistics.objective = info.objective_function_value;
+	statistics.lowerBound = info.mip_dual_bound;
+	statistics.nodes = static_cast<int>(info.mip_node_count);
+	
+	return true;
+}
+
+#else
+
+bool
+HighsSolverBackend::solve(const LinearObjective& /*objective*/,
+						  const SparseConstraintMatrix& /*constraints*/,
+						  const std::vector<double>& /*warmStart*/,
+						  const SolverBudget& /*budget*/,
+						  Solution& /*solution*/,
+						  SolveStatistics& /*statistics*/)
+{
+	BOOST_THROW_EXCEPTION(UsageError() << error_message("catmaidsopnet was built without HiGHS"));
+}
+
+#endif // HAVE_HIGHS
@@ -0,0 +1,112 @@
+#ifndef SOLVER_BACKEND_H__
+#define SOLVER_BACKEND_H__
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <pipeline/all.h>
+#include <sopnet/inference/LinearObjective.h>
+#include <sopnet/inference/Solution.h>
+#include <catmaidsopnet/SparseConstraintMatrix.h>
+
+class SolveStatistics;
+
+/**
+ * Limits on the effort spent by a DecomposingLinearSolver or a SolverBackend.
+ */
+class SolverBudget : public pipeline::Data
+{
+public:
+	SolverBudget(double timeLimit_ = 0, double gap_ = 0) :
+		timeLimit(timeLimit_),
+		gap(gap_) {}
+
+	// Seconds after which the remaining components are solved greedily, or a backend returns
+	// the best solution found so far, 0 for no limit.
+	double timeLimit;
+
+	// Relative gap to the lower bound at which a greedy solution of a component is accepted
+	// without solving it, or a backend stops searching, 0 to always solve to optimality.
+	double gap;
+};
+
+/**
+ * A MIP solver for binary problems, used by the DecomposingLinearSolver to solve components.
+ * Implementations have to allow concurrent calls to solve().
+ */
+class SolverBackend : public pipeline::Data
+{
+public:
+	SolverBackend() : _numThreads(1) {}
+
+	virtual ~SolverBackend() {}
+
+	/**
+	 * Solve the binary problem, minimizing the objective.
+	 *
+	 * @param warmStart - empty, or a value for every variable to start the search from.
+	 * @param budget - the time and gap at which to stop with the best solution found.
+	 * @param solution - the best solution found.
+	 * @param statistics - what the solver tells about the solve, e.g., the lower bound.
+	 * @return false if no feasible solution was found.
+	 */
+	virtual bool solve(const LinearObjective& objective,
+					   const SparseConstraintMatrix& constraints,
+					   const std::vector<double>& warmStart,
+					   const SolverBudget& budget,
+					   Solution& solution,
+					   SolveStatistics& statistics) = 0;
+
+	/**
+	 * The number of threads the solver may use for one problem, at most defaultNumThreads().
+	 * Should be set once, before the first call to solve().
+	 */
+	void setNumThreads(unsigned int numThreads);
+
+	unsigned int getNumThreads() const
+	{
+		return _numThreads;
+	}
+
+	/**
+	 * Create a backend by name: "default" for the LinearSolver sopnet was built with, or
+	 * "highs" for HiGHS, if available.
+	 */
+	static boost::shared_ptr<SolverBackend> create(const std::string& name);
+
+protected:
+
+	unsigned int _numThreads;
+};
+
+/**
+ * Solves with the LinearSolver of sopnet, which needs the constraints as LinearConstraints.
+ * Warm starts, budgets and the number of threads are ignored.
+ */
+class DefaultSolverBackend : public SolverBackend
+{
+public:
+	bool solve(const LinearObjective& objective,
+			   const SparseConstraintMatrix& constraints,
+			   const std::vector<double>& warmStart,
+			   const SolverBudget& budget,
+			   Solution& solution,
+			   SolveStatistics& statistics);
+};
+
+/**
+ * Solves in-process with the open-source HiGHS MIP solver. Only functional if catmaidsopnet
+ * was built with HiGHS, ie, with HAVE_HIGHS defined.
+ */
+class HighsSolverBackend : public SolverBackend
+{
+public:
+	bool solve(const LinearObjective& objective,
+			   const SparseConstraintMatrix& constraints,
+			   const std::vector<double>& warmStart,
+			   const SolverBudget& budget,
+			   Solution& solution,
+			   SolveStatistics& statistics);
+};
+
+#endif //SOLVER_BACKEND_H__
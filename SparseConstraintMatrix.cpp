@@ -0,0 +1,114 @@
+#include "SparseConstraintMatrix.h"
+
+#include <boost/make_shared.hpp>
+#include <util/foreach.h>
+
+SparseConstraintMatrix::SparseConstraintMatrix() :
+	_offsets(1, 0)
+{
+}
+
+void
+SparseConstraintMatrix::addRow(const LinearConstraint& constraint)
+{
+	typedef std::map<unsigned int, double>::value_type pair_t;
+	
+	foreach (const pair_t& pair, constraint.getCoefficients())
+	{
+		_columns.push_back(pair.first);
+		_coefficients.push_back(pair.second);
+	}
+	
+	closeRow(constraint.getRelation(), constraint.getValue());
+}
+
+void
+SparseConstraintMatrix::addRow(const std::vector<unsigned int>& columns,
+							   const std::vector<double>& coefficients,
+							   Relation relation,
+							   double value)
+{
+	_columns.insert(_columns.end(), columns.begin(), columns.end());
+	_coefficients.insert(_coefficients.end(), coefficients.begin(), coefficients.end());
+	
+	closeRow(relation, value);
+}
+
+void
+SparseConstraintMatrix::addRows(const LinearConstraints& constraints)
+{
+	foreach (const LinearConstraint& constraint, constraints)
+	{
+		addRow(constraint);
+	}
+}
+
+void
+SparseConstraintMatrix::addAll(const SparseConstraintMatrix& other)
+{
+	unsigned int base = _columns.size();
+	
+	_columns.insert(_columns.end(), other._columns.begin(), other._columns.end());
+	_coefficients.insert(_coefficients.end(),
+						 other._coefficients.begin(), other._coefficients.end());
+	_relations.insert(_relations.end(), other._relations.begin(), other._relations.end());
+	_values.insert(_values.end(), other._values.begin(), other._values.end());
+	
+	for (unsigned int i = 1; i < other._offsets.size(); ++i)
+	{
+		_offsets.push_back(base + other._offsets[i]);
+	}
+}
+
+void
+SparseConstraintMatrix::reserve(unsigned int numRows, unsigned int numNonZeros)
+{
+	_offsets.reserve(numRows + 1);
+	_relations.reserve(numRows);
+	_values.reserve(numRows);
+	_columns.reserve(numNonZeros);
+	_coefficients.reserve(numNonZeros);
+}
+
+void
+SparseConstraintMatrix::clear()
+{
+	_offsets.assign(1, 0);
+	_columns.clear();
+	_coefficients.clear();
+	_relations.clear();
+	_values.clear();
+}
+
+boost::shared_ptr<LinearConstraints>
+SparseConstraintMatrix::toLinearConstraints() const
+{
+	boost::shared_ptr<LinearConstraints> constraints = boost::make_shared<LinearConstraints>();
+	
+	for (unsigned int row = 0; row < numRows(); ++row)
+	{
+		LinearConstraint constraint;
+		coefficient_iterator coefficient = coefficientsBegin(row);
+		
+		for (column_iterator column = columnsBegin(row); column != columnsEnd(row);
+			 ++column, ++coefficient)
+		{
+			constraint.setCoefficient(*column, *coefficient);
+		}
+		
+		constraint.setRelation(_relations[row]);
+		constraint.setValue(_values[row]);
+		
+		constraints->add(constraint);
+	}
+	
+	return constraints;
+}
+
+void
+SparseConstraintMatrix::closeRow(Relation relation, double value)
+{
+	_offsets.push_back(_columns.size());
+	_relations.push_back(relation);
+	_values.push_back(value);
+}
@@ -0,0 +1,106 @@
+#ifndef SPARSE_CONSTRAINT_MATRIX_H__
+#define SPARSE_CONSTRAINT_MATRIX_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <pipeline/Data.h>
+#include <inference/Relation.h>
+#include <sopnet/inference/LinearConstraint.h>
+#include <sopnet/inference/LinearConstraints.h>
+
+/**
+ * A set of linear constraints as a sparse matrix in compressed-sparse-row form, with one
+ * relation and right-hand side value per row.
+ *
+ * Rows are appended without going through the std::map of LinearConstraint, so that memory
+ * and time scale with the number of non-zeros. A row must not contain a column twice.
+ * Conversion from and to LinearConstraints happens only where the constraints are exchanged
+ * with sopnet, ie, the LinearSolver, and where problems are read from or written to files.
+ */
+class SparseConstraintMatrix : public pipeline::Data
+{
+public:
+	typedef std::vector<unsigned int>::const_iterator column_iterator;
+	typedef std::vector<double>::const_iterator coefficient_iterator;
+
+	SparseConstraintMatrix();
+
+	/**
+	 * Append a row with a coefficient of 1 for each column in [begin, end).
+	 */
+	template <typename Iterator>
+	void addUnitRow(Iterator begin, Iterator end, Relation relation, double value)
+	{
+		for (Iterator it = begin; it != end; ++it)
+		{
+			_columns.push_back(*it);
+			_coefficients.push_back(1.0);
+		}
+
+		closeRow(relation, value);
+	}
+
+	/**
+	 * Append a row with the given columns and coefficients.
+	 */
+	void addRow(const std::vector<unsigned int>& columns,
+				const std::vector<double>& coefficients,
+				Relation relation,
+				double value);
+
+	void addRow(const LinearConstraint& constraint);
+
+	/**
+	 * Append a row for each of the given constraints.
+	 */
+	void addRows(const LinearConstraints& constraints);
+
+	void addAll(const SparseConstraintMatrix& other);
+
+	void reserve(unsigned int numRows, unsigned int numNonZeros);
+
+	void clear();
+
+	unsigned int numRows() const { return _relations.size(); }
+
+	unsigned int numNonZeros() const { return _columns.size(); }
+
+	unsigned int rowSize(unsigned int row) const { return _offsets[row + 1] - _offsets[row]; }
+
+	column_iterator columnsBegin(unsigned int row) const
+	{
+		return _columns.begin() + _offsets[row];
+	}
+
+	column_iterator columnsEnd(unsigned int row) const
+	{
+		return _columns.begin() + _offsets[row + 1];
+	}
+
+	coefficient_iterator coefficientsBegin(unsigned int row) const
+	{
+		return _coefficients.begin() + _offsets[row];
+	}
+
+	Relation getRelation(unsigned int row) const { return _relations[row]; }
+
+	double getValue(unsigned int row) const { return _values[row]; }
+
+	/**
+	 * Convert the rows into sopnet LinearConstraints.
+	 */
+	boost::shared_ptr<LinearConstraints> toLinearConstraints() const;
+
+private:
+
+	void closeRow(Relation relation, double value);
+
+	// Row i has the entries _offsets[i] to _offsets[i + 1] - 1
+	std::vector<unsigned int> _offsets;
+	std::vector<unsigned int> _columns;
+	std::vector<double> _coefficients;
+	std::vector<Relation> _relations;
+	std::vector<double> _values;
+};
+
+#endif //SPARSE_CONSTRAINT_MATRIX_H__
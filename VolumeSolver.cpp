@@ -0,0 +1,203 @@
+#include "VolumeSolver.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/unordered_set.hpp>
+#include <pipeline/Value.h>
+#include <sopnet/block/Box.h>
+#include <sopnet/block/BlockManager.h>
+#include <sopnet/neurons/NeuronExtractor.h>
+#include <util/foreach.h>
+#include <util/Logger.h>
+#include <catmaidsopnet/CoreSolver.h>
+#include <catmaidsopnet/ParallelFor.h>
+
+logger::LogChannel volumesolverlog("volumesolverlog", "[VolumeSolver] ");
+
+VolumeSolver::VolumeSolver(const util::point3<unsigned int>& tileSize, unsigned int overlap) :
+	_tileSize(std::max(tileSize.x, 1u), std::max(tileSize.y, 1u), std::max(tileSize.z, 1u)),
+	_overlap(overlap),
+	_stackCache(boost::make_shared<ImageStackCache>())
+{
+	registerInput(_blocks, "blocks");
+	registerInput(_priorCostFunctionParameters, "prior cost parameters");
+	registerInput(_segmentationCostFunctionParameters, "segmentation cost parameters",
+				  pipeline::Optional);
+	registerInput(_segmentStore, "segment store");
+	registerInput(_sliceStore, "slice store");
+	registerInput(_rawImageFactory, "raw image factory");
+	registerInput(_membraneFactory, "membrane factory");
+	registerInput(_forceExplanation, "force explanation");
+
+	registerOutput(_neurons, "neurons");
+	registerOutput(_assignment, "assignment");
+}
+
+void
+VolumeSolver::updateOutputs()
+{
+	std::vector<Window> windows = createWindows();
+	boost::shared_ptr<SegmentAssignment> assignment = boost::make_shared<SegmentAssignment>();
+	boost::shared_ptr<NeuronExtractor> neuronExtractor = boost::make_shared<NeuronExtractor>();
+	pipeline::Value<Segments> chosenSegments;
+	boost::unordered_set<unsigned int> seen;
+
+	LOG_DEBUG(volumesolverlog) << "Solving " << _blocks->length() << " blocks in " <<
+		windows.size() << " windows" << std::endl;
+
+	// There are eight colours, one for each combination of parities in x, y and z.
+	for (unsigned int colour = 0; colour < 8; ++colour)
+	{
+		std::vector<Window> phase;
+
+		foreach (const Window& window, windows)
+		{
+			if (window.colour == colour)
+			{
+				phase.push_back(window);
+			}
+		}
+
+		if (phase.empty())
+		{
+			continue;
+		}
+
+		std::vector<boost::shared_ptr<SegmentAssignment> > results(phase.size());
+		// The decisions so far, not modified while the windows of this colour are solved.
+		boost::shared_ptr<SegmentAssignment> fixedSegments =
+			boost::make_shared<SegmentAssignment>(*assignment);
+
+		LOG_DEBUG(volumesolverlog) << "Solving " << phase.size() << " windows of colour " <<
+			colour << " with " << fixedSegments->size() << " fixed segments" << std::endl;
+
+		parallelFor(phase.size(),
+					boost::bind(&VolumeSolver::solveWindow, this, _1, boost::cref(phase),
+								boost::cref(fixedSegments), boost::ref(results)));
+
+		// Merge in window order, so that the result does not depend on scheduling.
+		foreach (boost::shared_ptr<SegmentAssignment> result, results)
+		{
+			assignment->merge(*result);
+		}
+	}
+
+	// Collect the chosen segments of the whole volume.
+	foreach (boost::shared_ptr<Block> block, *_blocks)
+	{
+		foreach (boost::shared_ptr<Segment> segment,
+				 _segmentStore->retrieveSegments(block)->getSegments())
+		{
+			if (assignment->isChosen(segment->getId()) && seen.insert(segment->getId()).second)
+			{
+				chosenSegments->add(segment);
+			}
+		}
+	}
+
+	neuronExtractor->setInput("segments", chosenSegments);
+
+	pipeline::Value<SegmentTrees> neurons = neuronExtractor->getOutput();
+
+	*_neurons = *neurons;
+	*_assignment = *assignment;
+}
+
+std::vector<VolumeSolver::Window>
+VolumeSolver::createWindows()
+{
+	std::vector<Window> windows;
+	boost::shared_ptr<BlockManager> manager = _blocks->getManager();
+	util::point3<unsigned int> blockSize = manager->blockSize();
+	util::point3<unsigned int> location = _blocks->location();
+	util::point3<unsigned int> size = _blocks->size();
+	util::point3<unsigned int> tilePixels(_tileSize.x * blockSize.x,
+										  _tileSize.y * blockSize.y,
+										  _tileSize.z * blockSize.z);
+	util::point3<int> margin(_overlap * blockSize.x, _overlap * blockSize.y,
+							 _overlap * blockSize.z);
+
+	for (unsigned int k = 0; k * tilePixels.z < size.z; ++k)
+	{
+		for (unsigned int j = 0; j * tilePixels.y < size.y; ++j)
+		{
+			for (unsigned int i = 0; i * tilePixels.x < size.x; ++i)
+			{
+				Window window;
+
+				int minX = location.x + i * tilePixels.x;
+				int minY = location.y + j * tilePixels.y;
+				int minZ = location.z + k * tilePixels.z;
+				int maxX = std::min(location.x + size.x, location.x + (i + 1) * tilePixels.x);
+				int maxY = std::min(location.y + size.y, location.y + (j + 1) * tilePixels.y);
+				int maxZ = std::min(location.z + size.z, location.z + (k + 1) * tilePixels.z);
+
+				boost::shared_ptr<Box<> > coreBox = boost::make_shared<Box<> >(
+					util::rect<int>(minX, minY, maxX, maxY), minZ, maxZ - minZ);
+
+				// Grow the core by the overlap, without leaving the stack.
+				int windowMinZ = std::max(0, minZ - margin.z);
+				boost::shared_ptr<Box<> > windowBox = boost::make_shared<Box<> >(
+					util::rect<int>(std::max(0, minX - margin.x), std::max(0, minY - margin.y),
+									maxX + margin.x, maxY + margin.y),
+					windowMinZ, maxZ + margin.z - windowMinZ);
+
+				window.core = manager->blocksInBox(coreBox);
+				window.blocks = manager->blocksInBox(windowBox);
+				window.colour = (i % 2) + 2 * (j % 2) + 4 * (k % 2);
+
+				windows.push_back(window);
+			}
+		}
+	}
+
+	return windows;
+}
+
+void
+VolumeSolver::solveWindow(unsigned int i,
+						  const std::vector<Window>& windows,
+						  const boost::shared_ptr<SegmentAssignment>& fixedSegments,
+						  std::vector<boost::shared_ptr<SegmentAssignment> >& results)
+{
+	const Window& window = windows[i];
+	boost::shared_ptr<CoreSolver> coreSolver = boost::make_shared<CoreSolver>();
+	boost::shared_ptr<SegmentAssignment> coreAssignment = boost::make_shared<SegmentAssignment>();
+
+	coreSolver->setInput("blocks", window.blocks);
+	coreSolver->setInput("prior cost parameters", _priorCostFunctionParameters);
+	coreSolver->setInput("segment store", _segmentStore);
+	coreSolver->setInput("slice store", _sliceStore);
+	coreSolver->setInput("raw image factory", _rawImageFactory);
+	coreSolver->setInput("membrane factory", _membraneFactory);
+	coreSolver->setInput("force explanation", _forceExplanation);
+	coreSolver->setInput("fixed segments", fixedSegments);
+	coreSolver->setInput("stack cache", _stackCache);
+
+	if (_segmentationCostFunctionParameters)
+	{
+		coreSolver->setInput("segmentation cost parameters", _segmentationCostFunctionParameters);
+	}
+
+	pipeline::Value<SegmentAssignment> assignment = coreSolver->getOutput("assignment");
+
+	// Keep only the decisions for segments in the core, the ones near the border of the window
+	// are left to the windows that have them in their core.
+	foreach (boost::shared_ptr<Block> block, *window.core)
+	{
+		foreach (boost::shared_ptr<Segment> segment,
+				 _segmentStore->retrieveSegments(block)->getSegments())
+		{
+			if (assignment->contains(segment->getId()))
+			{
+				coreAssignment->set(segment->getId(), assignment->isChosen(segment->getId()));
+			}
+		}
+	}
+
+	LOG_DEBUG(volumesolverlog) << "Window " << i << " decided " << coreAssignment->size() <<
+		" core segments" << std::endl;
+
+	results[i] = coreAssignment;
+}
@@ -0,0 +1,77 @@
+#ifndef VOLUME_SOLVER_H__
+#define VOLUME_SOLVER_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <pipeline/all.h>
+#include <imageprocessing/io/ImageBlockFactory.h>
+#include <sopnet/block/Blocks.h>
+#include <sopnet/inference/PriorCostFunctionParameters.h>
+#include <sopnet/inference/SegmentationCostFunctionParameters.h>
+#include <sopnet/segments/SegmentTrees.h>
+#include <catmaidsopnet/persistence/SegmentStore.h>
+#include <catmaidsopnet/persistence/SliceStore.h>
+#include <catmaidsopnet/ImageStackCache.h>
+#include <catmaidsopnet/SegmentAssignment.h>
+
+/**
+ * Solves a volume that is too large for a single CoreSolver by tiling it into windows.
+ *
+ * The requested Blocks are split into core tiles of a fixed number of blocks, and each tile is
+ * solved by a CoreSolver over the tile grown by an overlap of blocks. The decisions for the
+ * segments of a tile's core are kept, and passed as fixed segments to the windows solved
+ * later, so that the solutions agree where the windows overlap.
+ *
+ * Tiles are coloured by the parity of their grid position. Tiles of the same colour are far
+ * enough apart that their windows do not overlap, so they are solved concurrently, one colour
+ * after the other. The stores have to be safe to share between threads.
+ */
+class VolumeSolver : public pipeline::SimpleProcessNode<>
+{
+	struct Window
+	{
+		boost::shared_ptr<Blocks> core;
+		boost::shared_ptr<Blocks> blocks;
+		unsigned int colour;
+	};
+
+public:
+	/**
+	 * @param tileSize - the size of the core tiles in blocks.
+	 * @param overlap - the number of blocks by which each tile is grown to form its window.
+	 *                  Has to be at most half the tile size for the windows of one colour
+	 *                  not to overlap.
+	 */
+	VolumeSolver(const util::point3<unsigned int>& tileSize = util::point3<unsigned int>(4, 4, 4),
+				 unsigned int overlap = 1);
+
+private:
+	void updateOutputs();
+
+	std::vector<Window> createWindows();
+
+	void solveWindow(unsigned int i,
+					 const std::vector<Window>& windows,
+					 const boost::shared_ptr<SegmentAssignment>& fixedSegments,
+					 std::vector<boost::shared_ptr<SegmentAssignment> >& results);
+
+	pipeline::Input<Blocks> _blocks;
+	pipeline::Input<PriorCostFunctionParameters> _priorCostFunctionParameters;
+	pipeline::Input<SegmentationCostFunctionParameters> _segmentationCostFunctionParameters;
+	pipeline::Input<SegmentStore> _segmentStore;
+	pipeline::Input<SliceStore> _sliceStore;
+	pipeline::Input<ImageBlockFactory> _rawImageFactory;
+	pipeline::Input<ImageBlockFactory> _membraneFactory;
+	pipeline::Input<bool> _forceExplanation;
+
+	pipeline::Output<SegmentTrees> _neurons;
+	pipeline::Output<SegmentAssignment> _assignment;
+
+	util::point3<unsigned int> _tileSize;
+	unsigned int _overlap;
+
+	// Shared by the windows, so that image crops in the overlaps are read once.
+	boost::shared_ptr<ImageStackCache> _stackCache;
+};
+
+#endif //VOLUME_SOLVER_H__
@@ -14,6 +14,8 @@ void
 LocalSegmentStore::associate(const boost::shared_ptr<Segment>& segmentIn,
 							 const boost::shared_ptr<Block>& block)
 {
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
 	boost::shared_ptr<Segment> segment = equivalentSegment(segmentIn);
 
 	mapBlockToSegment(block, segment);
@@ -27,6 +29,8 @@ void
 LocalSegmentStore::disassociate(const boost::shared_ptr<Segment>& segment,
 								const boost::shared_ptr<Block>& block)
 {
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
 	if (_segmentBlockMap->count(segment))
 	{
 		(*_segmentBlockMap)[segment]->remove(block);
@@ -51,6 +55,8 @@ LocalSegmentStore::disassociate(const boost::shared_ptr<Segment>& segment,
 boost::shared_ptr<Blocks>
 LocalSegmentStore::getAssociatedBlocks(const boost::shared_ptr<Segment>& segment)
 {
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
 	boost::shared_ptr<Blocks> blocks = boost::make_shared<Blocks>();
 	
 	if (_segmentBlockMap->count(segment))
@@ -64,17 +70,78 @@ LocalSegmentStore::getAssociatedBlocks(const boost::shared_ptr<Segment>& segment
 void
 LocalSegmentStore::removeSegment(const boost::shared_ptr<Segment>& segment)
 {
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
 	boost::shared_ptr<Blocks> blocks = getAssociatedBlocks(segment);
 	
+	_featuresMap.erase(equivalentSegment(segment)->getId());
+	
 	foreach (boost::shared_ptr<Block> block, *blocks)
 	{
 		disassociate(segment, block);
 	}
 }
 
+void
+LocalSegmentStore::storeFeatures(const boost::shared_ptr<Segments>& segments,
+								 const boost::shared_ptr<Features>& features)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	if (_featureNames.empty())
+	{
+		_featureNames = features->getNames();
+	}
+	else if (_featureNames != features->getNames())
+	{
+		// Features from a differently configured extractor, the stored ones are stale.
+		LOG_DEBUG(localsegmentstorelog) << "Feature names changed, dropping " <<
+			_featuresMap.size() << " stored feature vectors" << std::endl;
+		_featuresMap.clear();
+		_featureNames = features->getNames();
+	}
+	
+	foreach (boost::shared_ptr<Segment> segment, segments->getSegments())
+	{
+		_featuresMap[equivalentSegment(segment)->getId()] = features->get(segment->getId());
+	}
+}
+
+boost::shared_ptr<Features>
+LocalSegmentStore::retrieveFeatures(const boost::shared_ptr<Segments>& segments,
+									const boost::shared_ptr<Segments>& missing)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	boost::shared_ptr<Features> features = boost::make_shared<Features>();
+	
+	foreach (const std::string& name, _featureNames)
+	{
+		features->addName(name);
+	}
+	
+	foreach (boost::shared_ptr<Segment> segment, segments->getSegments())
+	{
+		IdFeaturesMap::iterator it = _featuresMap.find(equivalentSegment(segment)->getId());
+		
+		if (it == _featuresMap.end())
+		{
+			missing->add(segment);
+		}
+		else
+		{
+			features->add(segment->getId(), it->second);
+		}
+	}
+	
+	return features;
+}
+
 boost::shared_ptr<Segments>
 LocalSegmentStore::retrieveSegments(const boost::shared_ptr<Block>& block)
 {
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
 	boost::shared_ptr<Segments> segments = boost::make_shared<Segments>();
 	
 	if (_blockSegmentMap->count(*block))
@@ -5,6 +5,7 @@
 #include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 #include <sopnet/segments/Segment.h>
 #include <sopnet/segments/Segments.h>
 #include <sopnet/block/Block.h>
@@ -18,6 +19,7 @@ class LocalSegmentStore : public SegmentStore
 		SegmentPointerHash, SegmentPointerEquals > SegmentBlockMap;
 	typedef boost::unordered_map<Block, boost::shared_ptr<Segments> > BlockSegmentMap;
 	typedef boost::unordered_map<unsigned int, boost::shared_ptr<Segment> > IdSegmentMap;
+	typedef boost::unordered_map<unsigned int, std::vector<double> > IdFeaturesMap;
 	
 public:
 	LocalSegmentStore();
@@ -42,6 +44,12 @@ public:
 
 	boost::shared_ptr<Blocks> getAssociatedBlocks(const boost::shared_ptr<Segment>& segment);
 	
+	void storeFeatures(const boost::shared_ptr<Segments>& segments,
+					   const boost::shared_ptr<Features>& features);
+	
+	boost::shared_ptr<Features> retrieveFeatures(const boost::shared_ptr<Segments>& segments,
+												 const boost::shared_ptr<Segments>& missing);
+	
 private:
 	void mapSegmentToBlock(const boost::shared_ptr<Segment>& segment,
 						   const boost::shared_ptr<Block>& block);
@@ -62,6 +70,13 @@ private:
 	boost::shared_ptr<IdSegmentMap> _idSegmentMap;
 	
 	SegmentSet _segmentMasterList;
+	
+	// Features by canonical segment id, and their names.
+	IdFeaturesMap _featuresMap;
+	std::vector<std::string> _featureNames;
+	
+	// Guards all of the above, the store may be shared between threads.
+	boost::recursive_mutex _mutex;
 
 };
 
@@ -1,27 +1,109 @@
 #include "LocalSliceStore.h"
 #include <boost/make_shared.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
 #include <set>
+#include <sstream>
 #include <utility>
 
+#include <imageprocessing/ConnectedComponent.h>
+#include <util/exceptions.h>
 #include <util/Logger.h>
 logger::LogChannel localslicestorelog("localslicestorelog", "[LocalSliceStore] ");
 
-LocalSliceStore::LocalSliceStore()
+template <typename T>
+static void
+writeValue(std::ostream& file, const T& value)
 {
-	_sliceBlockMap = boost::make_shared<SliceBlockMap>();
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static T
+readValue(std::fstream& file)
+{
+	T value;
+	file.read(reinterpret_cast<char*>(&value), sizeof(T));
+	return value;
+}
+
+/**
+ * Throw if the last operation on the spill file failed. The state is reset first, so that the
+ * store can still be used for other blocks.
+ */
+static void
+checkSpillFile(std::fstream& file, const std::string& path)
+{
+	if (!file)
+	{
+		file.clear();
+		BOOST_THROW_EXCEPTION(IOError() << error_message("could not access spill file " + path));
+	}
+}
+
+LocalSliceStore::LocalSliceStore(std::size_t memoryBudget, const std::string& spillPath) :
+	_memoryBudget(memoryBudget),
+	_residentBytes(0),
+	_spillPath(spillPath),
+	_removeSpillFile(spillPath.empty()),
+	_spillEnd(0)
+{
+	_sliceBlockMap = boost::make_shared<IdBlocksMap>();
 	_blockSliceMap = boost::make_shared<BlockSliceMap>();
 	_idSliceMap = boost::make_shared<IdSliceMap>();
-	_parentChildrenMap = boost::make_shared<SliceSlicesMap>();
-	_childParentMap = boost::make_shared<SliceSliceMap>();
+	_parentChildrenMap = boost::make_shared<IdIdsMap>();
+	_childParentMap = boost::make_shared<IdIdMap>();
+
+	if (_spillPath.empty())
+	{
+		_spillPath = (boost::filesystem::temp_directory_path() /
+			boost::filesystem::unique_path("localslicestore-%%%%-%%%%-%%%%.spill")).string();
+	}
+}
+
+LocalSliceStore::~LocalSliceStore()
+{
+	if (_spillFile.is_open())
+	{
+		_spillFile.close();
+
+		if (_removeSpillFile)
+		{
+			boost::system::error_code ec;
+			boost::filesystem::remove(_spillPath, ec);
+		}
+	}
 }
 
 
 boost::shared_ptr<Blocks>
 LocalSliceStore::getAssociatedBlocks(const boost::shared_ptr< Slice >& slice)
 {
-	if (_sliceBlockMap->count(*slice))
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	unsigned int id;
+
+	if (lookupId(slice, id))
+	{
+		return getAssociatedBlocks(id);
+	}
+	else
+	{
+		boost::shared_ptr<Blocks> empty = boost::make_shared<Blocks>();
+		return empty;
+	}
+}
+
+boost::shared_ptr<Blocks>
+LocalSliceStore::getAssociatedBlocks(unsigned int sliceId)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	unsigned int id = canonicalId(sliceId);
+
+	if (storedSlice(id) && _sliceBlockMap->count(id))
 	{
-		return (*_sliceBlockMap)[*slice];
+		return (*_sliceBlockMap)[id];
 	}
 	else
 	{
@@ -33,114 +115,219 @@ LocalSliceStore::getAssociatedBlocks(const boost::shared_ptr< Slice >& slice)
 void
 LocalSliceStore::removeSlice(const boost::shared_ptr< Slice >& slice)
 {
-	boost::shared_ptr<Blocks> blocks = getAssociatedBlocks(slice);
+	boost::recursive_mutex::scoped_lock lock(_mutex);
 	
-	foreach (boost::shared_ptr<Block> block, *blocks)
+	unsigned int id;
+
+	if (!lookupId(slice, id))
 	{
-		(*_blockSliceMap)[*block]->remove(slice);
+		return;
 	}
-	
-	_sliceBlockMap->erase(*slice);
-	_sliceMasterList.erase(*slice);
+
+	boost::shared_ptr<StoredSlice> stored = storedSlice(id);
+
+	removeFromConflictSets(id);
+
+	if (_sliceBlockMap->count(id))
+	{
+		boost::shared_ptr<Blocks> blocks = (*_sliceBlockMap)[id];
+
+		foreach (boost::shared_ptr<Block> block, *blocks)
+		{
+			touch(block);
+
+			if (_blockSliceMap->count(*block))
+			{
+				removeId((*_blockSliceMap)[*block], id);
+
+				if ((*_blockSliceMap)[*block].empty())
+				{
+					_blockSliceMap->erase(*block);
+				}
+			}
+		}
+	}
+
+	// Unlink the slice from the hierarchy. Links held by spilled slices are filtered when they
+	// are paged back in.
+	if (_childParentMap->count(id))
+	{
+		unsigned int parentId = (*_childParentMap)[id];
+
+		if (_parentChildrenMap->count(parentId))
+		{
+			removeId((*_parentChildrenMap)[parentId], id);
+		}
+	}
+
+	if (_parentChildrenMap->count(id))
+	{
+		foreach (unsigned int childId, (*_parentChildrenMap)[id])
+		{
+			_childParentMap->erase(childId);
+		}
+	}
+
+	dropSlice(id);
+
+	if (_sliceMasterList.count(stored->hash))
+	{
+		removeId(_sliceMasterList[stored->hash], id);
+
+		if (_sliceMasterList[stored->hash].empty())
+		{
+			_sliceMasterList.erase(stored->hash);
+		}
+	}
+
+	if (_canonicalAliasMap.count(id))
+	{
+		foreach (unsigned int alias, _canonicalAliasMap[id])
+		{
+			_aliasMap.erase(alias);
+		}
+
+		_canonicalAliasMap.erase(id);
+	}
+
+	enforceBudget();
 }
 
 void
 LocalSliceStore::disassociate(const boost::shared_ptr< Slice >& slice, const boost::shared_ptr<Block>& block)
 {
-	if (_sliceBlockMap->count(*slice))
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	unsigned int id;
+
+	if (!lookupId(slice, id))
+	{
+		return;
+	}
+
+	storedSlice(id);
+	touch(block);
+
+	if (_sliceBlockMap->count(id))
 	{
-		(*_sliceBlockMap)[*slice]->remove(block);
-		
-		if ((*_sliceBlockMap)[*slice]->length() == 0)
+		(*_sliceBlockMap)[id]->remove(block);
+
+		if ((*_sliceBlockMap)[id]->length() == 0)
 		{
-			_sliceBlockMap->erase(*slice);
+			_sliceBlockMap->erase(id);
 		}
 	}
-	
+
 	if (_blockSliceMap->count(*block))
 	{
-		(*_blockSliceMap)[*block]->remove(slice);
-		
-		if ((*_blockSliceMap)[*block]->size() == 0)
+		removeId((*_blockSliceMap)[*block], id);
+
+		if ((*_blockSliceMap)[*block].empty())
 		{
 			_blockSliceMap->erase(*block);
 		}
 	}
+
+	enforceBudget();
 }
 
 boost::shared_ptr<Slices>
 LocalSliceStore::retrieveSlices(const boost::shared_ptr<Block>& block)
 {
-	boost::shared_ptr<Slices> slices = boost::make_shared<Slices>();;
+	boost::recursive_mutex::scoped_lock lock(_mutex);
 	
+	boost::shared_ptr<Slices> slices = boost::make_shared<Slices>();;
+
 	LOG_DEBUG(localslicestorelog) << "Retrieving slices for block at " << block->location() << std::endl;
-	
+
+	touch(block);
+
 	if (_blockSliceMap->count(*block))
 	{
 		LOG_DEBUG(localslicestorelog) << "Found block in block slice map" << std::endl;
-		boost::shared_ptr<Slices> blockSlices = (*_blockSliceMap)[*block];
-		slices->addAll(*blockSlices);
+
+		foreach (unsigned int id, (*_blockSliceMap)[*block])
+		{
+			slices->add(residentSlice(id));
+		}
 	}
 
+	enforceBudget();
+
 	return slices;
 }
 
-void
-LocalSliceStore::mapBlockToSlice(const boost::shared_ptr< Block >& block, const boost::shared_ptr< Slice >& slice)
+std::vector<unsigned int>
+LocalSliceStore::retrieveSliceIds(const boost::shared_ptr<Block>& block)
 {
-	// Place entry in block slice map
-	boost::shared_ptr<Slices> slices;
+	boost::recursive_mutex::scoped_lock lock(_mutex);
 	
-	if (_blockSliceMap->count(*block))
+	std::vector<unsigned int> ids;
+	BlockSliceMap::const_iterator resident = _blockSliceMap->find(*block);
+	BlockRecordMap::const_iterator spilled = _spilledBlockMap.find(*block);
+
+	if (resident != _blockSliceMap->end())
 	{
-		slices = (*_blockSliceMap)[*block];
+		ids = resident->second;
 	}
-	else
+	else if (spilled != _spilledBlockMap.end())
 	{
-		slices = boost::make_shared<Slices>();
-		(*_blockSliceMap)[*block] = slices;
-	}
-	
-	foreach (boost::shared_ptr<Slice> cSlice, *slices)
-	{
-		if (*cSlice == *slice)
+		// Slices removed while the block was spilled are still in its record.
+		foreach (unsigned int id, spilled->second.ids)
 		{
-			LOG_DEBUG(localslicestorelog) << "BlockSliceMap already links Block " <<
-				block->getId() << " to slice " << slice->getId() << std::endl;
-			return;
+			if (isKnown(id))
+			{
+				ids.push_back(id);
+			}
 		}
 	}
-	
-	slices->add(slice);
+
+	return ids;
 }
 
 void
-LocalSliceStore::mapSliceToBlock(const boost::shared_ptr< Slice >& slice, const boost::shared_ptr< Block >& block)
+LocalSliceStore::mapBlockToSlice(const boost::shared_ptr< Block >& block, unsigned int id)
+{
+	// Place entry in block slice map
+	std::vector<unsigned int>& ids = (*_blockSliceMap)[*block];
+
+	if (std::find(ids.begin(), ids.end(), id) != ids.end())
+	{
+		LOG_DEBUG(localslicestorelog) << "BlockSliceMap already links Block " <<
+			block->getId() << " to slice " << id << std::endl;
+		return;
+	}
+
+	ids.push_back(id);
+}
+
+void
+LocalSliceStore::mapSliceToBlock(unsigned int id, const boost::shared_ptr< Block >& block)
 {
 	// Place entry in slice block map
 	boost::shared_ptr<Blocks> blocks;
-	
-	if (_sliceBlockMap->count(*slice))
+
+	if (_sliceBlockMap->count(id))
 	{
-		blocks = (*_sliceBlockMap)[*slice];
+		blocks = (*_sliceBlockMap)[id];
 	}
 	else
 	{
 		blocks = boost::make_shared<Blocks>();
-		(*_sliceBlockMap)[*slice] = blocks;
+		(*_sliceBlockMap)[id] = blocks;
 	}
-	
+
 	foreach (boost::shared_ptr<Block> cBlock, *blocks)
 	{
 		if (*block == *cBlock)
 		{
 			LOG_DEBUG(localslicestorelog) << "SliceBlockMap already links slice " <<
-				slice->getId() << " to block " << block->getId() << std::endl;
+				id << " to block " << block->getId() << std::endl;
 			return;
 		}
-		
+
 	}
-	
+
 	blocks->add(block);
 }
 
@@ -148,105 +335,788 @@ void
 LocalSliceStore::associate(const boost::shared_ptr< Slice >& sliceIn,
 							const boost::shared_ptr< Block >& block)
 {
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
 	LOG_ALL(localslicestorelog) << "Got a slice with " <<
 		sliceIn->getComponent()->getSize() << " pixels." << std::endl;
 
-	boost::shared_ptr<Slice> slice = equivalentSlice(sliceIn);
+	unsigned int id;
+
+	touch(block);
+	_idBlockMap[block->getId()] = block;
+
+	if (lookupId(sliceIn, id))
+	{
+		if (sliceIn->getId() != id && !_aliasMap.count(sliceIn->getId()))
+		{
+			_aliasMap[sliceIn->getId()] = id;
+			_canonicalAliasMap[id].push_back(sliceIn->getId());
+		}
+	}
+	else
+	{
+		boost::shared_ptr<StoredSlice> stored = boost::make_shared<StoredSlice>(
+			sliceIn->getId(), sliceIn->getSection(), sliceIn->hashValue(),
+			RunLengthComponent(*sliceIn->getComponent()));
+
+		id = stored->id;
+		stored->slice = sliceIn;
+
+		(*_idSliceMap)[id] = stored;
+		_sliceMasterList[stored->hash].push_back(id);
+		_residentBytes += sliceBytes(*stored);
+	}
+
+	mapBlockToSlice(block, id);
+	mapSliceToBlock(id, block);
+
+	enforceBudget();
+}
+
+void
+LocalSliceStore::setParent(const boost::shared_ptr<Slice>& childSlice,
+						   const boost::shared_ptr<Slice>& parentSlice)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
 	
-	mapBlockToSlice(block, slice);
-	mapSliceToBlock(slice, block);
+	unsigned int childId, parentId;
+
+	if (!lookupId(childSlice, childId) || !lookupId(parentSlice, parentId))
+	{
+		LOG_DEBUG(localslicestorelog) << "Cannot set parent of slice " << childSlice->getId() <<
+			" to " << parentSlice->getId() << ", both must be associated first" << std::endl;
+		return;
+	}
+
+	// Hierarchy entries of spilled slices live in the spill file.
+	storedSlice(childId);
+	storedSlice(parentId);
+
+	if (_childParentMap->count(childId))
+	{
+		unsigned int oldParentId = (*_childParentMap)[childId];
+
+		if (oldParentId != parentId && _parentChildrenMap->count(oldParentId))
+		{
+			removeId((*_parentChildrenMap)[oldParentId], childId);
+		}
+	}
+
+	std::vector<unsigned int>& children = (*_parentChildrenMap)[parentId];
+
+	if (std::find(children.begin(), children.end(), childId) == children.end())
+	{
+		children.push_back(childId);
+	}
+
+	(*_childParentMap)[childId] = parentId;
+
+	enforceBudget();
+}
+
+boost::shared_ptr<Slices>
+LocalSliceStore::getChildren(const boost::shared_ptr<Slice>& parentSlice)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
 	
-	if (_sliceMasterList.count(*slice))
+	boost::shared_ptr<Slices> children = boost::make_shared<Slices>();
+	unsigned int parentId;
+
+	if (lookupId(parentSlice, parentId) && storedSlice(parentId) &&
+		_parentChildrenMap->count(parentId))
 	{
-		unsigned int existingId = _sliceMasterList.find(*slice)->getId();
-		(*_idSliceMap)[slice->getId()] = (*_idSliceMap)[existingId];
+		// Copy, since paging in children modifies the hierarchy maps.
+		std::vector<unsigned int> childIds = (*_parentChildrenMap)[parentId];
+
+		foreach (unsigned int childId, childIds)
+		{
+			boost::shared_ptr<Slice> childSlice = residentSlice(childId);
+
+			if (childSlice)
+			{
+				children->add(childSlice);
+			}
+		}
 	}
-	else
+
+	enforceBudget();
+
+	return children;
+}
+
+boost::shared_ptr<Slice>
+LocalSliceStore::getParent(const boost::shared_ptr< Slice >& childSlice)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	boost::shared_ptr<Slice> parentSlice;
+	unsigned int childId;
+
+	if (lookupId(childSlice, childId) && storedSlice(childId) &&
+		_childParentMap->count(childId))
+	{
+		parentSlice = residentSlice((*_childParentMap)[childId]);
+	}
+
+	enforceBudget();
+
+	return parentSlice;
+}
+
+void
+LocalSliceStore::associateConflictSet(const ConflictSet& conflictSet,
+									  const boost::shared_ptr<Block>& block)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	std::vector<unsigned int> clique;
+
+	foreach (unsigned int id, conflictSet.getSlices())
+	{
+		clique.push_back(canonicalId(id));
+	}
+
+	std::sort(clique.begin(), clique.end());
+	clique.erase(std::unique(clique.begin(), clique.end()), clique.end());
+
+	_blockConflictMap[*block].insert(clique);
+}
+
+boost::shared_ptr<ConflictSets>
+LocalSliceStore::retrieveConflictSets(const boost::shared_ptr<Block>& block)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	boost::shared_ptr<ConflictSets> conflictSets = boost::make_shared<ConflictSets>();
+	BlockConflictMap::const_iterator it = _blockConflictMap.find(*block);
+
+	if (it == _blockConflictMap.end())
+	{
+		return conflictSets;
+	}
+
+	foreach (const std::vector<unsigned int>& clique, it->second)
+	{
+		ConflictSet conflictSet;
+
+		// Slices may have been merged into an equivalent one, or removed, since the
+		// conflict set was stored.
+		foreach (unsigned int id, clique)
+		{
+			unsigned int cid = canonicalId(id);
+
+			if (isKnown(cid))
+			{
+				conflictSet.addSlice(cid);
+			}
+		}
+
+		if (!conflictSet.getSlices().empty())
+		{
+			conflictSets->add(conflictSet);
+		}
+	}
+
+	LOG_DEBUG(localslicestorelog) << "Retrieved " << conflictSets->size() <<
+		" conflict sets for block " << block->getId() << std::endl;
+
+	return conflictSets;
+}
+
+bool
+LocalSliceStore::lookupId(const boost::shared_ptr<Slice>& slice, unsigned int& id)
+{
+	unsigned int cid = canonicalId(slice->getId());
+
+	if (isKnown(cid))
+	{
+		id = cid;
+		return true;
+	}
+
+	HashIdsMap::const_iterator it = _sliceMasterList.find(slice->hashValue());
+
+	if (it != _sliceMasterList.end())
+	{
+		// Copy, since paging in candidates may modify the master list.
+		std::vector<unsigned int> candidates = it->second;
+		RunLengthComponent component(*slice->getComponent());
+
+		foreach (unsigned int candidate, candidates)
+		{
+			boost::shared_ptr<StoredSlice> stored = storedSlice(candidate);
+
+			if (stored && stored->section == slice->getSection() &&
+				stored->component == component)
+			{
+				id = candidate;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+unsigned int
+LocalSliceStore::canonicalId(unsigned int id) const
+{
+	IdIdMap::const_iterator it = _aliasMap.find(id);
+	return it == _aliasMap.end() ? id : it->second;
+}
+
+bool
+LocalSliceStore::isKnown(unsigned int id) const
+{
+	return _idSliceMap->count(id) || _spilledSliceMap.count(id);
+}
+
+boost::shared_ptr<LocalSliceStore::StoredSlice>
+LocalSliceStore::storedSlice(unsigned int id)
+{
+	if (!_idSliceMap->count(id) && _spilledSliceMap.count(id))
 	{
-		(*_idSliceMap)[slice->getId()] = slice;
-		_sliceMasterList.insert(*slice);
+		pageIn(_spilledSliceMap[id]);
 	}
+
+	IdSliceMap::const_iterator it = _idSliceMap->find(id);
+	return it == _idSliceMap->end() ? boost::shared_ptr<StoredSlice>() : it->second;
 }
 
 boost::shared_ptr<Slice>
-LocalSliceStore::equivalentSlice(const boost::shared_ptr<Slice>& slice)
+LocalSliceStore::residentSlice(unsigned int id)
+{
+	boost::shared_ptr<StoredSlice> stored = storedSlice(id);
+
+	if (!stored)
+	{
+		return boost::shared_ptr<Slice>();
+	}
+
+	boost::shared_ptr<Slice> slice = stored->slice.lock();
+
+	if (!slice)
+	{
+		slice = boost::make_shared<Slice>(stored->id, stored->section,
+										  stored->component.toConnectedComponent());
+		stored->slice = slice;
+	}
+
+	return slice;
+}
+
+void
+LocalSliceStore::touch(const boost::shared_ptr<Block>& block)
 {
-	if (_sliceMasterList.count(*slice))
+	if (_memoryBudget == 0)
+	{
+		return;
+	}
+
+	if (!isResident(*block))
+	{
+		pageIn(block);
+	}
+	else if (_lruMap.count(*block))
 	{
-		unsigned int id = _sliceMasterList.find(*slice)->getId();
-		boost::shared_ptr<Slice> eqSlice = (*_idSliceMap)[id];
-		return eqSlice;
+		_lruBlocks.splice(_lruBlocks.begin(), _lruBlocks, _lruMap[*block]);
 	}
 	else
 	{
-		return slice;
+		_lruBlocks.push_front(block);
+		_lruMap[*block] = _lruBlocks.begin();
 	}
 }
 
+bool
+LocalSliceStore::isResident(const Block& block) const
+{
+	return !_spilledBlockMap.count(block);
+}
+
 void
-LocalSliceStore::setParent(const boost::shared_ptr<Slice>& childSlice,
-						   const boost::shared_ptr<Slice>& parentSlice)
+LocalSliceStore::enforceBudget()
 {
-	if (! _parentChildrenMap->count(*parentSlice))
+	if (_memoryBudget == 0)
 	{
-		(*_parentChildrenMap)[*parentSlice] = boost::make_shared<Slices>();
+		return;
+	}
+
+	// Always keep the most recently used block in memory.
+	while (_residentBytes > _memoryBudget && _lruBlocks.size() > 1)
+	{
+		spill(_lruBlocks.back());
 	}
-	
-	(*_parentChildrenMap)[*parentSlice]->add(childSlice);
-	(*_childParentMap)[*childSlice] = parentSlice;
 }
 
-boost::shared_ptr<Slices>
-LocalSliceStore::getChildren(const boost::shared_ptr<Slice>& parentSlice)
+/**
+ * Write the slices of the given block, along with their block associations and hierarchy, to
+ * the spill file, then drop every slice that is not held by another resident block.
+ *
+ * Record layout: block id, slice count, then for each slice its id, section, hash, value, run
+ * count, runs, associated block ids, parent id (if any) and child ids.
+ */
+void
+LocalSliceStore::spill(const boost::shared_ptr<Block>& block)
 {
-	if (_parentChildrenMap->count(*parentSlice))
+	_lruBlocks.erase(_lruMap[*block]);
+	_lruMap.erase(*block);
+
+	if (!_blockSliceMap->count(*block))
 	{
-		return (*_parentChildrenMap)[*parentSlice];
+		return;
 	}
-	else
+
+	if (!_spillFile.is_open())
+	{
+		_spillFile.open(_spillPath.c_str(),
+						std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+		if (!_spillFile.is_open())
+		{
+			BOOST_THROW_EXCEPTION(IOError() << error_message("could not open spill file " +
+				_spillPath));
+		}
+	}
+
+	std::vector<unsigned int> ids = (*_blockSliceMap)[*block];
+
+	LOG_DEBUG(localslicestorelog) << "Spilling " << ids.size() << " slices of block " <<
+		block->getId() << std::endl;
+
+	std::ostringstream record;
+
+	writeValue(record, static_cast<unsigned int>(block->getId()));
+	writeValue(record, static_cast<unsigned int>(ids.size()));
+
+	foreach (unsigned int id, ids)
 	{
-		boost::shared_ptr<Slices> emptySlices = boost::make_shared<Slices>();
-		return emptySlices;
+		const StoredSlice& stored = *(*_idSliceMap)[id];
+
+		writeValue(record, id);
+		writeValue(record, stored.section);
+		writeValue(record, stored.hash);
+		writeValue(record, stored.component.getValue());
+		writeValue(record, static_cast<unsigned int>(stored.component.getRuns().size()));
+
+		foreach (const RunLengthComponent::Run& run, stored.component.getRuns())
+		{
+			writeValue(record, run);
+		}
+
+		boost::shared_ptr<Blocks> sliceBlocks = _sliceBlockMap->count(id) ?
+			(*_sliceBlockMap)[id] : boost::make_shared<Blocks>();
+		writeValue(record, static_cast<unsigned int>(sliceBlocks->length()));
+		foreach (boost::shared_ptr<Block> sliceBlock, *sliceBlocks)
+		{
+			writeValue(record, static_cast<unsigned int>(sliceBlock->getId()));
+		}
+
+		bool hasParent = _childParentMap->count(id);
+		writeValue(record, hasParent);
+		if (hasParent)
+		{
+			writeValue(record, (*_childParentMap)[id]);
+		}
+
+		std::vector<unsigned int> childIds;
+		if (_parentChildrenMap->count(id))
+		{
+			childIds = (*_parentChildrenMap)[id];
+		}
+		writeValue(record, static_cast<unsigned int>(childIds.size()));
+		foreach (unsigned int childId, childIds)
+		{
+			writeValue(record, childId);
+		}
+	}
+
+	std::string data = record.str();
+	SpillRecord spillRecord;
+
+	spillRecord.size = data.size();
+	spillRecord.offset = allocateRecord(data.size());
+	spillRecord.ids = ids;
+
+	_spillFile.seekp(spillRecord.offset);
+	_spillFile.write(data.data(), data.size());
+	_spillFile.flush();
+
+	checkSpillFile(_spillFile, _spillPath);
+
+	_spilledBlockMap[*block] = spillRecord;
+	_blockSliceMap->erase(*block);
+
+	foreach (unsigned int id, ids)
+	{
+		bool held = false;
+
+		if (_sliceBlockMap->count(id))
+		{
+			foreach (boost::shared_ptr<Block> sliceBlock, *(*_sliceBlockMap)[id])
+			{
+				held = held || _blockSliceMap->count(*sliceBlock);
+			}
+		}
+
+		if (!held)
+		{
+			dropSlice(id);
+			_spilledSliceMap[id] = block;
+		}
 	}
 }
 
-boost::shared_ptr<Slice>
-LocalSliceStore::getParent(const boost::shared_ptr< Slice >& childSlice)
+/**
+ * Read the record of a spilled block back into memory. Slices whose authoritative record is
+ * held by another spilled block are paged in through that block.
+ */
+void
+LocalSliceStore::pageIn(const boost::shared_ptr<Block>& block)
 {
-	if (_childParentMap->count(*childSlice))
+	std::vector<unsigned int> ids;
+	std::vector<unsigned int> pending;
+	SpillRecord record = _spilledBlockMap[*block];
+
+	_spilledBlockMap.erase(*block);
+
+	_lruBlocks.push_front(block);
+	_lruMap[*block] = _lruBlocks.begin();
+
+	_spillFile.seekg(record.offset);
+
+	readValue<unsigned int>(_spillFile);
+	unsigned int count = readValue<unsigned int>(_spillFile);
+
+	checkSpillFile(_spillFile, _spillPath);
+
+	LOG_DEBUG(localslicestorelog) << "Paging in " << count << " slices of block " <<
+		block->getId() << std::endl;
+
+	for (unsigned int i = 0; i < count; ++i)
 	{
-		return (*_childParentMap)[*childSlice];
+		unsigned int id = readValue<unsigned int>(_spillFile);
+		unsigned int section = readValue<unsigned int>(_spillFile);
+		std::size_t hash = readValue<std::size_t>(_spillFile);
+		double value = readValue<double>(_spillFile);
+
+		std::vector<RunLengthComponent::Run> runs(readValue<unsigned int>(_spillFile));
+		for (unsigned int j = 0; j < runs.size(); ++j)
+		{
+			runs[j] = readValue<RunLengthComponent::Run>(_spillFile);
+		}
+
+		std::vector<unsigned int> blockIds(readValue<unsigned int>(_spillFile));
+		for (unsigned int j = 0; j < blockIds.size(); ++j)
+		{
+			blockIds[j] = readValue<unsigned int>(_spillFile);
+		}
+
+		bool hasParent = readValue<bool>(_spillFile);
+		unsigned int parentId = hasParent ? readValue<unsigned int>(_spillFile) : 0;
+
+		std::vector<unsigned int> childIds(readValue<unsigned int>(_spillFile));
+		for (unsigned int j = 0; j < childIds.size(); ++j)
+		{
+			childIds[j] = readValue<unsigned int>(_spillFile);
+		}
+
+		// Nothing of a truncated record is used.
+		checkSpillFile(_spillFile, _spillPath);
+
+		if (_idSliceMap->count(id))
+		{
+			// Still resident through another block.
+			ids.push_back(id);
+		}
+		else if (_spilledSliceMap.count(id) && *_spilledSliceMap[id] != *block)
+		{
+			// The slice was dropped when another block was spilled, so that record is the
+			// up-to-date one.
+			pending.push_back(id);
+		}
+		else if (_spilledSliceMap.count(id))
+		{
+			boost::shared_ptr<StoredSlice> stored = boost::make_shared<StoredSlice>(
+				id, section, hash, RunLengthComponent(value, runs));
+			boost::shared_ptr<Blocks> sliceBlocks = boost::make_shared<Blocks>();
+
+			foreach (unsigned int blockId, blockIds)
+			{
+				if (_idBlockMap.count(blockId))
+				{
+					sliceBlocks->add(_idBlockMap[blockId]);
+				}
+			}
+
+			_spilledSliceMap.erase(id);
+			(*_idSliceMap)[id] = stored;
+			(*_sliceBlockMap)[id] = sliceBlocks;
+			_residentBytes += sliceBytes(*stored);
+
+			if (hasParent && isKnown(parentId))
+			{
+				(*_childParentMap)[id] = parentId;
+			}
+
+			foreach (unsigned int childId, childIds)
+			{
+				// Children that were removed while this slice was spilled are skipped.
+				if (isKnown(childId))
+				{
+					(*_parentChildrenMap)[id].push_back(childId);
+				}
+			}
+
+			ids.push_back(id);
+		}
+		// Otherwise, the slice was removed while it was spilled.
+	}
+
+	releaseRecord(record);
+
+	// Mark the block resident before paging in the others, so that their slices stay with it.
+	if (!ids.empty())
+	{
+		(*_blockSliceMap)[*block] = ids;
+	}
+
+	foreach (unsigned int id, pending)
+	{
+		if (storedSlice(id))
+		{
+			(*_blockSliceMap)[*block].push_back(id);
+		}
+	}
+}
+
+std::streamoff
+LocalSliceStore::allocateRecord(std::size_t size)
+{
+	// First fit, the remainder of the extent stays free.
+	for (FreeExtentMap::iterator it = _freeExtents.begin(); it != _freeExtents.end(); ++it)
+	{
+		if (it->second >= size)
+		{
+			std::streamoff offset = it->first;
+			std::size_t remainder = it->second - size;
+
+			_freeExtents.erase(it);
+
+			if (remainder > 0)
+			{
+				_freeExtents[offset + size] = remainder;
+			}
+
+			return offset;
+		}
+	}
+
+	std::streamoff offset = _spillEnd;
+	_spillEnd += size;
+
+	return offset;
+}
+
+void
+LocalSliceStore::releaseRecord(const SpillRecord& record)
+{
+	std::streamoff offset = record.offset;
+	std::size_t size = record.size;
+
+	// Merge with the free neighbours.
+	FreeExtentMap::iterator next = _freeExtents.lower_bound(offset);
+
+	if (next != _freeExtents.end() && next->first == offset + static_cast<std::streamoff>(size))
+	{
+		size += next->second;
+		_freeExtents.erase(next);
+	}
+
+	FreeExtentMap::iterator previous = _freeExtents.lower_bound(offset);
+
+	if (previous != _freeExtents.begin())
+	{
+		--previous;
+
+		if (previous->first + static_cast<std::streamoff>(previous->second) == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			_freeExtents.erase(previous);
+		}
+	}
+
+	if (offset + static_cast<std::streamoff>(size) == _spillEnd)
+	{
+		// The tail is overwritten by the next records.
+		_spillEnd = offset;
 	}
 	else
 	{
-		return boost::shared_ptr<Slice>();
+		_freeExtents[offset] = size;
+	}
+}
+
+void
+LocalSliceStore::dropSlice(unsigned int id)
+{
+	if (_idSliceMap->count(id))
+	{
+		_residentBytes -= sliceBytes(*(*_idSliceMap)[id]);
 	}
+
+	_idSliceMap->erase(id);
+	_sliceBlockMap->erase(id);
+	_childParentMap->erase(id);
+	_parentChildrenMap->erase(id);
+	_spilledSliceMap.erase(id);
+}
+
+void
+LocalSliceStore::removeFromConflictSets(unsigned int id)
+{
+	// The cliques are the same in every block they are stored with.
+	std::set<std::vector<unsigned int> > cliques;
+	std::vector<boost::shared_ptr<Block> > blocks;
+	boost::unordered_set<unsigned int> blockIds;
+
+	if (!_sliceBlockMap->count(id))
+	{
+		return;
+	}
+
+	foreach (boost::shared_ptr<Block> block, *(*_sliceBlockMap)[id])
+	{
+		BlockConflictMap::const_iterator it = _blockConflictMap.find(*block);
+
+		if (blockIds.insert(block->getId()).second)
+		{
+			blocks.push_back(block);
+		}
+
+		if (it == _blockConflictMap.end())
+		{
+			continue;
+		}
+
+		foreach (const std::vector<unsigned int>& clique, it->second)
+		{
+			foreach (unsigned int member, clique)
+			{
+				if (canonicalId(member) == id)
+				{
+					cliques.insert(clique);
+					break;
+				}
+			}
+		}
+	}
+
+	// A clique is stored with every block of its slices, not only with those of this one.
+	foreach (const std::vector<unsigned int>& clique, cliques)
+	{
+		foreach (unsigned int member, clique)
+		{
+			unsigned int memberId = canonicalId(member);
+
+			if (memberId == id || !storedSlice(memberId) || !_sliceBlockMap->count(memberId))
+			{
+				continue;
+			}
+
+			foreach (boost::shared_ptr<Block> block, *(*_sliceBlockMap)[memberId])
+			{
+				if (blockIds.insert(block->getId()).second)
+				{
+					blocks.push_back(block);
+				}
+			}
+		}
+	}
+
+	foreach (boost::shared_ptr<Block> block, blocks)
+	{
+		BlockConflictMap::iterator it = _blockConflictMap.find(*block);
+
+		if (it == _blockConflictMap.end())
+		{
+			continue;
+		}
+
+		foreach (const std::vector<unsigned int>& clique, cliques)
+		{
+			if (!it->second.erase(clique))
+			{
+				continue;
+			}
+
+			std::vector<unsigned int> remaining;
+
+			foreach (unsigned int member, clique)
+			{
+				if (canonicalId(member) != id)
+				{
+					remaining.push_back(member);
+				}
+			}
+
+			if (!remaining.empty())
+			{
+				it->second.insert(remaining);
+			}
+		}
+
+		if (it->second.empty())
+		{
+			_blockConflictMap.erase(it);
+		}
+	}
+}
+
+void
+LocalSliceStore::removeId(std::vector<unsigned int>& ids, unsigned int id)
+{
+	ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+}
+
+std::size_t
+LocalSliceStore::sliceBytes(const StoredSlice& slice)
+{
+	return sizeof(StoredSlice) + slice.component.memorySize();
 }
 
 void
 LocalSliceStore::dumpStore()
 {
-	SliceBlockMap::iterator sbm_it;
-	BlockSliceMap::iterator bsm_it;
+	boost::recursive_mutex::scoped_lock lock(_mutex);
 	
-	LOG_DEBUG(localslicestorelog) << "I have " << _sliceMasterList.size() << " slices recorded" <<
+	IdBlocksMap::iterator sbm_it;
+	BlockSliceMap::iterator bsm_it;
+
+	LOG_DEBUG(localslicestorelog) << "I have " << _idSliceMap->size() << " slices in memory, " <<
+		_spilledSliceMap.size() << " spilled, using about " << _residentBytes << " bytes" <<
 		std::endl;
-	
-	foreach (const Slice& slice, _sliceMasterList)
+
+	foreach (const IdSliceMap::value_type& entry, *_idSliceMap)
 	{
-		LOG_DEBUG(localslicestorelog) << "Slice id: " << slice.getId() << "\tHash: " <<
-			slice.hashValue() << std::endl;
+		LOG_DEBUG(localslicestorelog) << "Slice id: " << entry.first << "\tHash: " <<
+			entry.second->hash << "\tRuns: " << entry.second->component.getRuns().size() <<
+			std::endl;
 	}
-	
+
 	for (sbm_it = _sliceBlockMap->begin(); sbm_it != _sliceBlockMap->end(); ++sbm_it)
 	{
-		LOG_DEBUG(localslicestorelog) << "Slice id: " << sbm_it->first.getId() <<
+		LOG_DEBUG(localslicestorelog) << "Slice id: " << sbm_it->first <<
 			" with " << sbm_it->second->length() << " blocks " << std::endl;
 	}
-	
+
 	for (bsm_it = _blockSliceMap->begin(); bsm_it != _blockSliceMap->end(); ++bsm_it)
 	{
 		LOG_DEBUG(localslicestorelog) << "Block " << bsm_it->first << " with " <<
-			bsm_it->second->size() << " slices" << std::endl;
+			bsm_it->second.size() << " slices" << std::endl;
 	}
+
+	LOG_DEBUG(localslicestorelog) << _spilledBlockMap.size() << " blocks are spilled to " <<
+		_spillPath << std::endl;
 }
@@ -1,62 +1,213 @@
 #ifndef LOCAL_SLICE_STORE_H__
 #define LOCAL_SLICE_STORE_H__
 
+#include <list>
+#include <map>
+#include <vector>
+#include <string>
+#include <fstream>
 #include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/weak_ptr.hpp>
 #include <inference/Relation.h>
 
 #include <catmaidsopnet/persistence/SliceStore.h>
+#include <catmaidsopnet/persistence/RunLengthComponent.h>
 
 /**
  * A SliceStore implemented locally in RAM for testing purposes.
+ *
+ * Slices are held as run-length encoded components and are only expanded into Slice objects
+ * when they are retrieved. An expanded Slice is shared for as long as someone holds on to it.
+ *
+ * Optionally, the store can be given a memory budget in bytes. When the Slices held in RAM
+ * exceed the budget, the least-recently-used Blocks are spilled to a local file, together with
+ * the parent-child relationships of their Slices. Spilled Blocks are paged back in
+ * transparently whenever they, or one of their Slices, are accessed again. The space of
+ * paged in records is reused, so the spill file stays as large as the most data ever spilled
+ * at once.
  */
 
 class LocalSliceStore : public SliceStore
 {
-	typedef boost::unordered_map<Slice, boost::shared_ptr<Blocks> > SliceBlockMap;
-	typedef boost::unordered_map<Block, boost::shared_ptr<Slices> > BlockSliceMap;
-	typedef boost::unordered_map<unsigned int, boost::shared_ptr<Slice> > IdSliceMap;
-	typedef boost::unordered_map<Slice, boost::shared_ptr<Slices> > SliceSlicesMap;
-	typedef boost::unordered_map<Slice, boost::shared_ptr<Slice> > SliceSliceMap;
+	/**
+	 * The stored form of a Slice.
+	 */
+	struct StoredSlice
+	{
+		StoredSlice(unsigned int id_, unsigned int section_, std::size_t hash_,
+					const RunLengthComponent& component_) :
+			id(id_), section(section_), hash(hash_), component(component_) {}
+		
+		unsigned int id;
+		unsigned int section;
+		std::size_t hash;
+		RunLengthComponent component;
+		boost::weak_ptr<Slice> slice;
+	};
+	
+	/**
+	 * The place of a spilled block's record in the spill file.
+	 */
+	struct SpillRecord
+	{
+		std::streamoff offset;
+		std::size_t size;
+		// The slices of the block, kept in RAM to answer retrieveSliceIds.
+		std::vector<unsigned int> ids;
+	};
+	
+	typedef boost::unordered_map<unsigned int, boost::shared_ptr<Blocks> > IdBlocksMap;
+	typedef boost::unordered_map<Block, std::vector<unsigned int> > BlockSliceMap;
+	typedef boost::unordered_map<unsigned int, boost::shared_ptr<StoredSlice> > IdSliceMap;
+	typedef boost::unordered_map<unsigned int, unsigned int> IdIdMap;
+	typedef boost::unordered_map<unsigned int, std::vector<unsigned int> > IdIdsMap;
+	typedef boost::unordered_map<std::size_t, std::vector<unsigned int> > HashIdsMap;
+	typedef boost::unordered_map<unsigned int, boost::shared_ptr<Block> > IdBlockMap;
+	typedef boost::unordered_map<Block, SpillRecord> BlockRecordMap;
+	typedef std::map<std::streamoff, std::size_t> FreeExtentMap;
+	typedef std::list<boost::shared_ptr<Block> > BlockList;
+	typedef boost::unordered_map<Block, BlockList::iterator> BlockLruMap;
+	typedef boost::unordered_set<std::vector<unsigned int> > ConflictCliqueSet;
+	typedef boost::unordered_map<Block, ConflictCliqueSet> BlockConflictMap;
 
 public:
-	LocalSliceStore();
+	/**
+	 * Create a LocalSliceStore.
+	 * @param memoryBudget - the approximate number of bytes of Slice data to hold in RAM, or 0
+	 *                       for no limit.
+	 * @param spillPath - the file to which cold Blocks are spilled. If empty, a temporary file
+	 *                    is used.
+	 */
+	LocalSliceStore(std::size_t memoryBudget = 0, const std::string& spillPath = "");
+
+	~LocalSliceStore();
 
     void associate(const boost::shared_ptr<Slice>& slice, const boost::shared_ptr<Block>& block);
 
     boost::shared_ptr<Slices> retrieveSlices(const boost::shared_ptr<Block>& block);
 
+	/**
+	 * Does not page the block in if it has been spilled.
+	 */
+	std::vector<unsigned int> retrieveSliceIds(const boost::shared_ptr<Block>& block);
+
 	void disassociate(const boost::shared_ptr<Slice>& slice,
 					  const boost::shared_ptr<Block>& block);
 
 	void removeSlice(const boost::shared_ptr<Slice>& slice);
 
 	boost::shared_ptr<Blocks> getAssociatedBlocks(const boost::shared_ptr<Slice>& slice);
-	
+
+	boost::shared_ptr<Blocks> getAssociatedBlocks(unsigned int sliceId);
+
 	void setParent(const boost::shared_ptr<Slice>& childSlice,
 				   const boost::shared_ptr<Slice>& parentSlice);
-	
+
 	boost::shared_ptr<Slices> getChildren(const boost::shared_ptr<Slice>& parentSlice);
 
 	boost::shared_ptr<Slice> getParent(const boost::shared_ptr<Slice>& childSlice);
-	
+
+	void associateConflictSet(const ConflictSet& conflictSet,
+							  const boost::shared_ptr<Block>& block);
+
+	boost::shared_ptr<ConflictSets> retrieveConflictSets(const boost::shared_ptr<Block>& block);
+
 	void dumpStore();
+
 private:
-	
-	void mapSliceToBlock(const boost::shared_ptr<Slice>& slice,
-						 const boost::shared_ptr<Block>& block);
-	void mapBlockToSlice(const boost::shared_ptr<Block>& block,
-						 const boost::shared_ptr<Slice>& slice);
-	boost::shared_ptr<Slice> equivalentSlice(const boost::shared_ptr<Slice>& slice);
-	
-	boost::shared_ptr<SliceBlockMap> _sliceBlockMap;
+
+	void mapSliceToBlock(unsigned int id, const boost::shared_ptr<Block>& block);
+	void mapBlockToSlice(const boost::shared_ptr<Block>& block, unsigned int id);
+
+	/**
+	 * Find the canonical id under which the given Slice, or one equal to it, is stored.
+	 * Returns false if the store does not know the Slice.
+	 */
+	bool lookupId(const boost::shared_ptr<Slice>& slice, unsigned int& id);
+
+	unsigned int canonicalId(unsigned int id) const;
+
+	bool isKnown(unsigned int id) const;
+
+	/**
+	 * Return the stored form of the Slice with the given canonical id, paging it in if
+	 * necessary.
+	 */
+	boost::shared_ptr<StoredSlice> storedSlice(unsigned int id);
+
+	/**
+	 * Return the Slice with the given canonical id, expanding it if nobody holds it.
+	 */
+	boost::shared_ptr<Slice> residentSlice(unsigned int id);
+
+	/**
+	 * Mark the block as most recently used, paging it in if it has been spilled.
+	 */
+	void touch(const boost::shared_ptr<Block>& block);
+
+	bool isResident(const Block& block) const;
+
+	void enforceBudget();
+
+	void spill(const boost::shared_ptr<Block>& block);
+
+	void pageIn(const boost::shared_ptr<Block>& block);
+
+	/**
+	 * Find a place for a record of the given size in the spill file, reusing the space of
+	 * records that were paged in.
+	 */
+	std::streamoff allocateRecord(std::size_t size);
+
+	void releaseRecord(const SpillRecord& record);
+
+	/**
+	 * Remove the slice from the conflict cliques of every block that holds one of its
+	 * cliques, dropping cliques that become empty.
+	 */
+	void removeFromConflictSets(unsigned int id);
+
+	void dropSlice(unsigned int id);
+
+	void removeId(std::vector<unsigned int>& ids, unsigned int id);
+
+	static std::size_t sliceBytes(const StoredSlice& slice);
+
+	boost::shared_ptr<IdBlocksMap> _sliceBlockMap;
 	boost::shared_ptr<BlockSliceMap> _blockSliceMap;
 	boost::shared_ptr<IdSliceMap> _idSliceMap;
-	boost::shared_ptr<SliceSlicesMap> _parentChildrenMap;
-	boost::unordered_set<Slice> _sliceMasterList;
-	boost::shared_ptr<SliceSliceMap> _childParentMap;
+	boost::shared_ptr<IdIdsMap> _parentChildrenMap;
+	boost::shared_ptr<IdIdMap> _childParentMap;
+
+	// Conflict cliques as sorted canonical slice ids, by block.
+	BlockConflictMap _blockConflictMap;
+
+	// Slice content hashes to canonical ids, used to find equivalent Slices.
+	HashIdsMap _sliceMasterList;
+	// Ids of duplicate Slices to the canonical id they were merged into, and back.
+	IdIdMap _aliasMap;
+	IdIdsMap _canonicalAliasMap;
+
+	// Spilling state
+	std::size_t _memoryBudget;
+	std::size_t _residentBytes;
+	std::string _spillPath;
+	bool _removeSpillFile;
+	std::fstream _spillFile;
+	BlockList _lruBlocks;
+	BlockLruMap _lruMap;
+	BlockRecordMap _spilledBlockMap;
+	// Unused space in the spill file by offset, and the end of the used part.
+	FreeExtentMap _freeExtents;
+	std::streamoff _spillEnd;
+	IdBlockMap _spilledSliceMap;
+	IdBlockMap _idBlockMap;
 	
+	// Guards all of the above, the store may be shared between threads.
+	boost::recursive_mutex _mutex;
 };
 
-#endif //LOCAL_SLICE_STORE_H__
\ No newline at end of file
+#endif //LOCAL_SLICE_STORE_H__
@@ -0,0 +1,69 @@
+#include "LocalSolutionStore.h"
+
+#include <util/foreach.h>
+#include <util/Logger.h>
+
+logger::LogChannel localsolutionstorelog("localsolutionstorelog", "[LocalSolutionStore] ");
+
+void
+LocalSolutionStore::storeSolution(const boost::shared_ptr<Block>& block,
+								  std::size_t key,
+								  std::size_t fingerprint,
+								  const boost::shared_ptr<Segments>& chosen)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	std::vector<Entry>& entries = _solutions[block->getId()];
+	Entry entry;
+	
+	entry.key = key;
+	entry.fingerprint = fingerprint;
+	entry.chosen = chosen;
+	
+	foreach (Entry& existing, entries)
+	{
+		if (existing.key == key)
+		{
+			existing = entry;
+			return;
+		}
+	}
+	
+	entries.push_back(entry);
+}
+
+boost::shared_ptr<Segments>
+LocalSolutionStore::retrieveSolution(const boost::shared_ptr<Block>& block,
+									 std::size_t key,
+									 std::size_t fingerprint)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	BlockSolutionMap::const_iterator it = _solutions.find(block->getId());
+	
+	if (it != _solutions.end())
+	{
+		foreach (const Entry& entry, it->second)
+		{
+			if (entry.key == key && entry.fingerprint == fingerprint)
+			{
+				return entry.chosen;
+			}
+			else if (entry.key == key)
+			{
+				LOG_DEBUG(localsolutionstorelog) << "Solution of block " << block->getId() <<
+					" is outdated" << std::endl;
+			}
+		}
+	}
+	
+	return boost::shared_ptr<Segments>();
+}
+
+void
+LocalSolutionStore::removeSolutions(const boost::shared_ptr<Block>& block)
+{
+	boost::recursive_mutex::scoped_lock lock(_mutex);
+	
+	_solutions.erase(block->getId());
+}
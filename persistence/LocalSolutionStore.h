@@ -0,0 +1,46 @@
+#ifndef LOCAL_SOLUTION_STORE_H__
+#define LOCAL_SOLUTION_STORE_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <catmaidsopnet/persistence/SolutionStore.h>
+
+/**
+ * A SolutionStore in memory. Keeps one solution per block and key, a solution with a new
+ * fingerprint replaces the old one.
+ */
+class LocalSolutionStore : public SolutionStore
+{
+	struct Entry
+	{
+		std::size_t key;
+		std::size_t fingerprint;
+		boost::shared_ptr<Segments> chosen;
+	};
+
+	typedef boost::unordered_map<unsigned int, std::vector<Entry> > BlockSolutionMap;
+
+public:
+
+	void storeSolution(const boost::shared_ptr<Block>& block,
+					   std::size_t key,
+					   std::size_t fingerprint,
+					   const boost::shared_ptr<Segments>& chosen);
+
+	boost::shared_ptr<Segments> retrieveSolution(const boost::shared_ptr<Block>& block,
+												 std::size_t key,
+												 std::size_t fingerprint);
+
+	void removeSolutions(const boost::shared_ptr<Block>& block);
+
+private:
+
+	// Solutions by block id
+	BlockSolutionMap _solutions;
+
+	boost::recursive_mutex _mutex;
+};
+
+#endif //LOCAL_SOLUTION_STORE_H__
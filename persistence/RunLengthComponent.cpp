@@ -0,0 +1,222 @@
+#include "RunLengthComponent.h"
+
+#include <algorithm>
+#include <boost/make_shared.hpp>
+#include <util/foreach.h>
+
+static bool
+comparePixelRows(const ConnectedComponent::pixel_type& p1,
+				 const ConnectedComponent::pixel_type& p2)
+{
+	return p1.y < p2.y || (p1.y == p2.y && p1.x < p2.x);
+}
+
+RunLengthComponent::RunLengthComponent() :
+	_value(0),
+	_size(0),
+	_center(0, 0),
+	_boundingBox(0, 0, 0, 0)
+{
+}
+
+RunLengthComponent::RunLengthComponent(const ConnectedComponent& component) :
+	_value(component.getValue())
+{
+	std::vector<ConnectedComponent::pixel_type> pixels(component.getPixels().first,
+													   component.getPixels().second);
+	
+	// Sort by row, then by column.
+	std::sort(pixels.begin(), pixels.end(), &comparePixelRows);
+	
+	foreach (const ConnectedComponent::pixel_type& pixel, pixels)
+	{
+		if (!_runs.empty() && _runs.back().y == pixel.y && _runs.back().xEnd == pixel.x)
+		{
+			++_runs.back().xEnd;
+		}
+		else if (_runs.empty() || _runs.back().y != pixel.y || _runs.back().xEnd < pixel.x)
+		{
+			_runs.push_back(Run(pixel.y, pixel.x, pixel.x + 1));
+		}
+		// Otherwise, the pixel is a duplicate.
+	}
+	
+	computeStatistics();
+}
+
+RunLengthComponent::RunLengthComponent(double value, const std::vector<Run>& runs) :
+	_value(value),
+	_runs(runs)
+{
+	computeStatistics();
+}
+
+boost::shared_ptr<ConnectedComponent>
+RunLengthComponent::toConnectedComponent() const
+{
+	boost::shared_ptr<ConnectedComponent::pixel_list_type> pixels =
+		boost::make_shared<ConnectedComponent::pixel_list_type>();
+	
+	pixels->reserve(_size);
+	
+	foreach (const Run& run, _runs)
+	{
+		for (unsigned int x = run.xBegin; x < run.xEnd; ++x)
+		{
+			pixels->push_back(ConnectedComponent::pixel_type(x, run.y));
+		}
+	}
+	
+	return boost::make_shared<ConnectedComponent>(
+		boost::shared_ptr<Image>(), _value, pixels, 0, pixels->size());
+}
+
+bool
+RunLengthComponent::intersects(const RunLengthComponent& other) const
+{
+	return overlap(other, true) > 0;
+}
+
+unsigned int
+RunLengthComponent::intersectionSize(const RunLengthComponent& other) const
+{
+	return overlap(other, false);
+}
+
+bool
+RunLengthComponent::contains(const RunLengthComponent& other) const
+{
+	return other._size <= _size &&
+		other._boundingBox.minX >= _boundingBox.minX &&
+		other._boundingBox.minY >= _boundingBox.minY &&
+		other._boundingBox.maxX <= _boundingBox.maxX &&
+		other._boundingBox.maxY <= _boundingBox.maxY &&
+		overlap(other, false) == other._size;
+}
+
+bool
+RunLengthComponent::overlaps(const util::rect<int>& bound) const
+{
+	if (_size == 0 ||
+		bound.minX >= _boundingBox.maxX || bound.maxX <= _boundingBox.minX ||
+		bound.minY >= _boundingBox.maxY || bound.maxY <= _boundingBox.minY)
+	{
+		return false;
+	}
+	
+	unsigned int minY = std::max(bound.minY, 0);
+	std::vector<Run>::const_iterator it =
+		std::lower_bound(_runs.begin(), _runs.end(), Run(minY, 0, 0));
+	
+	for (; it != _runs.end() && static_cast<int>(it->y) < bound.maxY; ++it)
+	{
+		if (static_cast<int>(it->xBegin) < bound.maxX && static_cast<int>(it->xEnd) > bound.minX)
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+std::size_t
+RunLengthComponent::memorySize() const
+{
+	return sizeof(RunLengthComponent) + _runs.capacity() * sizeof(Run);
+}
+
+bool
+RunLengthComponent::operator==(const RunLengthComponent& other) const
+{
+	return _size == other._size && _runs == other._runs;
+}
+
+void
+RunLengthComponent::computeStatistics()
+{
+	double sumX = 0, sumY = 0;
+	
+	_size = 0;
+	_boundingBox = util::rect<int>(0, 0, 0, 0);
+	
+	foreach (const Run& run, _runs)
+	{
+		unsigned int length = run.xEnd - run.xBegin;
+		
+		if (_size == 0)
+		{
+			_boundingBox = util::rect<int>(run.xBegin, run.y, run.xEnd, run.y + 1);
+		}
+		else
+		{
+			_boundingBox.minX = std::min(_boundingBox.minX, static_cast<int>(run.xBegin));
+			_boundingBox.maxX = std::max(_boundingBox.maxX, static_cast<int>(run.xEnd));
+			_boundingBox.maxY = std::max(_boundingBox.maxY, static_cast<int>(run.y) + 1);
+		}
+		
+		_size += length;
+		sumX += length * (run.xBegin + run.xEnd - 1) / 2.0;
+		sumY += static_cast<double>(length) * run.y;
+	}
+	
+	_center = _size > 0 ?
+		util::point<double>(sumX / _size, sumY / _size) : util::point<double>(0, 0);
+}
+
+/**
+ * Walk both run lists in order, counting shared pixels. If firstOnly is set, stop at the first
+ * shared run.
+ */
+unsigned int
+RunLengthComponent::overlap(const RunLengthComponent& other, bool firstOnly) const
+{
+	unsigned int count = 0;
+	std::vector<Run>::const_iterator a = _runs.begin();
+	std::vector<Run>::const_iterator b = other._runs.begin();
+	
+	if (other._boundingBox.minX >= _boundingBox.maxX ||
+		other._boundingBox.maxX <= _boundingBox.minX ||
+		other._boundingBox.minY >= _boundingBox.maxY ||
+		other._boundingBox.maxY <= _boundingBox.minY)
+	{
+		return 0;
+	}
+	
+	while (a != _runs.end() && b != other._runs.end())
+	{
+		if (a->y < b->y)
+		{
+			++a;
+		}
+		else if (b->y < a->y)
+		{
+			++b;
+		}
+		else
+		{
+			unsigned int begin = std::max(a->xBegin, b->xBegin);
+			unsigned int end = std::min(a->xEnd, b->xEnd);
+			
+			if (begin < end)
+			{
+				count += end - begin;
+				
+				if (firstOnly)
+				{
+					return count;
+				}
+			}
+			
+			if (a->xEnd < b->xEnd)
+			{
+				++a;
+			}
+			else
+			{
+				++b;
+			}
+		}
+	}
+	
+	return count;
+}
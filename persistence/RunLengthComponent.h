@@ -0,0 +1,109 @@
+#ifndef RUN_LENGTH_COMPONENT_H__
+#define RUN_LENGTH_COMPONENT_H__
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <imageprocessing/ConnectedComponent.h>
+#include <util/point.hpp>
+#include <util/rect.hpp>
+
+/**
+ * A compact representation of a ConnectedComponent as horizontal runs of pixels. Size,
+ * bounding box and center are cached on construction, and overlap and intersection tests work
+ * directly on the runs.
+ *
+ * The bounding box is half-open, ie, maxX and maxY are one past the last pixel.
+ */
+class RunLengthComponent
+{
+public:
+	/**
+	 * A run of pixels [xBegin, xEnd) in row y.
+	 */
+	struct Run
+	{
+		Run() : y(0), xBegin(0), xEnd(0) {}
+		
+		Run(unsigned int y_, unsigned int xBegin_, unsigned int xEnd_) :
+			y(y_), xBegin(xBegin_), xEnd(xEnd_) {}
+		
+		bool operator==(const Run& other) const
+		{
+			return y == other.y && xBegin == other.xBegin && xEnd == other.xEnd;
+		}
+		
+		bool operator<(const Run& other) const
+		{
+			return y < other.y || (y == other.y && xBegin < other.xBegin);
+		}
+		
+		unsigned int y;
+		unsigned int xBegin;
+		unsigned int xEnd;
+	};
+	
+	RunLengthComponent();
+	
+	RunLengthComponent(const ConnectedComponent& component);
+	
+	/**
+	 * Create a RunLengthComponent from runs sorted by row and column, as returned by getRuns().
+	 */
+	RunLengthComponent(double value, const std::vector<Run>& runs);
+	
+	/**
+	 * Expand the runs into a ConnectedComponent without a source image.
+	 */
+	boost::shared_ptr<ConnectedComponent> toConnectedComponent() const;
+	
+	double getValue() const { return _value; }
+	
+	unsigned int getSize() const { return _size; }
+	
+	const util::point<double>& getCenter() const { return _center; }
+	
+	const util::rect<int>& getBoundingBox() const { return _boundingBox; }
+	
+	const std::vector<Run>& getRuns() const { return _runs; }
+	
+	/**
+	 * Returns true if this component and the other share at least one pixel.
+	 */
+	bool intersects(const RunLengthComponent& other) const;
+	
+	/**
+	 * Returns the number of pixels shared by this component and the other.
+	 */
+	unsigned int intersectionSize(const RunLengthComponent& other) const;
+	
+	/**
+	 * Returns true if every pixel of the other component is also in this one.
+	 */
+	bool contains(const RunLengthComponent& other) const;
+	
+	/**
+	 * Returns true if at least one pixel lies in the half-open rectangle.
+	 */
+	bool overlaps(const util::rect<int>& bound) const;
+	
+	/**
+	 * The approximate number of bytes used by this component.
+	 */
+	std::size_t memorySize() const;
+	
+	bool operator==(const RunLengthComponent& other) const;
+	
+private:
+	
+	void computeStatistics();
+	
+	unsigned int overlap(const RunLengthComponent& other, bool firstOnly) const;
+	
+	double _value;
+	unsigned int _size;
+	util::point<double> _center;
+	util::rect<int> _boundingBox;
+	std::vector<Run> _runs;
+};
+
+#endif //RUN_LENGTH_COMPONENT_H__
@@ -5,6 +5,7 @@
 #include <sopnet/segments/Segments.h>
 #include <sopnet/block/Block.h>
 #include <sopnet/block/Blocks.h>
+#include <sopnet/features/Features.h>
 #include <pipeline/Data.h>
 
 class SegmentStoreResult : public pipeline::Data
@@ -40,6 +41,22 @@ public:
 
 	virtual boost::shared_ptr<Blocks> getAssociatedBlocks(const boost::shared_ptr<Segment>& segment) = 0;
 
+	/**
+	 * Store the features of the given segments.
+	 * @param segments - the segments whose features to store.
+	 * @param features - the features of at least the given segments.
+	 */
+	virtual void storeFeatures(const boost::shared_ptr<Segments>& segments,
+							   const boost::shared_ptr<Features>& features) = 0;
+
+	/**
+	 * Retrieve the stored features of the given segments.
+	 * @param segments - the segments whose features to retrieve.
+	 * @param missing - receives the segments for which no features are stored.
+	 */
+	virtual boost::shared_ptr<Features> retrieveFeatures(const boost::shared_ptr<Segments>& segments,
+														 const boost::shared_ptr<Segments>& missing) = 0;
+
 };
 
 
@@ -1,4 +1,5 @@
 #include "SliceReader.h"
+#include <algorithm>
 #include <sopnet/block/Block.h>
 
 
@@ -12,6 +13,7 @@ SliceReader::SliceReader()
 	registerInput(_store, "store");
 	registerInput(_blockManager, "block manager");
 	registerOutput(_slices, "slices");
+	registerOutput(_conflictSets, "conflict sets");
 	
 	_box.registerBackwardCallback(&SliceReader::onBoxSet, this);
 	_blocks.registerBackwardCallback(&SliceReader::onBlocksSet, this);
@@ -43,11 +45,31 @@ SliceReader::addUnique(const boost::shared_ptr<Slices>& inSlices,
 	}
 }
 
+void
+SliceReader::addUniqueConflictSets(const boost::shared_ptr<ConflictSets>& inConflictSets,
+								   const boost::shared_ptr<ConflictSets>& recvConflictSets,
+								   boost::unordered_set<std::vector<unsigned int> >& set)
+{
+	foreach (const ConflictSet& conflictSet, *inConflictSets)
+	{
+		std::vector<unsigned int> clique(conflictSet.getSlices().begin(),
+										 conflictSet.getSlices().end());
+		std::sort(clique.begin(), clique.end());
+		
+		if (set.insert(clique).second)
+		{
+			recvConflictSets->add(conflictSet);
+		}
+	}
+}
+
 
 void SliceReader::updateOutputs()
 {
 	boost::unordered_set<Slice> sliceSet;
+	boost::unordered_set<std::vector<unsigned int> > conflictSetSet;
 	boost::shared_ptr<Slices> slices = boost::make_shared<Slices>();
+	boost::shared_ptr<ConflictSets> conflictSets = boost::make_shared<ConflictSets>();
 	boost::shared_ptr<Slices> parentSlices;
 	boost::shared_ptr<Blocks> blocks;
 	bool fullHouse = false;
@@ -56,6 +78,7 @@ void SliceReader::updateOutputs()
 	{
 		LOG_ERROR(slicereaderlog) << "Need either box or blocks, neither was set" << std::endl;
 		*_slices = *slices;
+		*_conflictSets = *conflictSets;
 		return;
 	}
 	else if (_sourceIsBox)
@@ -75,6 +98,8 @@ void SliceReader::updateOutputs()
 	{
 		boost::shared_ptr<Slices> blockSlices = _store->retrieveSlices(block);
 		addUnique(blockSlices, slices, sliceSet);
+		addUniqueConflictSets(_store->retrieveConflictSets(block), conflictSets,
+							  conflictSetSet);
 	}
 	
 	// In addition to the Slices contained in this block, fetch any Slice that is a descendant of
@@ -101,6 +126,7 @@ void SliceReader::updateOutputs()
 	LOG_DEBUG(slicereaderlog) << "Done." << std::endl;
 
 	*_slices = *slices;
+	*_conflictSets = *conflictSets;
 }
 
 void
@@ -2,6 +2,7 @@
 #define SLICE_READER_H__
 
 #include <deque>
+#include <vector>
 #include <boost/unordered_set.hpp>
 #include <imageprocessing/ComponentTrees.h>
 #include <catmaidsopnet/persistence/SliceStore.h>
@@ -26,6 +27,10 @@ private:
 				   const boost::shared_ptr<Slices>& recvSlices,
 				   boost::unordered_set<Slice>& set);
 	
+	void addUniqueConflictSets(const boost::shared_ptr<ConflictSets>& inConflictSets,
+							   const boost::shared_ptr<ConflictSets>& recvConflictSets,
+							   boost::unordered_set<std::vector<unsigned int> >& set);
+	
 	void fetchChildren(const boost::shared_ptr<Slices>& slicesIn,
 					   const boost::shared_ptr<Slices>& slicesOut);
 	
@@ -34,6 +39,7 @@ private:
 	pipeline::Input<BlockManager> _blockManager;
 	pipeline::Input<SliceStore> _store;
 	pipeline::Output<Slices> _slices;
+	pipeline::Output<ConflictSets> _conflictSets;
 	pipeline::Output<ComponentTrees> _trees;
 	
 	bool _sourceIsBox;
@@ -1,12 +1,14 @@
 #ifndef SLICE_STORE_H__
 #define SLICE_STORE_H__
 
+#include <vector>
 #include <boost/shared_ptr.hpp>
 
 #include <sopnet/slices/Slice.h>
 #include <pipeline/all.h>
 
 #include <sopnet/slices/Slices.h>
+#include <sopnet/slices/ConflictSets.h>
 #include <sopnet/block/Block.h>
 #include <sopnet/block/Blocks.h>
 #include <sopnet/inference/LinearConstraints.h>
@@ -46,6 +48,13 @@ public:
      */
     virtual boost::shared_ptr<Slices> retrieveSlices(const boost::shared_ptr<Block>& block) = 0;
 
+	/**
+	 * Retrieve the ids of the slices that retrieveSlices would return for the given block,
+	 * without retrieving the slices themselves.
+	 * @param block - the Block for which to retrieve the slice ids.
+	 */
+	virtual std::vector<unsigned int> retrieveSliceIds(const boost::shared_ptr<Block>& block) = 0;
+
 	/**
 	 * Disassociate the given slice from the given block
 	 * @param slice - the slice to disassociate
@@ -66,6 +75,13 @@ public:
 	 */
 	virtual boost::shared_ptr<Blocks> getAssociatedBlocks(
 		const boost::shared_ptr<Slice>& slice) = 0;
+
+	/**
+	 * Retrieve all Blocks associated with the slice of the given id, e.g., an id of a
+	 * conflict set.
+	 * @param sliceId - the id of the slice for which Blocks are to be retrieved.
+	 */
+	virtual boost::shared_ptr<Blocks> getAssociatedBlocks(unsigned int sliceId) = 0;
 	
 	/**
 	 * Store a parent-child relationship between two slices.
@@ -79,6 +95,22 @@ public:
 	virtual boost::shared_ptr<Slices> getChildren(const boost::shared_ptr<Slice>& parentSlice) = 0;
 	
 	virtual boost::shared_ptr<Slice> getParent(const boost::shared_ptr<Slice>& childSlice) = 0;
+
+	/**
+	 * Associate a conflict set with a block. A conflict set should be associated with every
+	 * block that contains one of its slices.
+	 * @param conflictSet - the conflict set to store.
+	 * @param block - the block containing at least one of the conflict set's slices.
+	 */
+	virtual void associateConflictSet(const ConflictSet& conflictSet,
+									  const boost::shared_ptr<Block>& block) = 0;
+
+	/**
+	 * Retrieve all conflict sets associated with the given block.
+	 * @param block - the Block for which to retrieve all conflict sets.
+	 */
+	virtual boost::shared_ptr<ConflictSets> retrieveConflictSets(
+		const boost::shared_ptr<Block>& block) = 0;
 };
 
 #endif //SLICE_STORE_H__
\ No newline at end of file
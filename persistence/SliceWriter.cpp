@@ -2,13 +2,17 @@
 
 #include <boost/shared_ptr.hpp>
 #include <sopnet/slices/Slice.h>
+#include <util/Logger.h>
+
+logger::LogChannel slicewriterlog("slicewriterlog", "[SliceWriter] ");
 
 SliceWriter::SliceWriter()
 {
-	registerInput(_block, "block");
+	registerInput(_blocks, "blocks");
 	registerInput(_slices, "slices");
 	registerInput(_store, "store");
-	registerInput(_trees, "component trees");
+	registerInput(_conflictSets, "conflict sets", pipeline::Optional);
+	registerInput(_trees, "component trees", pipeline::Optional);
 }
 
 void
@@ -18,41 +22,108 @@ SliceWriter::writeSlices()
 	// IE, each slice should have an entry in a tree.
 	int count = 0;
 	ComponentSliceMap componentSliceMap;
+	IdBlocksMap sliceBlocks;
 	ComponentTrees::iterator ctit;
-	std::vector<boost::shared_ptr<ConnectedComponent> > components;
 	
 	updateInputs();
 	
 	foreach (boost::shared_ptr<Slice> slice, *_slices)
 	{
-		_store->associate(slice, _block);
-		componentSliceMap[*(slice->getComponent())] = slice;
+		boost::shared_ptr<Blocks> blocks = boost::make_shared<Blocks>();
+		RunLengthComponent component(*slice->getComponent());
+		
+		foreach (boost::shared_ptr<Block> block, *_blocks)
+		{
+			if (associated(slice->getSection(), component, block))
+			{
+				_store->associate(slice, block);
+				blocks->add(block);
+			}
+		}
+		
+		sliceBlocks[slice->getId()] = blocks;
+		componentSliceMap.insert(slice);
 		++count;
 	}
+	
+	if (_conflictSets)
+	{
+		writeConflictSets(sliceBlocks);
+	}
+
+	if (_trees)
+	{
+		for (ctit = _trees->begin(); ctit != _trees->end(); ++ctit)
+		{
+			boost::shared_ptr<ComponentTree::Node> rootNode = ctit->second->getRoot();
+			
+			foreach (boost::shared_ptr<ComponentTree::Node> node, rootNode->getChildren())
+			{
+				assignParents(componentSliceMap, node);
+			}
+		}
+	}
+	
+	LOG_DEBUG(slicewriterlog) << "Wrote " << count << " slices" << std::endl;
+}
+
+bool
+SliceWriter::associated(unsigned int section, const RunLengthComponent& component,
+						const boost::shared_ptr<Block>& block)
+{
+	util::rect<int> bound(block->location().x, block->location().y,
+						  block->location().x + block->size().x,
+						  block->location().y + block->size().y);
+	
+	return section >= block->location().z &&
+		section < block->location().z + block->size().z &&
+		component.overlaps(bound);
+}
 
-	for (ctit = _trees->begin(); ctit != _trees->end(); ++ctit)
+/**
+ * Store each conflict set with every block that contains one of its written slices. Slices that
+ * were not written are dropped from the conflict set.
+ */
+void
+SliceWriter::writeConflictSets(IdBlocksMap& sliceBlocks)
+{
+	int count = 0;
+	
+	foreach (const ConflictSet& conflictSet, *_conflictSets)
 	{
-		boost::shared_ptr<ComponentTree::Node> rootNode = ctit->second->getRoot();
+		ConflictSet writtenSet;
+		Blocks conflictBlocks;
+		
+		foreach (unsigned int id, conflictSet.getSlices())
+		{
+			if (sliceBlocks.count(id))
+			{
+				writtenSet.addSlice(id);
+				conflictBlocks.addAll(sliceBlocks[id]);
+			}
+		}
 		
-		foreach (boost::shared_ptr<ComponentTree::Node> node, rootNode->getChildren())
+		foreach (boost::shared_ptr<Block> block, conflictBlocks)
 		{
-			assignParents(componentSliceMap, node);
+			_store->associateConflictSet(writtenSet, block);
+			++count;
 		}
 	}
 	
+	LOG_DEBUG(slicewriterlog) << "Wrote " << count << " conflict set associations" << std::endl;
 }
 
 void
 SliceWriter::assignParents(ComponentSliceMap& componentSliceMap,
 						   const boost::shared_ptr<ComponentTree::Node>& node)
 {
-	boost::shared_ptr<Slice> parentSlice = componentSliceMap[*(node->getComponent())];
+	boost::shared_ptr<Slice> parentSlice = componentSliceMap.find(node->getComponent());
 	
 	if (parentSlice)
 	{
 		foreach (boost::shared_ptr<ComponentTree::Node> childNode, node->getChildren())
 		{
-			boost::shared_ptr<Slice> childSlice = componentSliceMap[*(childNode->getComponent())];
+			boost::shared_ptr<Slice> childSlice = componentSliceMap.find(childNode->getComponent());
 			if (childSlice)
 			{
 				_store->setParent(childSlice, parentSlice);
@@ -3,14 +3,18 @@
 
 #include <pipeline/all.h>
 #include <sopnet/block/Block.h>
+#include <sopnet/block/Blocks.h>
 #include <sopnet/slices/Slices.h>
+#include <sopnet/slices/ConflictSets.h>
 #include <imageprocessing/ComponentTrees.h>
 #include <catmaidsopnet/persistence/SliceStore.h>
+#include <catmaidsopnet/persistence/RunLengthComponent.h>
+#include <catmaidsopnet/ComponentSliceMap.h>
 #include <boost/unordered_map.hpp>
 
 class SliceWriter : public pipeline::SimpleProcessNode<>
 {
-	typedef boost::unordered_map<ConnectedComponent, boost::shared_ptr<Slice> >  ComponentSliceMap;
+	typedef boost::unordered_map<unsigned int, boost::shared_ptr<Blocks> > IdBlocksMap;
 public:
 	SliceWriter();
 	
@@ -20,14 +24,20 @@ private:
 	
 	void updateOutputs(){}
 
+	bool associated(unsigned int section, const RunLengthComponent& component,
+					const boost::shared_ptr<Block>& block);
+
+	void writeConflictSets(IdBlocksMap& sliceBlocks);
+
 	void assignParents(ComponentSliceMap& componentSliceMap,
 					   const boost::shared_ptr<ComponentTree::Node>& node);
 	
-	pipeline::Input<Block> _block;
+	pipeline::Input<Blocks> _blocks;
 	pipeline::Input<Slices> _slices;
 	pipeline::Input<SliceStore> _store;
+	pipeline::Input<ConflictSets> _conflictSets;
 	pipeline::Input<ComponentTrees> _trees;
 };
 
 
-#endif //SLICE_WRITER_H__
\ No newline at end of file
+#endif //SLICE_WRITER_H__
@@ -0,0 +1,47 @@
+#ifndef SOLUTION_STORE_H__
+#define SOLUTION_STORE_H__
+
+#include <boost/shared_ptr.hpp>
+#include <pipeline/Data.h>
+#include <sopnet/block/Block.h>
+#include <sopnet/segments/Segments.h>
+
+/**
+ * Abstract Data class that handles the practicalities of storing and retrieving the solutions
+ * of blocks, ie, the segments chosen in a block by a CoreSolver.
+ *
+ * A solution is stored under a key that identifies how it was found, e.g., a hash of the cost
+ * parameters and the random forest, and a fingerprint of the content of the block when it
+ * was solved. A solution is only handed out for the same key and fingerprint, so that changed
+ * slices or segments in a block invalidate its solution.
+ */
+class SolutionStore : public pipeline::Data
+{
+public:
+	/**
+	 * Store the segments chosen in the given block.
+	 * @param block - the solved block.
+	 * @param key - identifies the costs the block was solved with.
+	 * @param fingerprint - identifies the slices and segments of the block.
+	 * @param chosen - the chosen segments associated with the block.
+	 */
+	virtual void storeSolution(const boost::shared_ptr<Block>& block,
+							   std::size_t key,
+							   std::size_t fingerprint,
+							   const boost::shared_ptr<Segments>& chosen) = 0;
+
+	/**
+	 * Retrieve the segments chosen in the given block, or an empty pointer if there is no
+	 * solution for this key and fingerprint.
+	 */
+	virtual boost::shared_ptr<Segments> retrieveSolution(const boost::shared_ptr<Block>& block,
+														 std::size_t key,
+														 std::size_t fingerprint) = 0;
+
+	/**
+	 * Forget all solutions of the given block.
+	 */
+	virtual void removeSolutions(const boost::shared_ptr<Block>& block) = 0;
+};
+
+#endif //SOLUTION_STORE_H__